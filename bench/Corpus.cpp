@@ -0,0 +1,220 @@
+#include <wx/wx.h>
+#include <wx/dir.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+#include <random>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "Corpus.hpp"
+
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace LR;
+
+/* Words for text files and file names. */
+static const char* Vocabulary[] = {
+    "alpha", "buffer", "cache",  "delta",  "engine", "filter", "graph",  "handle", "index",  "join",
+    "kernel", "layout", "mutex", "node",   "offset", "parser", "query",  "render", "stream", "thread",
+    "update", "vector", "widget", "xml",   "yield",  "zone",   "socket", "queue",  "token",  "record",
+};
+
+static const char* Extensions[] = { "txt", "cpp", "hpp", "md", "log", "json" };
+
+/* Marker file describing the generated tree. */
+static const char* CorpusMarker = "corpus.json";
+
+typedef std::mt19937 Random;
+
+static const char* PickWord(Random& rng)
+{
+    return Vocabulary[rng() % (sizeof(Vocabulary) / sizeof(Vocabulary[0]))];
+}
+
+static std::string GenText(Random& rng, const Corpus::Config& config, size_t size)
+{
+    const std::string needle = config.needle.ToStdString(wxConvUTF8);
+    std::bernoulli_distribution has_needle(config.needle_ratio);
+
+    std::string content;
+    content.reserve(size + 64);
+    while (content.size() < size)
+    {
+        const size_t words = 4 + rng() % 12;
+        const size_t needle_pos = has_needle(rng) ? rng() % words : words;
+        for (size_t i = 0; i < words; i++)
+        {
+            content += i == needle_pos ? needle.c_str() : PickWord(rng);
+            content += i + 1 == words ? '\n' : ' ';
+        }
+    }
+    content.resize(size);
+    return content;
+}
+
+static std::string GenBinary(Random& rng, size_t size)
+{
+    std::string content(size, '\0');
+    for (char& c : content)
+    {
+        c = static_cast<char>(rng() & 0xff);
+    }
+    return content;
+}
+
+static bool WriteCorpusFile(const wxString& path, const std::string& content)
+{
+    wxFile file;
+    if (!file.Open(path, wxFile::write))
+    {
+        return false;
+    }
+    return file.Write(content.data(), content.size()) == content.size();
+}
+
+static nlohmann::json DescribeConfig(const Corpus::Config& config)
+{
+    return {
+        { "depth", config.depth },
+        { "fanout", config.fanout },
+        { "files", config.files },
+        { "file_size", config.file_size },
+        { "binary_ratio", config.binary_ratio },
+        { "needle_ratio", config.needle_ratio },
+        { "seed", config.seed },
+        { "needle", config.needle.ToStdString(wxConvUTF8) },
+    };
+}
+
+static bool IsSameCorpus(const wxString& marker, const Corpus::Config& config)
+{
+    wxLogNull logNo;
+    wxFile    file;
+    wxString  content;
+    if (!file.Open(marker, wxFile::read) || !file.ReadAll(&content, wxConvUTF8))
+    {
+        return false;
+    }
+    return nlohmann::json::parse(content.ToStdString(wxConvUTF8), nullptr, false) == DescribeConfig(config);
+}
+
+/**
+ * @brief Walk the tree in a fixed order. Files are written only if write is set.
+ */
+static bool GenDirectory(Corpus* corpus, Random& rng, const Corpus::Config& config, const wxString& path,
+                         size_t level, bool write)
+{
+    const wxUniChar sep = wxFileName::GetPathSeparator();
+    if (write && !wxFileName::DirExists(path) && !wxFileName::Mkdir(path, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+    {
+        return false;
+    }
+    corpus->directories++;
+
+    std::uniform_int_distribution<size_t> file_size(config.file_size / 2, config.file_size + config.file_size / 2);
+    std::bernoulli_distribution           is_binary(config.binary_ratio);
+    for (size_t i = 0; i < config.files; i++)
+    {
+        const size_t size = file_size(rng);
+        const bool   binary = is_binary(rng);
+        const char*  ext = binary ? "bin" : Extensions[rng() % (sizeof(Extensions) / sizeof(Extensions[0]))];
+        const wxString name = wxString::Format("%s_%s_%zu.%s", PickWord(rng), PickWord(rng), i, ext);
+
+        /* Content is always generated, so the random sequence does not depend on write. */
+        const std::string content = binary ? GenBinary(rng, size) : GenText(rng, config, size);
+        if (write && !WriteCorpusFile(path + sep + name, content))
+        {
+            return false;
+        }
+        corpus->files.push_back(path + sep + name);
+        corpus->names.push_back(name);
+        corpus->bytes += size;
+    }
+
+    if (level >= config.depth)
+    {
+        return true;
+    }
+    for (size_t i = 0; i < config.fanout; i++)
+    {
+        const wxString name = wxString::Format("%s_%zu", PickWord(rng), i);
+        if (!GenDirectory(corpus, rng, config, path + sep + name, level + 1, write))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Corpus::Generate(const wxString& root, const Config& config)
+{
+    const wxString marker = root + wxFileName::GetPathSeparator() + CorpusMarker;
+    const bool     write = !IsSameCorpus(marker, config);
+
+    /* Files of another corpus would be measured too. Never delete a directory that is not a corpus. */
+    if (write && wxFileName::DirExists(root))
+    {
+        wxDir dir(root);
+        if (!wxFileName::FileExists(marker) && dir.IsOpened() && (dir.HasFiles() || dir.HasSubDirs()))
+        {
+            wxLogError("Not a corpus directory: %s", root);
+            return false;
+        }
+        wxFileName::Rmdir(root, wxPATH_RMDIR_RECURSIVE);
+    }
+
+    this->root = root;
+    files.clear();
+    names.clear();
+    directories = 0;
+    bytes = 0;
+
+    Random rng(config.seed);
+    if (!GenDirectory(this, rng, config, root, 0, write))
+    {
+        wxLogError("Failed to generate corpus: %s", root);
+        return false;
+    }
+
+    /* The marker is written last, so an interrupted generation starts over. */
+    return !write || WriteCorpusFile(marker, DescribeConfig(config).dump(4));
+}
+
+const char* Corpus::DropCache() const
+{
+#if defined(WIN32)
+    return nullptr;
+#else
+    /* Dropping all caches also evicts directory entries, but requires root. */
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd >= 0)
+    {
+        const bool ok = write(fd, "3", 1) == 1;
+        close(fd);
+        if (ok)
+        {
+            return "drop_caches";
+        }
+    }
+
+#if defined(POSIX_FADV_DONTNEED)
+    /* Only file content is evicted, directories stay cached. */
+    for (const wxString& path : files)
+    {
+        fd = open(path.fn_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+    return "fadvise";
+#else
+    return nullptr;
+#endif
+#endif
+}
@@ -0,0 +1,55 @@
+#ifndef LAUNCHR_BENCH_CORPUS_HPP
+#define LAUNCHR_BENCH_CORPUS_HPP
+
+#include <wx/string.h>
+#include <cstdint>
+#include <vector>
+
+namespace LR
+{
+
+/**
+ * @brief Synthetic directory tree for benchmarks.
+ *
+ * The tree only depends on the parameters, so two runs with the same
+ * parameters measure the same data. Text files are made of words from a
+ * fixed vocabulary, with the needle planted at a fixed rate.
+ */
+struct Corpus
+{
+    struct Config
+    {
+        size_t   depth = 3;           /* Directory levels below the root. */
+        size_t   fanout = 4;          /* Subdirectories per directory. */
+        size_t   files = 16;          /* Files per directory. */
+        size_t   file_size = 16384;   /* Average file size in bytes, actual sizes vary from half to 1.5 times. */
+        double   binary_ratio = 0.1;  /* Part of the files filled with random bytes. */
+        double   needle_ratio = 0.01; /* Part of the text lines containing the needle. */
+        uint32_t seed = 1;            /* Random seed. */
+        wxString needle = "launchr";  /* Word planted in text files. */
+    };
+
+    /**
+     * @brief Generate the tree, unless a tree of the same parameters already exists there.
+     * @param[in] root Root directory, created if missing.
+     * @param[in] config Tree parameters.
+     * @return false if the tree cannot be written.
+     */
+    bool Generate(const wxString& root, const Config& config);
+
+    /**
+     * @brief Drop the files from the OS cache, so they are read from the disk again.
+     * @return Method used, or nullptr if not supported.
+     */
+    const char* DropCache() const;
+
+    wxString              root;            /* Root directory. */
+    std::vector<wxString> files;           /* Generated files. */
+    std::vector<wxString> names;           /* File names, same order as files. */
+    size_t                directories = 0; /* Number of directories, including the root. */
+    uint64_t              bytes = 0;       /* Total size of the files. */
+};
+
+} // namespace LR
+
+#endif
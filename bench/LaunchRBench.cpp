@@ -0,0 +1,564 @@
+#include <wx/wx.h>
+#include <wx/cmdline.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/init.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "searchers/Searcher.hpp"
+#include "utils/AhoCorasick.hpp"
+#include "utils/BoyerMoore.hpp"
+#include "utils/FileSystem.hpp"
+#include "utils/FuzzyMatch.hpp"
+#include "utils/Regex.hpp"
+#include "utils/ResultStore.hpp"
+#include "utils/SubstringSearch.hpp"
+#include "utils/TextMatcher.hpp"
+#include "utils/TextQuery.hpp"
+#include "Corpus.hpp"
+
+using namespace LR;
+typedef std::chrono::steady_clock Clock;
+
+struct BenchOptions
+{
+    wxString       root;        /* Corpus directory. */
+    wxString       query;       /* File name query. */
+    wxString       output;      /* Output file, stdout if empty. */
+    wxString       label;       /* Free text stored in the report, typically the commit. */
+    size_t         repeat = 5;  /* Measured runs per benchmark. */
+    Corpus::Config corpus;      /* Corpus parameters. */
+    bool           cold = true; /* Also run the cold cache variants. */
+};
+
+struct BenchContext
+{
+    const BenchOptions&      options;
+    const Corpus&            corpus;
+    const char*              cold_method; /* How the cache is dropped, nullptr if cold runs are skipped. */
+    std::vector<std::string> contents;    /* Content of the text files, for in-memory searches. */
+    uint64_t                 text_bytes;  /* Total size of contents. */
+    nlohmann::json           results;     /* Reported benchmarks. */
+};
+
+/**
+ * @brief A benchmark run, returns the number of items processed.
+ */
+typedef std::function<size_t()> BenchFunc;
+
+/**
+ * @brief Measure a benchmark and append it to the report.
+ * @param[in] ctx Benchmark context.
+ * @param[in] name Benchmark name.
+ * @param[in] cold Drop the cache before every run, otherwise run once before measuring.
+ * @param[in] bytes Bytes processed by one run, 0 if not meaningful.
+ * @param[in] func Benchmark.
+ */
+static void RunBench(BenchContext& ctx, const char* name, bool cold, uint64_t bytes, const BenchFunc& func)
+{
+    if (cold && ctx.cold_method == nullptr)
+    {
+        return;
+    }
+    if (!cold)
+    {
+        func();
+    }
+
+    std::vector<double> runs;
+    size_t              items = 0;
+    for (size_t i = 0; i < ctx.options.repeat; i++)
+    {
+        if (cold)
+        {
+            ctx.corpus.DropCache();
+        }
+        const Clock::time_point start = Clock::now();
+        items = func();
+        runs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+
+    std::vector<double> sorted = runs;
+    std::sort(sorted.begin(), sorted.end());
+    const double median = sorted[sorted.size() / 2];
+    const double mean = std::accumulate(runs.begin(), runs.end(), 0.0) / runs.size();
+
+    nlohmann::json result = {
+        { "name", name },
+        { "cache", cold ? "cold" : "warm" },
+        { "runs_ms", runs },
+        { "min_ms", sorted.front() },
+        { "median_ms", median },
+        { "mean_ms", mean },
+        { "max_ms", sorted.back() },
+        { "items", items },
+        { "items_per_s", median > 0 ? items * 1000.0 / median : 0.0 },
+    };
+    if (bytes != 0)
+    {
+        result["bytes"] = bytes;
+        result["mb_per_s"] = median > 0 ? bytes / 1048576.0 * 1000.0 / median : 0.0;
+    }
+    ctx.results.push_back(result);
+
+    fprintf(stderr, "%-28s %-4s %10.3f ms  %12zu items\n", name, cold ? "cold" : "warm", median, items);
+}
+
+static size_t BenchTraversal(const BenchContext& ctx, bool parallel)
+{
+    std::atomic<size_t> count = 0;
+    auto                cb = [&count](const FileSystemTraversal::FileInfo& info) {
+        if (info.isfile)
+        {
+            count++;
+        }
+        return true;
+    };
+
+    if (parallel)
+    {
+        FileSystemTraversal::ParallelTraversal(ctx.corpus.root, SIZE_MAX, cb);
+    }
+    else
+    {
+        FileSystemTraversal::Traversal(ctx.corpus.root, SIZE_MAX, cb);
+    }
+    return count;
+}
+
+static size_t BenchFuzzyMatch(const BenchContext& ctx)
+{
+    const FuzzyMatch query(ctx.options.query);
+    size_t           matches = 0;
+    for (size_t i = 0; i < ctx.corpus.names.size(); i++)
+    {
+        if (query.Score(ctx.corpus.names[i], ctx.corpus.files[i]).has_value())
+        {
+            matches++;
+        }
+    }
+    return matches;
+}
+
+/**
+ * @brief Count the needle in every text file, with the given searcher.
+ */
+template <typename Search>
+static size_t BenchContentSearch(const BenchContext& ctx)
+{
+    const std::string needle = ctx.options.corpus.needle.ToStdString(wxConvUTF8);
+    const Search      search(needle.data(), needle.size());
+
+    size_t matches = 0;
+    for (const std::string& content : ctx.contents)
+    {
+        size_t offset = 0;
+        while (offset < content.size())
+        {
+            std::optional<size_t> pos = search.Search(content.data() + offset, content.size() - offset);
+            if (!pos.has_value())
+            {
+                break;
+            }
+            matches++;
+            offset += pos.value() + needle.size();
+        }
+    }
+    return matches;
+}
+
+/**
+ * @brief Escape the needle so that a regular expression matches it literally.
+ */
+static std::string EscapeNeedle(const BenchContext& ctx)
+{
+    std::string pattern;
+    for (char c : ctx.options.corpus.needle.ToStdString(wxConvUTF8))
+    {
+        if (strchr("\\^$.|?*+()[]{}", c) != nullptr)
+        {
+            pattern.push_back('\\');
+        }
+        pattern.push_back(c);
+    }
+    return pattern;
+}
+
+/**
+ * @brief Count the matches of a regular expression in every text file, a match is searched again after its end.
+ */
+static size_t CountRegexMatches(const BenchContext& ctx, const Regex& search)
+{
+    size_t matches = 0;
+    for (const std::string& content : ctx.contents)
+    {
+        size_t offset = 0;
+        size_t length = 0;
+        while (offset < content.size())
+        {
+            std::optional<size_t> pos = search.Find(content.data(), content.size(), offset, &length);
+            if (!pos.has_value())
+            {
+                break;
+            }
+            matches++;
+            offset = pos.value() + std::max<size_t>(length, 1);
+        }
+    }
+    return matches;
+}
+
+/**
+ * @brief Count the words starting with the needle in every text file, with a regular expression.
+ */
+static size_t BenchRegexSearch(const BenchContext& ctx)
+{
+    const Regex search("\\b" + EscapeNeedle(ctx) + "\\w*", false);
+    return CountRegexMatches(ctx, search);
+}
+
+/**
+ * @brief Map every file and search it with the matchers of the text searcher, publishing the matched files.
+ */
+static void BenchTextSearchFiles(const BenchContext& ctx, const TextQuery& query, Searcher::Iterator& iterator)
+{
+    const TextMatcher       utf8_matcher(query, TextMatcher::Encoding::Utf8, true);
+    const TextMatcher       utf16_matcher(query, TextMatcher::Encoding::Utf16Le, true);
+    const std::atomic<bool> running = true;
+    for (size_t i = 0; i < ctx.corpus.files.size(); i++)
+    {
+        FileMemoryMap map(ctx.corpus.files[i]);
+        const void*   data = map.GetAddr();
+        if (data == nullptr || TextMatcher::IsBinary(data, map.GetSize()))
+        {
+            continue;
+        }
+
+        /* Regular expressions only match UTF-8, as in the text searcher. */
+        const bool         utf16 = TextMatcher::DetectEncoding(data, map.GetSize()) == TextMatcher::Encoding::Utf16Le;
+        const TextMatcher& matcher = utf16 && !query.regex ? utf16_matcher : utf8_matcher;
+        iterator.Count(0, 1, map.GetSize());
+        if (!query.IsSatisfied(matcher.Search(data, map.GetSize(), 0)))
+        {
+            continue;
+        }
+
+        Searcher::ResultBatch batch(1);
+        batch.back().title = ctx.corpus.names[i];
+        batch.back().path = ctx.corpus.files[i];
+        iterator.PublishAll(batch, running);
+    }
+    iterator.Finish();
+}
+
+/**
+ * @brief Search the content with the text searcher defaults, the consumer fetches the results into a store as the
+ *   UI does.
+ */
+static size_t BenchTextSearch(const BenchContext& ctx)
+{
+    const TextQuery       query(ctx.options.corpus.needle);
+    Searcher::NotifierPtr notifier = std::make_shared<Notifier>();
+    Searcher::Iterator    iterator(notifier);
+    std::thread           producer(BenchTextSearchFiles, std::cref(ctx), std::cref(query), std::ref(iterator));
+
+    ResultStore store;
+    for (;;)
+    {
+        const uint64_t        epoch = notifier->GetEpoch();
+        Searcher::ResultBatch batch;
+        const bool            end = iterator.Fetch(batch) == Searcher::ResultCode::End;
+        for (const Searcher::Result& result : batch)
+        {
+            store.Add(result);
+        }
+        if (end)
+        {
+            break;
+        }
+        notifier->Wait(epoch);
+    }
+    producer.join();
+    return store.GetCount();
+}
+
+static size_t BenchResultStore(const BenchContext& ctx)
+{
+    ResultStore store;
+    for (size_t i = 0; i < ctx.corpus.files.size(); i++)
+    {
+        Searcher::Result result;
+        result.title = ctx.corpus.names[i];
+        result.path = ctx.corpus.files[i];
+        store.Add(result);
+    }
+    return store.GetCount();
+}
+
+static void LoadContents(BenchContext& ctx)
+{
+    ctx.text_bytes = 0;
+    for (const wxString& path : ctx.corpus.files)
+    {
+        if (path.EndsWith(".bin"))
+        {
+            continue;
+        }
+
+        FileMemoryMap map(path);
+        if (map.GetAddr() != nullptr)
+        {
+            ctx.contents.emplace_back(static_cast<const char*>(map.GetAddr()), map.GetSize());
+            ctx.text_bytes += map.GetSize();
+        }
+    }
+}
+
+static void RunAllBench(BenchContext& ctx)
+{
+    for (bool cold : { false, true })
+    {
+        RunBench(ctx, "traversal/sequential", cold, 0, [&ctx]() { return BenchTraversal(ctx, false); });
+        RunBench(ctx, "traversal/parallel", cold, 0, [&ctx]() { return BenchTraversal(ctx, true); });
+        RunBench(ctx, "content/text_search", cold, ctx.corpus.bytes, [&ctx]() { return BenchTextSearch(ctx); });
+    }
+
+    LoadContents(ctx);
+    RunBench(ctx, "content/boyer_moore", false, ctx.text_bytes,
+             [&ctx]() { return BenchContentSearch<BoyerMoore>(ctx); });
+    RunBench(ctx, "content/substring_search", false, ctx.text_bytes,
+             [&ctx]() { return BenchContentSearch<SubstringSearch>(ctx); });
+    RunBench(ctx, "content/regex", false, ctx.text_bytes, [&ctx]() { return BenchRegexSearch(ctx); });
+    RunBench(ctx, "filename/fuzzy_match", false, 0, [&ctx]() { return BenchFuzzyMatch(ctx); });
+    RunBench(ctx, "results/result_store", false, 0, [&ctx]() { return BenchResultStore(ctx); });
+}
+
+/**
+ * @brief Count the needle with the multi-pattern automaton, like BenchContentSearch().
+ */
+static size_t CountAhoCorasickMatches(const BenchContext& ctx)
+{
+    const std::string needle = ctx.options.corpus.needle.ToStdString(wxConvUTF8);
+    AhoCorasick       search;
+    search.AddPattern(needle.data(), needle.size(), 0);
+    search.Compile();
+
+    size_t matches = 0;
+    for (const std::string& content : ctx.contents)
+    {
+        size_t offset = 0;
+        size_t length = 0;
+        while (offset < content.size())
+        {
+            std::optional<size_t> pos = search.Find(content.data() + offset, content.size() - offset, &length);
+            if (!pos.has_value())
+            {
+                break;
+            }
+            matches++;
+            offset += pos.value() + length;
+        }
+    }
+    return matches;
+}
+
+/**
+ * @brief Count the text files the matcher of the text searcher finds the needle in, as a phrase and in this case.
+ */
+static size_t CountTextMatcherFiles(const BenchContext& ctx)
+{
+    const TextQuery   query("\"" + ctx.options.corpus.needle + "\"");
+    const TextMatcher matcher(query, TextMatcher::Encoding::Utf8, false);
+
+    size_t files = 0;
+    for (const std::string& content : ctx.contents)
+    {
+        if (query.IsSatisfied(matcher.Search(content.data(), content.size(), 0)))
+        {
+            files++;
+        }
+    }
+    return files;
+}
+
+/**
+ * @brief Check that the optimized content searches agree with the scalar Boyer-Moore baseline on the corpus.
+ * @return false if any count differs, the differences are printed.
+ */
+static bool CheckContentSearch(const BenchContext& ctx)
+{
+    const std::string needle = ctx.options.corpus.needle.ToStdString(wxConvUTF8);
+    const BoyerMoore  baseline(needle.data(), needle.size());
+    size_t            baseline_files = 0;
+    for (const std::string& content : ctx.contents)
+    {
+        if (baseline.Search(content.data(), content.size()).has_value())
+        {
+            baseline_files++;
+        }
+    }
+
+    const size_t baseline_matches = BenchContentSearch<BoyerMoore>(ctx);
+    const Regex  literal(EscapeNeedle(ctx), false);
+    const struct
+    {
+        const char* name;
+        size_t      count;
+        size_t      expected;
+    } checks[] = {
+        { "substring_search", BenchContentSearch<SubstringSearch>(ctx), baseline_matches },
+        { "aho_corasick", CountAhoCorasickMatches(ctx), baseline_matches },
+        { "regex", CountRegexMatches(ctx, literal), baseline_matches },
+        { "text_matcher files", CountTextMatcherFiles(ctx), baseline_files },
+    };
+
+    bool consistent = true;
+    for (const auto& check : checks)
+    {
+        if (check.count != check.expected)
+        {
+            fprintf(stderr, "Mismatch: %s counts %zu, boyer_moore counts %zu\n", check.name, check.count,
+                    check.expected);
+            consistent = false;
+        }
+    }
+    return consistent;
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions* options)
+{
+    static const wxCmdLineEntryDesc desc[] = {
+        { wxCMD_LINE_SWITCH, "h", "help", "Show this help", wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP },
+        { wxCMD_LINE_OPTION, "r", "root", "Corpus directory", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_OPTION, "o", "output", "Write the JSON report to this file", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_OPTION, "l", "label", "Label stored in the report, e.g. the commit", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_OPTION, "q", "query", "File name query", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_OPTION, "n", "repeat", "Measured runs per benchmark", wxCMD_LINE_VAL_NUMBER, 0 },
+        { wxCMD_LINE_OPTION, nullptr, "depth", "Directory levels", wxCMD_LINE_VAL_NUMBER, 0 },
+        { wxCMD_LINE_OPTION, nullptr, "fanout", "Subdirectories per directory", wxCMD_LINE_VAL_NUMBER, 0 },
+        { wxCMD_LINE_OPTION, nullptr, "files", "Files per directory", wxCMD_LINE_VAL_NUMBER, 0 },
+        { wxCMD_LINE_OPTION, nullptr, "file-size", "Average file size in bytes", wxCMD_LINE_VAL_NUMBER, 0 },
+        { wxCMD_LINE_OPTION, nullptr, "seed", "Random seed", wxCMD_LINE_VAL_NUMBER, 0 },
+        { wxCMD_LINE_OPTION, nullptr, "needle", "Word planted in text files", wxCMD_LINE_VAL_STRING, 0 },
+        { wxCMD_LINE_SWITCH, nullptr, "warm-only", "Skip the cold cache variants", wxCMD_LINE_VAL_NONE, 0 },
+        { wxCMD_LINE_NONE, nullptr, nullptr, nullptr, wxCMD_LINE_VAL_NONE, 0 },
+    };
+
+    wxCmdLineParser parser(desc, argc, argv);
+    if (parser.Parse() != 0)
+    {
+        return false;
+    }
+
+    options->root = wxFileName::GetTempDir() + wxFileName::GetPathSeparator() + "launchr_bench";
+    options->query = "parser";
+    parser.Found("root", &options->root);
+    parser.Found("output", &options->output);
+    parser.Found("label", &options->label);
+    parser.Found("query", &options->query);
+    parser.Found("needle", &options->corpus.needle);
+    options->cold = !parser.Found("warm-only");
+
+    /* Negative numbers are ignored, the defaults are kept. */
+    const std::pair<const char*, size_t*> numbers[] = {
+        { "repeat", &options->repeat },
+        { "depth", &options->corpus.depth },
+        { "fanout", &options->corpus.fanout },
+        { "files", &options->corpus.files },
+        { "file-size", &options->corpus.file_size },
+    };
+    for (const auto& it : numbers)
+    {
+        long value;
+        if (parser.Found(it.first, &value) && value >= 0)
+        {
+            *it.second = static_cast<size_t>(value);
+        }
+    }
+    long seed;
+    if (parser.Found("seed", &seed))
+    {
+        options->corpus.seed = static_cast<uint32_t>(seed);
+    }
+    options->repeat = std::max<size_t>(options->repeat, 1);
+    return !options->corpus.needle.empty();
+}
+
+int main(int argc, char** argv)
+{
+    wxInitializer initializer(argc, argv);
+    if (!initializer.IsOk())
+    {
+        fprintf(stderr, "Failed to initialize wxWidgets\n");
+        return 1;
+    }
+
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, &options))
+    {
+        return 1;
+    }
+
+    Corpus corpus;
+    if (!corpus.Generate(options.root, options.corpus))
+    {
+        return 1;
+    }
+
+    BenchContext ctx{ options, corpus, options.cold ? corpus.DropCache() : nullptr, {}, 0, nlohmann::json::array() };
+    if (options.cold && ctx.cold_method == nullptr)
+    {
+        fprintf(stderr, "Dropping the file cache is not supported, cold variants are skipped\n");
+    }
+    RunAllBench(ctx);
+
+    /* Timings of a search that finds something else are meaningless. */
+    if (!CheckContentSearch(ctx))
+    {
+        return 1;
+    }
+
+    const nlohmann::json report = {
+        { "label", options.label.ToStdString(wxConvUTF8) },
+        { "substring_kernel", SubstringSearch::GetKernelName() },
+        { "cold_method", ctx.cold_method != nullptr ? nlohmann::json(ctx.cold_method) : nlohmann::json() },
+        { "corpus",
+          {
+              { "root", corpus.root.ToStdString(wxConvUTF8) },
+              { "directories", corpus.directories },
+              { "files", corpus.files.size() },
+              { "bytes", corpus.bytes },
+              { "depth", options.corpus.depth },
+              { "fanout", options.corpus.fanout },
+              { "files_per_directory", options.corpus.files },
+              { "file_size", options.corpus.file_size },
+              { "seed", options.corpus.seed },
+          } },
+        { "benchmarks", ctx.results },
+    };
+
+    const std::string content = report.dump(4) + "\n";
+    if (options.output.empty())
+    {
+        fputs(content.c_str(), stdout);
+        return 0;
+    }
+
+    wxFile file;
+    if (!file.Open(options.output, wxFile::write) || file.Write(content.data(), content.size()) != content.size())
+    {
+        fprintf(stderr, "Failed to write %s\n", options.output.utf8_str().data());
+        return 1;
+    }
+    return 0;
+}
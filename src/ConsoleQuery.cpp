@@ -0,0 +1,204 @@
+#include <wx/wx.h>
+#include <cstdio>
+#include <list>
+#include <nlohmann/json.hpp>
+#include "utils/QueryMetrics.hpp"
+#include "utils/Trace.hpp"
+#include "ConsoleQuery.hpp"
+
+using namespace LR;
+
+struct SearcherRun
+{
+    Searcher*             searcher; /* Searcher. */
+    Searcher::IteratorPtr iterator; /* Running query. */
+    size_t                source;   /* Index in the query metrics. */
+};
+
+typedef std::list<SearcherRun> SearcherRunList;
+
+static void PrintResult(const SearcherRun& run, const Searcher::Result& result, bool json)
+{
+    const wxString path = result.path.value_or(wxString(""));
+    if (!json)
+    {
+        if (result.match.has_value())
+        {
+            printf("%s\t%s\t%llu\t%s\n", result.title.utf8_str().data(), path.utf8_str().data(),
+                   static_cast<unsigned long long>(result.match->line), result.match->snippet.utf8_str().data());
+            return;
+        }
+        printf("%s\t%s\n", result.title.utf8_str().data(), path.utf8_str().data());
+        return;
+    }
+
+    nlohmann::json line = {
+        { "type", "result" },
+        { "searcher", run.searcher->GetName().utf8_string() },
+        { "title", result.title.utf8_string() },
+        { "path", path.utf8_string() },
+        { "score", result.score },
+    };
+    if (result.match.has_value())
+    {
+        line["line"] = result.match->line;
+        line["offset"] = result.match->offset;
+        line["snippet"] = result.match->snippet.utf8_string();
+    }
+    printf("%s\n", line.dump().c_str());
+}
+
+static nlohmann::json OptionalMs(const std::optional<double>& ms)
+{
+    return ms.has_value() ? nlohmann::json(ms.value()) : nlohmann::json();
+}
+
+static void PrintSummary(const QueryMetrics& metrics, bool json)
+{
+    const double elapsed_ms = metrics.GetElapsedMs();
+    if (!json)
+    {
+        for (size_t i = 0; i < metrics.sources.size(); i++)
+        {
+            fprintf(stderr, "%s\n", metrics.FormatSource(i).utf8_str().data());
+        }
+        fprintf(stderr, "Total: %zu results in %.3f ms\n", metrics.GetResults(), elapsed_ms);
+        return;
+    }
+
+    for (const QueryMetrics::Source& source : metrics.sources)
+    {
+        const nlohmann::json line = {
+            { "type", "summary" },
+            { "searcher", source.name.utf8_string() },
+            { "results", source.results },
+            { "first_result_ms", OptionalMs(source.first_ms) },
+            { "elapsed_ms", OptionalMs(source.end_ms) },
+            { "directories", source.counters.directories },
+            { "files", source.counters.files },
+            { "bytes", source.counters.bytes },
+        };
+        printf("%s\n", line.dump().c_str());
+    }
+
+    const nlohmann::json line = {
+        { "type", "total" },
+        { "results", metrics.GetResults() },
+        { "first_result_ms", OptionalMs(metrics.GetFirstMs()) },
+        { "elapsed_ms", elapsed_ms },
+    };
+    printf("%s\n", line.dump().c_str());
+}
+
+int ConsoleQuery::Run(const std::vector<Searcher*>& searchers) const
+{
+    SearcherRunList runs;
+    wxString        names;
+    for (Searcher* s : searchers)
+    {
+        names += (names.empty() ? "" : ", ") + s->GetName();
+        if (searcher.empty() || s->GetName().IsSameAs(searcher, false))
+        {
+            SearcherRun run;
+            run.searcher = s;
+            runs.push_back(run);
+        }
+    }
+    if (runs.empty())
+    {
+        fprintf(stderr, "Searcher `%s` is not enabled, available: %s\n", searcher.utf8_str().data(),
+                names.utf8_str().data());
+        return 2;
+    }
+
+    /* Timings only cover the query, not the build of the catalog and index. */
+    if (resident)
+    {
+        for (SearcherRun& run : runs)
+        {
+            run.searcher->WaitReady();
+        }
+    }
+
+    /* Enabled before the searchers start, so their threads record from the beginning. */
+    if (!trace.empty())
+    {
+        Trace::SetEnabled(true);
+    }
+
+    QueryMetrics             metrics;
+    Searcher::NotifierPtr    notifier = std::make_shared<Notifier>();
+    const Searcher::QueryPtr compiled = std::make_shared<const SearchQuery>(query);
+
+    /* The GUI waits for the user to finish typing, here the query is complete and a typo is an error. */
+    const wxString invalid = !compiled->IsValid() ? compiled->error : compiled->incomplete;
+    if (!invalid.empty())
+    {
+        fprintf(stderr, "Invalid filter: %s\n", invalid.utf8_str().data());
+        return 2;
+    }
+    if (!compiled->content.error.empty())
+    {
+        fprintf(stderr, "Invalid content query `%s`: %s\n", compiled->text.utf8_str().data(),
+                compiled->content.error.c_str());
+        return 2;
+    }
+
+    for (SearcherRun& run : runs)
+    {
+        run.iterator = run.searcher->Query(compiled, notifier);
+        run.source = metrics.AddSource(run.searcher->GetName(), Searcher::Counters());
+    }
+
+    /* Same loop as the GUI, except that results are printed as soon as they are fetched. */
+    std::list<SearcherRun*> pending;
+    for (SearcherRun& run : runs)
+    {
+        pending.push_back(&run);
+    }
+
+    while (!pending.empty())
+    {
+        /* Read the epoch before fetching, so anything published meanwhile ends the wait below. */
+        const uint64_t epoch = notifier->GetEpoch();
+
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            SearcherRun*          run = *it;
+            Searcher::ResultBatch batch;
+            Searcher::ResultCode  code = run->iterator->Fetch(batch);
+            metrics.OnResults(run->source, batch.size(), run->iterator->GetCounters());
+            for (const Searcher::Result& result : batch)
+            {
+                PrintResult(*run, result, json);
+            }
+
+            if (code == Searcher::ResultCode::End)
+            {
+                metrics.OnFinished(run->source, run->iterator->GetCounters());
+                it = pending.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        fflush(stdout);
+
+        if (!pending.empty())
+        {
+            notifier->Wait(epoch);
+        }
+    }
+
+    for (SearcherRun& run : runs)
+    {
+        run.iterator.reset();
+    }
+    if (!trace.empty())
+    {
+        Trace::Save(trace);
+    }
+
+    PrintSummary(metrics, json);
+    fflush(stdout);
+    return metrics.GetResults() != 0 ? 0 : 1;
+}
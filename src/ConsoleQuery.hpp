@@ -0,0 +1,40 @@
+#ifndef LAUNCHR_CONSOLE_QUERY_HPP
+#define LAUNCHR_CONSOLE_QUERY_HPP
+
+#include <wx/string.h>
+#include <vector>
+#include "searchers/Searcher.hpp"
+
+namespace LR
+{
+
+/**
+ * @brief Run a query without GUI, printing results to stdout as they arrive.
+ *
+ * Results are printed as `title<TAB>path` lines, content matches add the line
+ * number and snippet, or as JSON lines. Timing and work of every searcher are
+ * summarized at the end, to stderr in text mode.
+ *
+ * By default the searchers build nothing in background, a one-shot query
+ * walks the disk. With `resident` they keep the catalog and index of the GUI,
+ * and the query waits until they are built.
+ */
+struct ConsoleQuery
+{
+    /**
+     * @brief Run the query until every searcher finishes.
+     * @param[in] searchers Registered searchers.
+     * @return 0 if something is found, 1 if nothing is found, 2 on error.
+     */
+    int Run(const std::vector<Searcher*>& searchers) const;
+
+    wxString query;            /* Query string. */
+    wxString searcher;         /* Name of the only searcher to run, all if empty. */
+    bool     json = false;     /* Print JSON lines. */
+    wxString trace;            /* Chrome trace file path, no trace if empty. */
+    bool     resident = false; /* Searchers keep their catalog and index, built before the query runs. */
+};
+
+} // namespace LR
+
+#endif
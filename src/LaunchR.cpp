@@ -1,9 +1,12 @@
 #include <wx/wx.h>
+#include <wx/cmdline.h>
 #include <wx/filename.h>
+#include <wx/msgout.h>
 #include <wx/stdpaths.h>
 #include "searchers/FileName.hpp"
 #include "searchers/PortableApps.hpp"
 #include "searchers/Text.hpp"
+#include "utils/Trace.hpp"
 #include "widgets/MainFrame.hpp"
 #include "LaunchR.hpp"
 
@@ -13,28 +16,130 @@ using namespace LR;
 
 static void RegisterSearcher(LaunchRApp* app)
 {
+    /* A one-shot console query does not pay for a catalog and index it would not use. */
+    const bool resident = app->console == nullptr || app->console->resident;
     if (app->settings->Get().PortableAppSupport)
     {
         app->searchers.push_back(new PortableAppSearcher);
     }
     if (app->settings->Get().FileNameSupport)
     {
-        app->searchers.push_back(new FileNameSearcher);
+        app->searchers.push_back(new FileNameSearcher(resident));
     }
     if (app->settings->Get().TextSupport)
     {
-        app->searchers.push_back(new TextSearcher);
+        app->searchers.push_back(new TextSearcher(resident));
     }
 }
 
+/**
+ * @brief Check if a query is given on the command line, before the GUI is initialized.
+ */
+static bool IsConsoleMode(int argc, wxChar** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const wxString arg(argv[i]);
+        if (arg == "-q" || arg == "--query" || arg.StartsWith("--query="))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Attach to the console of the parent process, the executable is built for the GUI subsystem.
+ */
+static void AttachParentConsole()
+{
+#ifdef __WXMSW__
+    /* Redirected output already has a handle and must be kept. */
+    if (GetFileType(GetStdHandle(STD_OUTPUT_HANDLE)) == FILE_TYPE_UNKNOWN && AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        freopen("CONOUT$", "w", stdout);
+        freopen("CONOUT$", "w", stderr);
+    }
+#endif
+}
+
+bool LaunchRApp::Initialize(int& argc, wxChar** argv)
+{
+    if (!IsConsoleMode(argc, argv))
+    {
+        return wxApp::Initialize(argc, argv);
+    }
+
+    /* The GUI toolkit is never initialized, so no display is needed. */
+    AttachParentConsole();
+    console = new LR::ConsoleQuery;
+    delete wxMessageOutput::Set(new wxMessageOutputStderr);
+    return wxAppConsole::Initialize(argc, argv);
+}
+
+void LaunchRApp::CleanUp()
+{
+    if (console == nullptr)
+    {
+        wxApp::CleanUp();
+        return;
+    }
+
+    delete console;
+    console = nullptr;
+    wxAppConsole::CleanUp();
+}
+
+void LaunchRApp::OnInitCmdLine(wxCmdLineParser& parser)
+{
+    wxApp::OnInitCmdLine(parser);
+    parser.AddOption("q", "query",
+                     _("Run the query without GUI and print results to stdout. "
+                       "The disk is searched directly, without the file catalog and content index"));
+    parser.AddOption("s", "searcher", _("Only run the searcher of this name"));
+    parser.AddSwitch("j", "json", _("Print results and summary as JSON lines"));
+    parser.AddOption("t", "trace", _("Save a Chrome trace of the query to this file"));
+    parser.AddSwitch("", "resident", _("Build the file catalog and content index first, then run the query"));
+}
+
+bool LaunchRApp::OnCmdLineParsed(wxCmdLineParser& parser)
+{
+    if (!wxApp::OnCmdLineParsed(parser))
+    {
+        return false;
+    }
+    if (console == nullptr)
+    {
+        return true;
+    }
+
+    parser.Found("query", &console->query);
+    parser.Found("searcher", &console->searcher);
+    console->json = parser.Found("json");
+    parser.Found("trace", &console->trace);
+    console->resident = parser.Found("resident");
+    return true;
+}
+
 bool LaunchRApp::OnInit()
 {
+    if (!wxApp::OnInit())
+    {
+        return false;
+    }
     wxLog::SetLogLevel(wxLOG_Debug);
 
     settings = new LR::SettingsManager();
     logger = new LR::FileLogger();
+    reaper = new LR::Reaper();
     RegisterSearcher(this);
 
+    if (console != nullptr)
+    {
+        return true;
+    }
+
+    Trace::SetEnabled(settings->Get().TraceQueries);
     auto frame = new LR::MainFrame(nullptr);
     frame->SetIcon(wxIcon("IDI_ICON1"));
     frame->Show(true);
@@ -42,8 +147,19 @@ bool LaunchRApp::OnInit()
     return true;
 }
 
+int LaunchRApp::OnRun()
+{
+    if (console == nullptr)
+    {
+        return wxApp::OnRun();
+    }
+    return console->Run(searchers);
+}
+
 int LaunchRApp::OnExit()
 {
+    /* Queries still being destroyed may use the searchers. */
+    delete reaper;
     for (auto searcher : searchers)
     {
         delete searcher;
@@ -5,14 +5,21 @@
 #include <wx/app.h>
 #include <vector>
 #include "searchers/Searcher.hpp"
+#include "ConsoleQuery.hpp"
 #include "utils/FileLogger.hpp"
+#include "utils/Reaper.hpp"
 #include "utils/Settings.hpp"
 
 class LaunchRApp final : public wxApp
 {
 public:
+    bool Initialize(int& argc, wxChar** argv) override;
+    void CleanUp() override;
     bool OnInit() override;
+    int  OnRun() override;
     int  OnExit() override;
+    void OnInitCmdLine(wxCmdLineParser& parser) override;
+    bool OnCmdLineParsed(wxCmdLineParser& parser) override;
 
 public:
     static wxString GetWorkingDir();
@@ -21,7 +28,9 @@ public:
 public:
     LR::SettingsManager*       settings = nullptr; /* Settings manager. */
     LR::FileLogger*            logger = nullptr;   /* File logger. */
+    LR::Reaper*                reaper = nullptr;   /* Destroys finished queries in background. */
     std::vector<LR::Searcher*> searchers;          /* Searchers. */
+    LR::ConsoleQuery*          console = nullptr;  /* Query to run without GUI, if requested on the command line. */
 };
 
 wxDECLARE_APP(LaunchRApp);
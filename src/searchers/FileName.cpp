@@ -1,97 +1,205 @@
 #include <wx/wx.h>
 #include <wx/log.h>
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <list>
 #include <mutex>
-#include <filesystem>
+#include "utils/FileCatalog.hpp"
+#include "utils/SearchQuery.hpp"
+#include "utils/Trace.hpp"
 #include "LaunchR.hpp"
 #include "FileName.hpp"
 
 using namespace LR;
 
+/**
+ * @brief Results are published in batches of this size, the walk also publishes after each directory.
+ */
+static const size_t RESULT_BATCH_SIZE = 256;
+
+struct FileNameSearcher::Data
+{
+    explicit Data(bool resident);
+    ~Data();
+
+    FileCatalog       catalog;                /* Resident filename catalog. */
+    std::atomic<bool> catalog_ready = false;  /* Catalog is built. */
+    std::atomic<bool> looping = true;         /* Looping flag. */
+    std::thread*      build_thread = nullptr; /* Catalog build thread, null once joined or if not resident. */
+};
+
 struct FileNameSearcherIter : Searcher::Iterator
 {
-    FileNameSearcherIter(const wxString& query);
+    FileNameSearcherIter(FileNameSearcher::Data* data, const Searcher::QueryPtr& query,
+                         Searcher::NotifierPtr notifier);
     ~FileNameSearcherIter() override;
-    Searcher::ResultVariant Next() override;
+    bool Refine(const Searcher::QueryPtr& query) override;
+    void Cancel() override;
 
-    wxString                query;               /* Query string. */
+    FileNameSearcher::Data* data;                /* Searcher data. */
+    Searcher::QueryPtr      query;               /* Compiled query, shared with the other searchers. */
+    bool                    from_catalog;        /* Search in catalog instead of walking the disk. */
     std::atomic<bool>       flag_running = true; /* Looping flag. */
+    std::atomic<bool>       flag_pause = false;  /* Stop the walk between directories, it can be resumed. */
     std::thread*            search_thread;       /* Search threads. */
-    std::list<std::wstring> pending_paths;       /* Paths to search. */
+    std::list<wxString>     pending_paths;       /* Paths to search. */
 
-    bool                        flag_done = false; /* Search done flag. */
-    std::list<Searcher::Result> results;           /* Storage for search results. */
-    std::mutex                  result_mutex;      /* Mutex for results. */
+    bool                  flag_done = false; /* Search done flag. */
+    Searcher::ResultBatch batch;             /* Results not published yet. */
+    Searcher::ResultBatch published;         /* All results found so far, filtered again by Refine(). */
+    std::mutex            result_mutex;      /* Mutex for flag_done, batch and published. */
 };
 
-static void SearchFileNameInPath(struct FileNameSearcherIter* searcher, const std::wstring& path)
+/**
+ * @brief Match a file whose name already passed SearchQuery::MatchName(), then name score, path and metadata.
+ * @return Score, std::nullopt if not matched.
+ */
+static std::optional<int> FileNameMatch(const SearchQuery& query, const wxString& name, const wxString& path)
+{
+    const std::optional<int> score = query.name.Score(name, path);
+    if (!score.has_value() || !query.MatchPathAndMetadata(path))
+    {
+        return std::nullopt;
+    }
+    return score;
+}
+
+/**
+ * @brief Record a result, publish it once the batch is full.
+ */
+static void FileNameAddResult(struct FileNameSearcherIter* searcher, Searcher::Result&& result)
 {
-    for (const auto& entry : std::filesystem::directory_iterator(path))
+    std::lock_guard<std::mutex> lock(searcher->result_mutex);
+    searcher->published.push_back(result);
+    searcher->batch.push_back(std::move(result));
+    if (searcher->batch.size() >= RESULT_BATCH_SIZE)
     {
+        /* On a full channel the batch keeps growing and goes with the next one. */
+        searcher->Publish(searcher->batch);
+    }
+}
+
+static void SearchFileNameInPath(struct FileNameSearcherIter* searcher, const wxString& path)
+{
+    TraceScope scope("Search directory");
+    uint64_t   files = 0;
+    FileSystemTraversal::ListDirectory(path, [searcher, &path, &files](FileSystemTraversal::FileInfo& info) {
         if (!searcher->flag_running)
         {
-            break;
+            return false;
         }
 
-        if (entry.is_directory())
+        if (!info.isfile)
         {
-            searcher->pending_paths.push_back(entry.path().wstring());
-            continue;
+            searcher->pending_paths.push_back(FileSystemTraversal::JoinPath(path, info.name));
+            return true;
         }
 
-        if (!entry.is_regular_file())
+        /* The path is only built for names that pass the cheap checks. */
+        files++;
+        if (!searcher->query->MatchName(info.name))
         {
-            continue;
+            return true;
         }
 
-        const wxString name(entry.path().filename().wstring());
-        const wxString name_lower = name.Lower();
-        const bool     matched = searcher->query.empty() || name_lower.Contains(searcher->query);
-
-        if (matched)
+        info.path = FileSystemTraversal::JoinPath(path, info.name);
+        const std::optional<int> score = FileNameMatch(*searcher->query, info.name, info.path);
+        if (score.has_value())
         {
             Searcher::Result ret;
-            ret.title = name;
-            ret.path = entry.path().wstring();
-
-            std::lock_guard<std::mutex> lock(searcher->result_mutex);
-            searcher->results.push_back(ret);
+            ret.title = std::move(info.name);
+            ret.path = std::move(info.path);
+            ret.score = score.value();
+            FileNameAddResult(searcher, std::move(ret));
         }
-    }
+        return true;
+    });
+    scope.SetArg("files", static_cast<int64_t>(files));
+    searcher->Count(1, files, 0);
 }
 
-static void SearchFileNameThread(struct FileNameSearcherIter* searcher)
+static void SearchFileNameInCatalog(struct FileNameSearcherIter* searcher)
 {
-    while (searcher->flag_running && !searcher->pending_paths.empty())
-    {
-        std::wstring path = searcher->pending_paths.front();
-        searcher->pending_paths.pop_front();
-
-        try
+    TraceScope scope("Search catalog");
+    scope.SetArg("entries", static_cast<int64_t>(searcher->data->catalog.GetCount()));
+    searcher->data->catalog.Query(searcher->query->name, [searcher](const FileSystemTraversal::FileInfo& info) {
+        if (!searcher->query->MatchName(info.name))
         {
-            SearchFileNameInPath(searcher, path);
+            return static_cast<bool>(searcher->flag_running);
         }
-        catch (const std::filesystem::filesystem_error& e)
+        const std::optional<int> score = FileNameMatch(*searcher->query, info.name, info.path);
+        if (!score.has_value())
         {
-            wxLogVerbose("Access fs failed: %s", e.what());
+            return static_cast<bool>(searcher->flag_running);
         }
-    }
 
+        Searcher::Result ret;
+        ret.title = info.name;
+        ret.path = info.path;
+        ret.score = score.value();
+        FileNameAddResult(searcher, std::move(ret));
+        return static_cast<bool>(searcher->flag_running);
+    });
+    searcher->Count(0, searcher->data->catalog.GetCount(), 0);
+}
+
+static void SearchFileNameInFileSystem(struct FileNameSearcherIter* searcher)
+{
+    while (searcher->flag_running && !searcher->flag_pause && !searcher->pending_paths.empty())
     {
+        const wxString path = std::move(searcher->pending_paths.front());
+        searcher->pending_paths.pop_front();
+        SearchFileNameInPath(searcher, path);
+
         std::lock_guard<std::mutex> lock(searcher->result_mutex);
-        searcher->flag_done = true;
+        searcher->Publish(searcher->batch);
+    }
+}
+
+static void SearchFileNameThread(struct FileNameSearcherIter* searcher)
+{
+    Trace::SetThreadName("FileName search");
+    if (searcher->from_catalog)
+    {
+        SearchFileNameInCatalog(searcher);
+    }
+    else
+    {
+        SearchFileNameInFileSystem(searcher);
+    }
+
+    std::lock_guard<std::mutex> lock(searcher->result_mutex);
+    searcher->PublishAll(searcher->batch, searcher->flag_running);
+
+    /* A paused walk is not done, it continues once the query is refined. */
+    searcher->flag_done = searcher->from_catalog || searcher->pending_paths.empty();
+    if (searcher->flag_done)
+    {
+        searcher->Finish();
     }
 }
 
-FileNameSearcherIter::FileNameSearcherIter(const wxString& query)
+FileNameSearcherIter::FileNameSearcherIter(FileNameSearcher::Data* data, const Searcher::QueryPtr& query,
+                                           Searcher::NotifierPtr notifier)
+    : Searcher::Iterator(std::move(notifier)), query(query)
 {
-    this->query = query.Lower();
+    this->data = data;
+
+    /* A query with an invalid filter matches nothing, there is nothing to walk. */
+    if (!query->IsValid())
+    {
+        from_catalog = false;
+        search_thread = nullptr;
+        flag_done = true;
+        Finish();
+        return;
+    }
 
-    const wxString     search_path = wxGetCwd();
-    const std::wstring search_path_std = search_path.ToStdWstring();
-    pending_paths.push_back(search_path_std);
+    /* Walk the disk directly until the catalog is available. */
+    this->from_catalog = data->catalog_ready;
+
+    pending_paths.push_back(wxGetCwd());
 
     search_thread = new std::thread(SearchFileNameThread, this);
 }
@@ -99,23 +207,136 @@ FileNameSearcherIter::FileNameSearcherIter(const wxString& query)
 FileNameSearcherIter::~FileNameSearcherIter()
 {
     flag_running = false;
+    if (search_thread != nullptr)
+    {
+        search_thread->join();
+        delete search_thread;
+    }
+}
+
+void FileNameSearcherIter::Cancel()
+{
+    flag_running = false;
+}
+
+bool FileNameSearcherIter::Refine(const Searcher::QueryPtr& query)
+{
+    if (!query->name.Narrows(this->query->name) || !query->FiltersNarrow(*this->query))
+    {
+        return false;
+    }
+
+    {
+        /* The catalog is searched in memory, starting over is as cheap as resuming. */
+        std::lock_guard<std::mutex> lock(result_mutex);
+        if (from_catalog && !flag_done)
+        {
+            return false;
+        }
+    }
+
+    /* The walk finishes the current directory first, so no entry is visited twice. */
+    flag_pause = true;
     search_thread->join();
     delete search_thread;
+    search_thread = nullptr;
+    flag_pause = false;
+
+    this->query = query;
+    Reopen();
+
+    {
+        /* The channel was just emptied, so the matching results fit in one batch. */
+        std::lock_guard<std::mutex> lock(result_mutex);
+        Searcher::ResultBatch candidates;
+        candidates.swap(published);
+        batch.clear();
+        for (Searcher::Result& candidate : candidates)
+        {
+            if (!this->query->MatchName(candidate.title))
+            {
+                continue;
+            }
+            const std::optional<int> score = FileNameMatch(*this->query, candidate.title, candidate.path.value());
+            if (score.has_value())
+            {
+                candidate.score = score.value();
+                published.push_back(std::move(candidate));
+            }
+        }
+        batch = published;
+        PublishAll(batch, flag_running);
+    }
+
+    if (flag_done)
+    {
+        Finish();
+    }
+    else
+    {
+        search_thread = new std::thread(SearchFileNameThread, this);
+    }
+    return true;
 }
 
-Searcher::ResultVariant FileNameSearcherIter::Next()
+static void BuildFileCatalog(FileNameSearcher::Data* data)
 {
-    std::lock_guard<std::mutex> lock(result_mutex);
-    if (results.empty())
+    const wxString root = wxGetCwd();
+
+    auto start_time = std::chrono::steady_clock::now();
+    data->catalog.Build(root, data->looping);
+    auto duration = std::chrono::steady_clock::now() - start_time;
+
+    wxLogVerbose("File catalog built: %zu entries in %lld ms", data->catalog.GetCount(),
+                 static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()));
+    data->catalog_ready = static_cast<bool>(data->looping);
+}
+
+FileNameSearcher::Data::Data(bool resident)
+{
+    if (resident)
+    {
+        build_thread = new std::thread(BuildFileCatalog, this);
+    }
+}
+
+FileNameSearcher::Data::~Data()
+{
+    looping = false;
+    if (build_thread != nullptr)
     {
-        return flag_done ? Searcher::ResultCode::End : Searcher::ResultCode::TryAgain;
+        build_thread->join();
+        delete build_thread;
     }
-    Searcher::Result ret = results.front();
-    results.pop_front();
-    return ret;
 }
 
-Searcher::IteratorPtr FileNameSearcher::Query(const wxString& query)
+FileNameSearcher::FileNameSearcher(bool resident)
+{
+    m_data = new Data(resident);
+}
+
+FileNameSearcher::~FileNameSearcher()
 {
-    return std::make_shared<FileNameSearcherIter>(query);
+    delete m_data;
+}
+
+wxString FileNameSearcher::GetName() const
+{
+    return "FileName";
+}
+
+Searcher::IteratorPtr FileNameSearcher::Query(const QueryPtr& query, NotifierPtr notifier)
+{
+    return std::make_shared<FileNameSearcherIter>(m_data, query, std::move(notifier));
+}
+
+void FileNameSearcher::WaitReady()
+{
+    /* The thread ends once the catalog is built, the watcher keeps it up to date afterwards. */
+    if (m_data->build_thread != nullptr)
+    {
+        m_data->build_thread->join();
+        delete m_data->build_thread;
+        m_data->build_thread = nullptr;
+    }
 }
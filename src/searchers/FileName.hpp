@@ -8,7 +8,19 @@ namespace LR
 
 struct FileNameSearcher : Searcher
 {
-    IteratorPtr Query(const wxString& query) override;
+    /**
+     * @param[in] resident Keep a catalog of the names under the working directory, watched for changes.
+     *   Otherwise every query walks the disk.
+     */
+    explicit FileNameSearcher(bool resident = true);
+    ~FileNameSearcher() override;
+
+    wxString    GetName() const override;
+    IteratorPtr Query(const QueryPtr& query, NotifierPtr notifier) override;
+    void        WaitReady() override;
+
+    struct Data;
+    struct Data* m_data;
 };
 
 } // namespace LR
@@ -1,41 +1,84 @@
 #include <wx/wx.h>
 #include <wx/dir.h>
+#include <wx/file.h>
 #include <wx/filefn.h>
 #include <wx/filename.h>
+#include <wx/log.h>
 #include <wx/regex.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
 #include <thread>
 #include <mutex>
+#include <nlohmann/json.hpp>
+#include "utils/SearchQuery.hpp"
 #include "LaunchR.hpp"
 #include "PortableApps.hpp"
 
 using namespace LR;
 typedef std::list<Searcher::Result> ResultList;
+typedef std::chrono::steady_clock   Clock;
+
+/* Catalog file layout, older files are ignored. */
+static const int CatalogVersion = 1;
+
+/* A query revalidates the catalog if the last scan is older than this. */
+static const std::chrono::seconds RefreshInterval(30);
+
+/* Launcher file name, the first group is the title. */
+static const char* LauncherPattern = "(.*Portable)\\.exe";
+
+struct PortableFolder
+{
+    int64_t       mtime = 0; /* Modification time of the folder when it was scanned. */
+    wxArrayString launchers; /* Launcher file names. */
+};
+
+typedef std::map<wxString, PortableFolder> FolderMap;
 
 struct PortableAppSearcher::Data
 {
     Data();
     ~Data();
 
-    ResultList results;
-    bool       search_finished;
-    std::mutex result_mutex;
+    wxString catalog_path; /* Catalog file path. */
+
+    ResultList              results;
+    bool                    search_finished; /* Results are usable, from the catalog file or a finished scan. */
+    bool                    scanning;        /* A revalidation is running. */
+    Clock::time_point       last_scan;       /* When the last revalidation finished. */
+    std::mutex              result_mutex;    /* Guard for the members above. */
+    std::condition_variable result_cond;     /* Signaled when the results become usable. */
 
-    wxRegEx      launcher_regex;
-    std::thread* scan_thread;
+    FolderMap         folders;     /* Scanned folders, only used by the scan thread. */
+    std::atomic<bool> looping;     /* Cleared to stop the scan. */
+    std::mutex        scan_mutex;  /* Guard for scan_thread. */
+    std::thread*      scan_thread; /* Loads the catalog file, then revalidates the folders. */
 };
 
 struct PortableAppSearcherIterator : Searcher::Iterator
 {
-    PortableAppSearcherIterator(struct PortableAppSearcher::Data* searcher, const wxString& query);
-    Searcher::ResultVariant Next() override;
+    PortableAppSearcherIterator(struct PortableAppSearcher::Data* searcher, const Searcher::QueryPtr& query,
+                                Searcher::NotifierPtr notifier);
+    ~PortableAppSearcherIterator() override;
+    bool Refine(const Searcher::QueryPtr& query) override;
+    void Cancel() override;
 
     struct PortableAppSearcher::Data* searcher;
-    wxString                          query;
-    ResultList                        query_results;
-    ResultList::iterator              current;
-    bool                              flag_query = false;
+    Searcher::QueryPtr                query;        /* Compiled query, shared with the other searchers. */
+    std::atomic<bool>                 flag_running; /* Cleared to stop the query thread. */
+    std::thread*                      query_thread; /* Waits for the scan, then publishes the matching launchers. */
 };
 
+static int64_t GetFolderMtime(const wxString& path)
+{
+    std::error_code ec;
+    const auto      mtime = std::filesystem::last_write_time(std::filesystem::path(path.ToStdWstring()), ec);
+    return ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count());
+}
+
 static wxArrayString GetFirstLevelFolder(const wxString& path)
 {
     wxArrayString folders;
@@ -78,52 +121,269 @@ static wxArrayString GetFirstLevelFile(const wxString& path)
     return files;
 }
 
-static void SearchPortableLauncher(PortableAppSearcher::Data* data, const wxString& path, const wxArrayString& files)
+static wxArrayString SearchPortableLauncher(wxRegEx& launcher_regex, const wxString& path)
+{
+    wxArrayString launchers;
+    for (const wxString& name : GetFirstLevelFile(path))
+    {
+        if (launcher_regex.Matches(name))
+        {
+            launchers.Add(name);
+        }
+    }
+    return launchers;
+}
+
+/**
+ * @brief Build the result list from the scanned folders.
+ */
+static ResultList GenPortableResults(const FolderMap& folders, const wxString& root)
 {
-    for (const wxString& name : files)
+    const wxUniChar sep = wxFileName::GetPathSeparator();
+    wxRegEx         launcher_regex(LauncherPattern);
+    ResultList      results;
+
+    for (const auto& it : folders)
     {
-        if (data->launcher_regex.Matches(name))
+        const wxString path = root + sep + it.first;
+        for (const wxString& name : it.second.launchers)
         {
+            if (!launcher_regex.Matches(name))
+            {
+                continue;
+            }
+
             Searcher::Result ret;
-            ret.title = data->launcher_regex.GetMatch(name, 1);
-            ret.path = path + wxFileName::GetPathSeparator() + name;
+            ret.title = launcher_regex.GetMatch(name, 1);
+            ret.path = path + sep + name;
+            results.push_back(ret);
+        }
+    }
+    return results;
+}
+
+static bool LoadPortableCatalog(const wxString& path, const wxString& root, FolderMap* folders)
+{
+    wxLogNull logNo; /* The file does not exist at the first start. */
+    wxFile    file;
+    if (!file.Open(path, wxFile::read))
+    {
+        return false;
+    }
 
+    wxString content;
+    file.ReadAll(&content, wxConvUTF8);
+    file.Close();
+
+    /* A damaged or foreign file is ignored, the folders are scanned again. */
+    try
+    {
+        nlohmann::json json = nlohmann::json::parse(content.ToStdString(wxConvUTF8));
+        if (json.at("version").get<int>() != CatalogVersion ||
+            wxString::FromUTF8(json.at("root").get<std::string>()) != root)
+        {
+            return false;
+        }
+
+        for (const nlohmann::json& item : json.at("folders"))
+        {
+            PortableFolder folder;
+            folder.mtime = item.at("mtime").get<int64_t>();
+            for (const nlohmann::json& name : item.at("launchers"))
             {
-                std::lock_guard<std::mutex> lock(data->result_mutex);
-                data->results.push_back(ret);
+                folder.launchers.Add(wxString::FromUTF8(name.get<std::string>()));
             }
+            (*folders)[wxString::FromUTF8(item.at("name").get<std::string>())] = folder;
         }
     }
+    catch (const nlohmann::json::exception&)
+    {
+        folders->clear();
+        return false;
+    }
+    return true;
 }
 
+static void SavePortableCatalog(const wxString& path, const wxString& root, const FolderMap& folders)
+{
+    wxFileName f(path);
+    if (!f.DirExists() && !f.Mkdir(wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+    {
+        wxLogWarning("Failed to create directory: %s", path);
+        return;
+    }
+
+    nlohmann::json items = nlohmann::json::array();
+    for (const auto& it : folders)
+    {
+        nlohmann::json launchers = nlohmann::json::array();
+        for (const wxString& name : it.second.launchers)
+        {
+            launchers.push_back(name.ToStdString(wxConvUTF8));
+        }
+        items.push_back({
+            { "name", it.first.ToStdString(wxConvUTF8) },
+            { "mtime", it.second.mtime },
+            { "launchers", launchers },
+        });
+    }
+
+    nlohmann::json json = {
+        { "version", CatalogVersion },
+        { "root", root.ToStdString(wxConvUTF8) },
+        { "folders", items },
+    };
+
+    /* Write aside and rename, so a crash never leaves a truncated catalog behind. */
+    const wxString    tmp_path = path + ".tmp";
+    const std::string content = json.dump();
+    wxFile            file;
+    if (!file.Open(tmp_path, wxFile::write) || file.Write(content.data(), content.size()) != content.size())
+    {
+        wxLogWarning("Failed to write portable apps catalog: %s", tmp_path);
+        return;
+    }
+    file.Close();
+    wxRenameFile(tmp_path, path, true);
+}
+
+/**
+ * @brief Scan the given folders in parallel.
+ * @return false if stopped.
+ */
+static bool ScanPortableFolders(PortableAppSearcher::Data* data, const wxString& root,
+                                std::vector<std::pair<wxString, PortableFolder*>>& stale)
+{
+    const wxUniChar sep = wxFileName::GetPathSeparator();
+
+    unsigned threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, stale.size()));
+
+    /* wxRegEx keeps the last match, so every worker has its own. */
+    std::atomic<size_t> next = 0;
+    auto                worker = [&]() {
+        wxRegEx launcher_regex(LauncherPattern);
+        size_t  i;
+        while (data->looping && (i = next.fetch_add(1)) < stale.size())
+        {
+            stale[i].second->launchers = SearchPortableLauncher(launcher_regex, root + sep + stale[i].first);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+    return data->looping;
+}
+
+static void PublishPortableResults(PortableAppSearcher::Data* data, ResultList&& results, bool finished)
+{
+    {
+        std::lock_guard<std::mutex> lock(data->result_mutex);
+        data->results = std::move(results);
+        data->search_finished = true;
+        if (finished)
+        {
+            data->scanning = false;
+            data->last_scan = Clock::now();
+        }
+    }
+    data->result_cond.notify_all();
+}
+
+/**
+ * @brief Revalidate the folders against their modification time, only changed folders are scanned again.
+ */
 static void SearchPortableApps(PortableAppSearcher::Data* data)
 {
     const wxUniChar sep = wxFileName::GetPathSeparator();
     const wxString  cwd = wxGetCwd();
 
-    wxArrayString dirs = GetFirstLevelFolder(cwd);
-    for (const wxString& name : dirs)
+    /* The catalog of the previous run answers the first queries while the folders are checked. */
+    if (data->folders.empty() && LoadPortableCatalog(data->catalog_path, cwd, &data->folders))
     {
-        const wxString path = cwd + sep + name;
-        wxArrayString  files = GetFirstLevelFile(path);
-        SearchPortableLauncher(data, path, files);
+        PublishPortableResults(data, GenPortableResults(data->folders, cwd), false);
     }
 
+    FolderMap                                         folders;
+    std::vector<std::pair<wxString, PortableFolder*>> stale;
+    for (const wxString& name : GetFirstLevelFolder(cwd))
+    {
+        PortableFolder&     folder = folders[name];
+        FolderMap::iterator it = data->folders.find(name);
+        folder.mtime = GetFolderMtime(cwd + sep + name);
+        if (it != data->folders.end() && it->second.mtime == folder.mtime && folder.mtime != 0)
+        {
+            folder.launchers = it->second.launchers;
+            continue;
+        }
+        stale.emplace_back(name, &folder);
+    }
+
+    const bool changed = !stale.empty() || folders.size() != data->folders.size();
+    if (!ScanPortableFolders(data, cwd, stale))
+    {
+        return;
+    }
+
+    if (changed)
+    {
+        wxLogVerbose("Portable apps: %zu of %zu folders scanned", stale.size(), folders.size());
+        data->folders.swap(folders);
+        SavePortableCatalog(data->catalog_path, cwd, data->folders);
+    }
+    PublishPortableResults(data, GenPortableResults(data->folders, cwd), true);
+}
+
+/**
+ * @brief Start a revalidation in background, unless one is running or the last one is recent.
+ */
+static void RefreshPortableApps(PortableAppSearcher::Data* data)
+{
     {
         std::lock_guard<std::mutex> lock(data->result_mutex);
-        data->search_finished = true;
+        if (data->scanning || Clock::now() - data->last_scan < RefreshInterval)
+        {
+            return;
+        }
+        data->scanning = true;
+    }
+
+    std::lock_guard<std::mutex> lock(data->scan_mutex);
+    if (data->scan_thread != nullptr)
+    {
+        data->scan_thread->join();
+        delete data->scan_thread;
     }
+    data->scan_thread = new std::thread(SearchPortableApps, data);
 }
 
 PortableAppSearcher::Data::Data()
 {
+    catalog_path = LaunchRApp::GenDataPath("portableapps.json");
     search_finished = false;
-    launcher_regex.Compile("(.*Portable)\\.exe");
+    scanning = true;
+    looping = true;
     scan_thread = new std::thread(SearchPortableApps, this);
 }
 
 PortableAppSearcher::Data::~Data()
 {
+    looping = false;
+
+    std::lock_guard<std::mutex> lock(scan_mutex);
     scan_thread->join();
     delete scan_thread;
 }
@@ -138,61 +398,102 @@ PortableAppSearcher::~PortableAppSearcher()
     delete m_data;
 }
 
-PortableAppSearcherIterator::PortableAppSearcherIterator(PortableAppSearcher::Data* searcher, const wxString& query)
-{
-    this->searcher = searcher;
-    this->query = query; /* Since wxWidgets 3.3, all string copies are deep. */
-}
-
-static void PerformPortableAppsQuery(PortableAppSearcherIterator* iter)
+static void PerformPortableAppsQuery(PortableAppSearcherIterator* iter, Searcher::ResultBatch& batch)
 {
-    const wxString q_lower = iter->query.Lower();
+    const SearchQuery& query = *iter->query;
     for (const auto& it : iter->searcher->results)
     {
-        const wxString t_lower = it.title.Lower();
-        const bool     matched = q_lower.empty() || t_lower.Contains(q_lower);
-
-        if (!matched)
+        /* Titles drop the extension, the filters see the launcher file name. */
+        const wxString& path = it.path.value();
+        const wxString  name = path.AfterLast(wxFileName::GetPathSeparator());
+        if (!query.MatchName(name))
+        {
+            continue;
+        }
+        const std::optional<int> score = query.name.Score(it.title, path);
+        if (!score.has_value() || !query.MatchPathAndMetadata(path))
         {
             continue;
         }
 
-        iter->query_results.push_back(it);
+        batch.push_back(it);
+        batch.back().score = score.value();
     }
-    iter->current = iter->query_results.begin();
 }
 
-Searcher::ResultVariant PortableAppSearcherIterator::Next()
+static void PortableAppsQueryThread(PortableAppSearcherIterator* iter)
 {
-    bool search_finished = false;
+    Searcher::ResultBatch batch;
     {
-        std::lock_guard<std::mutex> lock(searcher->result_mutex);
-        search_finished = searcher->search_finished;
+        std::unique_lock<std::mutex> lock(iter->searcher->result_mutex);
+        iter->searcher->result_cond.wait(lock,
+                                         [iter] { return iter->searcher->search_finished || !iter->flag_running; });
+        if (!iter->flag_running)
+        {
+            return;
+        }
+        PerformPortableAppsQuery(iter, batch);
+        iter->Count(0, iter->searcher->results.size(), 0);
     }
 
-    if (!search_finished)
-    {
-        return Searcher::ResultCode::TryAgain;
-    }
+    iter->PublishAll(batch, iter->flag_running);
+    iter->Finish();
+}
 
-    if (!flag_query)
+static void PortableAppsStopQuery(PortableAppSearcherIterator* iter)
+{
     {
-        flag_query = true;
-        PerformPortableAppsQuery(this);
+        std::lock_guard<std::mutex> lock(iter->searcher->result_mutex);
+        iter->flag_running = false;
     }
+    iter->searcher->result_cond.notify_all();
+}
 
-    if (current == query_results.end())
-    {
-        return Searcher::ResultCode::End;
-    }
+PortableAppSearcherIterator::PortableAppSearcherIterator(PortableAppSearcher::Data* searcher,
+                                                         const Searcher::QueryPtr& query,
+                                                         Searcher::NotifierPtr notifier)
+    : Searcher::Iterator(std::move(notifier))
+{
+    this->searcher = searcher;
+    this->query = query;
+    this->flag_running = true;
+    this->query_thread = new std::thread(PortableAppsQueryThread, this);
+}
 
-    Searcher::Result ret = *current;
-    ++current;
+PortableAppSearcherIterator::~PortableAppSearcherIterator()
+{
+    PortableAppsStopQuery(this);
+    query_thread->join();
+    delete query_thread;
+}
 
-    return ret;
+void PortableAppSearcherIterator::Cancel()
+{
+    PortableAppsStopQuery(this);
+}
+
+bool PortableAppSearcherIterator::Refine(const Searcher::QueryPtr& query)
+{
+    /* The launcher list is in memory, so filtering it again is as cheap as filtering the results. */
+    PortableAppsStopQuery(this);
+    query_thread->join();
+    delete query_thread;
+
+    RefreshPortableApps(searcher);
+    this->query = query;
+    this->flag_running = true;
+    Reopen();
+    query_thread = new std::thread(PortableAppsQueryThread, this);
+    return true;
+}
+
+wxString PortableAppSearcher::GetName() const
+{
+    return "PortableApps";
 }
 
-Searcher::IteratorPtr PortableAppSearcher::Query(const wxString& query)
+Searcher::IteratorPtr PortableAppSearcher::Query(const QueryPtr& query, NotifierPtr notifier)
 {
-    return std::make_shared<PortableAppSearcherIterator>(m_data, query);
+    RefreshPortableApps(m_data);
+    return std::make_shared<PortableAppSearcherIterator>(m_data, query, std::move(notifier));
 }
@@ -11,7 +11,8 @@ struct PortableAppSearcher : Searcher
     PortableAppSearcher();
     ~PortableAppSearcher() override;
 
-    IteratorPtr Query(const wxString& query) override;
+    wxString    GetName() const override;
+    IteratorPtr Query(const QueryPtr& query, NotifierPtr notifier) override;
 
     struct Data;
     struct Data* m_data;
@@ -1,13 +1,149 @@
+#include <thread>
+#include "utils/BoundedQueue.hpp"
 #include "Searcher.hpp"
 
 using namespace LR;
 
-Searcher::IteratorPtr Searcher::Query(const wxString&)
+/**
+ * @brief Max batches in the channel. Producers keep accumulating results while it is full.
+ */
+static const size_t CHANNEL_CAPACITY = 256;
+
+struct Searcher::Iterator::Data
+{
+    explicit Data(NotifierPtr notifier);
+
+    NotifierPtr                         notifier;    /* Consumer notifier. */
+    BoundedQueue<Searcher::ResultBatch> channel;     /* Published batches. */
+    std::atomic<bool>                   finished;    /* No more batches will be published. */
+    std::atomic<uint64_t>               directories; /* Directories visited. */
+    std::atomic<uint64_t>               files;       /* Files examined. */
+    std::atomic<uint64_t>               bytes;       /* Bytes scanned. */
+};
+
+Searcher::Iterator::Data::Data(NotifierPtr notifier) : channel(CHANNEL_CAPACITY)
+{
+    this->notifier = std::move(notifier);
+    this->finished = false;
+    this->directories = 0;
+    this->files = 0;
+    this->bytes = 0;
+}
+
+Searcher::IteratorPtr Searcher::Query(const QueryPtr&, NotifierPtr notifier)
+{
+    IteratorPtr it = std::make_shared<Searcher::Iterator>(std::move(notifier));
+    it->Finish();
+    return it;
+}
+
+void Searcher::WaitReady()
+{
+}
+
+Searcher::Iterator::Iterator(NotifierPtr notifier)
+{
+    m_data = new Data(std::move(notifier));
+}
+
+Searcher::Iterator::~Iterator()
+{
+    delete m_data;
+}
+
+Searcher::ResultCode Searcher::Iterator::Fetch(ResultBatch& batch)
+{
+    /* Read the flag first, so batches published before it was set are not missed. */
+    const bool finished = m_data->finished;
+
+    ResultBatch tmp;
+    while (m_data->channel.TryPop(tmp))
+    {
+        if (batch.empty())
+        {
+            batch.swap(tmp);
+        }
+        else
+        {
+            batch.insert(batch.end(), std::make_move_iterator(tmp.begin()), std::make_move_iterator(tmp.end()));
+        }
+        tmp.clear();
+    }
+
+    return finished ? ResultCode::End : ResultCode::TryAgain;
+}
+
+bool Searcher::Iterator::Refine(const QueryPtr&)
+{
+    return false;
+}
+
+void Searcher::Iterator::Cancel()
+{
+}
+
+bool Searcher::Iterator::Publish(ResultBatch& batch)
+{
+    if (batch.empty())
+    {
+        return true;
+    }
+    if (!m_data->channel.TryPush(batch))
+    {
+        return false;
+    }
+    batch.clear();
+    m_data->notifier->Notify();
+    return true;
+}
+
+void Searcher::Iterator::PublishAll(ResultBatch& batch, const std::atomic<bool>& running)
+{
+    /* The consumer drains the channel quickly, a full channel is rare. */
+    while (!Publish(batch) && running)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Searcher::Iterator::Finish()
+{
+    m_data->finished = true;
+    m_data->notifier->Notify();
+}
+
+void Searcher::Iterator::Reopen()
+{
+    m_data->finished = false;
+
+    ResultBatch tmp;
+    while (m_data->channel.TryPop(tmp))
+    {
+    }
+}
+
+void Searcher::Iterator::Count(uint64_t directories, uint64_t files, uint64_t bytes)
 {
-    return std::make_shared<Searcher::Iterator>();
+    /* Only summed up for reporting, no ordering is needed. */
+    if (directories != 0)
+    {
+        m_data->directories.fetch_add(directories, std::memory_order_relaxed);
+    }
+    if (files != 0)
+    {
+        m_data->files.fetch_add(files, std::memory_order_relaxed);
+    }
+    if (bytes != 0)
+    {
+        m_data->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
 }
 
-Searcher::ResultVariant Searcher::Iterator::Next()
+Searcher::Counters Searcher::Iterator::GetCounters() const
 {
-    return Searcher::ResultCode::End;
+    Counters counters;
+    counters.directories = m_data->directories.load(std::memory_order_relaxed);
+    counters.files = m_data->files.load(std::memory_order_relaxed);
+    counters.bytes = m_data->bytes.load(std::memory_order_relaxed);
+    return counters;
 }
@@ -2,39 +2,152 @@
 #define LAUNCHR_SEARCHER_HPP
 
 #include <wx/string.h>
-#include <variant>
+#include <atomic>
+#include <cstdint>
 #include <optional>
 #include <memory>
+#include <vector>
+#include "utils/Notifier.hpp"
+#include "utils/SearchQuery.hpp"
 
 namespace LR
 {
 
 struct Searcher
 {
+    struct Match
+    {
+        uint64_t line = 0;   /* Line number, the first line is 1. */
+        uint64_t offset = 0; /* Byte offset of the match in the file. */
+        wxString snippet;    /* Text of the line around the match. */
+    };
     struct Result
     {
-        wxString                title; /* Item title */
-        std::optional<wxString> path;  /* Item path. */
+        wxString                title;     /* Item title */
+        std::optional<wxString> path;      /* Item path. */
+        int                     score = 0; /* Relevance, higher scores are shown first. */
+        std::optional<Match>    match;     /* Matched line, only for content matches. */
     };
     enum class ResultCode : int
     {
         TryAgain, /* Try again. */
         End,      /* No more data. */
     };
-    using ResultVariant = std::variant<Result, ResultCode>;
+    struct Counters
+    {
+        uint64_t directories = 0; /* Directories visited. */
+        uint64_t files = 0;       /* Files or catalog entries examined. */
+        uint64_t bytes = 0;       /* Bytes of content scanned. */
+    };
+    typedef std::vector<Result>                ResultBatch;
+    typedef std::shared_ptr<Notifier>          NotifierPtr;
+    typedef std::shared_ptr<const SearchQuery> QueryPtr;
 
+    /**
+     * @brief Results of one query.
+     *
+     * Searcher threads publish batches of results into a bounded lock-free
+     * channel and notify the consumer, which sleeps on the notifier until data
+     * or completion arrives.
+     */
     struct Iterator
     {
-        Iterator() = default;
+        explicit Iterator(NotifierPtr notifier);
         Iterator(const Iterator& it) = delete;
-        virtual ~Iterator() = default;
+        virtual ~Iterator();
+
+        /**
+         * @brief Take all results published so far. Consumer thread only.
+         * @param[out] batch Results are appended to it.
+         * @return End once the search is finished and all results are taken, otherwise TryAgain.
+         */
+        ResultCode Fetch(ResultBatch& batch);
+
+        /**
+         * @brief Narrow the query, typically because the user typed more characters.
+         *
+         * On success the iterator starts over: results returned so far that still
+         * match are published again, then the unfinished part of the search
+         * continues with the new query.
+         *
+         * @param[in] query New query, containing the current one.
+         * @return false if the query cannot be refined, a new query is required.
+         */
+        virtual bool Refine(const QueryPtr& query);
+
+        /**
+         * @brief Ask background work to stop as soon as possible.
+         *
+         * Never blocks. The destructor still waits for the threads, but they
+         * are already on the way out, so cancelled iterators can be destroyed
+         * in parallel on another thread.
+         */
+        virtual void Cancel();
+
+        /**
+         * @brief Publish results and wake the consumer up. Safe to call from several threads.
+         * @param[in,out] batch Results, moved out if published.
+         * @return false if the channel is full, keep the results and try again later.
+         */
+        bool Publish(ResultBatch& batch);
 
-        virtual ResultVariant Next();
+        /**
+         * @brief Publish results, waiting for room in the channel.
+         * @param[in,out] batch Results, moved out if published.
+         * @param[in] running Give up once it is cleared.
+         */
+        void PublishAll(ResultBatch& batch, const std::atomic<bool>& running);
+
+        /**
+         * @brief Mark the search as finished, after the last result is published.
+         */
+        void Finish();
+
+        /**
+         * @brief Start over, dropping results not fetched yet. Only when no thread publishes.
+         */
+        void Reopen();
+
+        /**
+         * @brief Account work done by the search. Safe to call from several threads.
+         * @param[in] directories Directories visited.
+         * @param[in] files Files or catalog entries examined.
+         * @param[in] bytes Bytes of content scanned.
+         */
+        void Count(uint64_t directories, uint64_t files, uint64_t bytes);
+
+        /**
+         * @brief Get work done since the iterator was created, refined queries included.
+         */
+        Counters GetCounters() const;
+
+        struct Data;
+        struct Data* m_data;
     };
     using IteratorPtr = std::shared_ptr<Iterator>;
 
     virtual ~Searcher() = default;
-    virtual IteratorPtr Query(const wxString& query);
+
+    /**
+     * @brief Get searcher name, as used on the command line.
+     */
+    virtual wxString GetName() const = 0;
+
+    /**
+     * @brief Start a query.
+     * @param[in] query Compiled query, shared by all searchers.
+     * @param[in] notifier Notified whenever the iterator publishes results or finishes.
+     * @return Iterator.
+     */
+    virtual IteratorPtr Query(const QueryPtr& query, NotifierPtr notifier);
+
+    /**
+     * @brief Wait until the structures built in background, such as a catalog or an index, are ready.
+     *
+     * Queries never need to wait, they search the disk until then. This is for
+     * measuring the queries the GUI runs once the searcher is warm.
+     */
+    virtual void WaitReady();
 };
 
 } // namespace LR
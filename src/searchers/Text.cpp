@@ -1,118 +1,554 @@
 #include <wx/wx.h>
 #include <wx/filefn.h>
+#include <wx/filename.h>
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <mutex>
-#include <semaphore>
+#include <condition_variable>
 #include <list>
-#include "Utils/BoyerMoore.hpp"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <deque>
+#include <set>
+#include <vector>
+#include "utils/AsyncReader.hpp"
+#include "utils/ContentIndex.hpp"
+#include "utils/SearchQuery.hpp"
+#include "utils/TextMatcher.hpp"
+#include "utils/Trace.hpp"
 #include "utils/FileSystem.hpp"
 #include "LaunchR.hpp"
 #include "Text.hpp"
 
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace LR;
 
+/* Size of each buffer of the asynchronous reader. */
+static const size_t ReadBufferSize = 256 * 1024;
+
+/* Reads in flight are capped, every one holds a buffer. */
+static const unsigned MaxReadQueueDepth = 256;
+
+/* Snippets of long lines keep this many bytes on each side of the match. */
+static const size_t SnippetContext = 80;
+
+/**
+ * @brief File being searched through a buffer of the asynchronous reader.
+ */
+struct TextRead
+{
+    FileSystemTraversal::FileInfo info;              /* File being read. */
+    int                           fd = -1;           /* Open file, -1 if the buffer is free. */
+    uint64_t                      size = 0;          /* Bytes to search. */
+    uint64_t                      offset = 0;        /* File offset of the buffer content. */
+    size_t                        length = 0;        /* Bytes in the buffer. */
+    size_t                        overlap = 0;       /* Bytes shared with the previous buffer of the file. */
+    uint64_t                      found = 0;         /* Mask of terms found in previous buffers. */
+    const TextMatcher*            matcher = nullptr; /* Matcher selected by the first buffer. */
+};
+
+struct TextSearcher::Data
+{
+    explicit Data(bool resident);
+    ~Data();
+
+    ContentIndex            index;                  /* Trigram index of file content. */
+    std::atomic<bool>       index_ready = false;    /* Index is built, queries may use it. */
+    std::atomic<bool>       looping = true;         /* Looping flag, changed with stale_mutex held. */
+    std::thread*            index_thread = nullptr; /* Index build and update thread, null if disabled. */
+    std::set<wxString>      stale_files;            /* Files found changed by queries, indexed again. */
+    std::mutex              stale_mutex;            /* Mutex for stale_files, looping and index_ready. */
+    std::condition_variable stale_cond;             /* Signaled on a queued file, a ready index or a looping change. */
+};
+
 typedef std::list<std::thread*>                  ThreadList;
 typedef std::list<FileSystemTraversal::FileInfo> PathList;
-typedef std::list<Searcher::Result>              ResultList;
+typedef std::vector<TextRead>                    TextReadVec;
 
 struct TextSearcherIter : Searcher::Iterator
 {
-    explicit TextSearcherIter(const wxString& query);
+    TextSearcherIter(TextSearcher::Data* data, const Searcher::QueryPtr& query, Searcher::NotifierPtr notifier);
     ~TextSearcherIter() override;
-    Searcher::ResultVariant Next() override;
+    bool Refine(const Searcher::QueryPtr& query) override;
+    void Cancel() override;
+
+    std::atomic_bool looping;         /* Looping flag. */
+    std::atomic_bool workers_running; /* Content search threads run, cleared to stop them for Refine(). */
 
-    std::atomic_bool looping; /* Looping flag. */
+    Searcher::QueryPtr  query;                 /* Compiled query, shared with the other searchers. */
+    Searcher::QueryPtr  filters;               /* Query filtering the traversal, its filters never change. */
+    TextMatcher*        utf8_matcher;          /* Matcher for UTF-8 content. */
+    TextMatcher*        utf16_matcher;         /* Matcher for UTF-16LE content, null if disabled. */
+    size_t              min_length;            /* Shortest pattern of all matchers. */
+    size_t              max_length;            /* Longest pattern of all matchers. */
+    std::thread*        fs_traversal_thread;   /* Filesystem traversal thread. */
+    std::atomic_bool    fs_traversal_finished; /* Filesystem traversal finished. */
+    ThreadList          content_query_threads; /* Content search threads. */
+    size_t              workers_count;         /* The number of content search threads started. */
+    std::atomic<size_t> workers_finished;      /* The number of content search threads that ran out of files. */
 
-    wxString            query;                          /* Query string. */
-    std::thread*        fs_traversal_thread;            /* Filesystem traversal thread. */
-    std::atomic_bool    fs_traversal_finished;          /* Filesystem traversal finished. */
-    ThreadList          content_query_threads;          /* Content search threads. */
-    std::atomic<size_t> const_query_threads_exit_count; /* The number of query threads exited. */
+    PathList                query_files;       /* File list to query. */
+    std::mutex              query_files_mutex; /* Mutex for query_files and for changing the flags above. */
+    std::condition_variable query_files_cond;  /* Signaled when a file is queued or a flag changes. */
 
-    PathList                   query_files;       /* File list to query. */
-    std::mutex                 query_files_mutex; /* Mutex for query_files. */
-    std::counting_semaphore<>* query_files_sem;   /* Semaphore for file list. */
+    AsyncReader*            reader;         /* Reader keeping many files in flight, null to map files instead. */
+    std::thread*            reader_thread;  /* Thread opening files and collecting reads, null if not running. */
+    TextReadVec             reads;          /* File read into each reader buffer. */
+    std::deque<size_t>      ready_reads;    /* Buffers read and waiting for a worker, guarded by query_files_mutex. */
+    bool                    reads_finished; /* No more buffers are read, guarded by query_files_mutex. */
+    std::condition_variable read_cond;      /* Signaled when a buffer is ready or a flag changes. */
 
-    std::mutex result_mutex;
-    ResultList result_list;
+    std::set<wxString> skip_extensions; /* Lowercase extensions of files never searched. */
+
+    TextSearcher::Data*      data;       /* Searcher data. */
+    bool                     indexed;    /* Files are filtered by the content index. */
+    ContentIndex::Candidates candidates; /* Files the index allows, still valid after Refine() narrows the query. */
+
+    std::mutex            result_mutex; /* Mutex for published. */
+    Searcher::ResultBatch published;    /* Matched files, searched again by Refine(). */
 };
 
+/**
+ * @brief Check if the file is skipped by its extension, before it is opened.
+ */
+static bool TextSkipExtension(const std::set<wxString>& skip_extensions, const wxString& name)
+{
+    const size_t pos = name.rfind('.');
+    if (pos == wxString::npos || skip_extensions.empty())
+    {
+        return false;
+    }
+    return skip_extensions.count(name.substr(pos + 1).Lower()) != 0;
+}
+
+/**
+ * @brief Ask the index thread to index the file again.
+ */
+static void TextReindex(TextSearcher::Data* data, const wxString& path)
+{
+    {
+        std::lock_guard<std::mutex> guard(data->stale_mutex);
+        data->stale_files.insert(path);
+    }
+    data->stale_cond.notify_one();
+}
+
+/**
+ * @brief Check the file against the content index.
+ * @return true if the file must be searched.
+ */
+static bool TextIndexAllows(TextSearcherIter* searcher, const wxString& path)
+{
+    ContentIndex::FileKey key;
+    if (!ContentIndex::GetFileKey(path, &key))
+    {
+        return true;
+    }
+
+    switch (searcher->data->index.Check(searcher->candidates, path, key))
+    {
+    case ContentIndex::Verdict::Skip:
+        return false;
+    case ContentIndex::Verdict::Unknown:
+        TextReindex(searcher->data, path);
+        return true;
+    default:
+        return true;
+    }
+}
+
 static void TextSearchFileSystem(TextSearcherIter* searcher)
 {
+    Trace::SetThreadName("Text traversal");
+    TraceScope scope("Traverse file system");
+
     wxString cwd = wxGetCwd();
+    unsigned threads = wxGetApp().settings->Get().TraversalThreads;
 
-    FileSystemTraversal::Traversal(cwd, SIZE_MAX, [searcher](const FileSystemTraversal::FileInfo& info) {
-        if (info.isfile)
+    auto cb = [searcher](const FileSystemTraversal::FileInfo& info) {
+        if (!info.isfile)
         {
-            std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
-            searcher->query_files.push_back(info);
+            searcher->Count(1, 0, 0);
+        }
+        else if (!TextSkipExtension(searcher->skip_extensions, info.name) &&
+                 searcher->filters->MatchFile(info.name, info.path) &&
+                 (!searcher->indexed || TextIndexAllows(searcher, info.path)))
+        {
+            {
+                std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+                searcher->query_files.push_back(info);
+            }
+            searcher->query_files_cond.notify_one();
         }
-        searcher->query_files_sem->release();
 
         return static_cast<bool>(searcher->looping);
-    });
+    };
+    FileSystemTraversal::ParallelTraversal(cwd, SIZE_MAX, cb, threads);
 
-    searcher->fs_traversal_finished = true;
+    {
+        std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+        searcher->fs_traversal_finished = true;
+    }
+    searcher->query_files_cond.notify_all();
 }
 
-static void TextSearchFileContent(TextSearcherIter* searcher, const FileSystemTraversal::FileInfo& info, void* data,
-                                  size_t size)
+/**
+ * @brief Select the matcher by the encoding guessed from the first window.
+ * @return Matcher, nullptr if the content looks binary or cannot match and is skipped.
+ */
+static const TextMatcher* TextSelectMatcher(TextSearcherIter* searcher, const void* data, size_t size)
 {
-    wxScopedCharBuffer buf = searcher->query.ToUTF8();
-    size_t             bufSz = buf.length();
-    if (bufSz > size)
+    if (wxGetApp().settings->Get().TextSkipBinary && TextMatcher::IsBinary(data, size))
     {
-        return;
+        return nullptr;
+    }
+    if (TextMatcher::DetectEncoding(data, size) == TextMatcher::Encoding::Utf16Le)
+    {
+        /* Regular expressions only match UTF-8, their bytes would match UTF-16 content by accident. */
+        if (searcher->query->content.regex)
+        {
+            return nullptr;
+        }
+        if (searcher->utf16_matcher != nullptr)
+        {
+            return searcher->utf16_matcher;
+        }
     }
+    return searcher->utf8_matcher;
+}
+
+/**
+ * @brief Search the file window by window, so that memory usage is bounded by window size.
+ *   Every window overlaps the previous one, see TextMatcher::GetNextBlock(), so a match that
+ *   crosses the window boundary is still found.
+ */
+static bool TextSearchFileStream(TextSearcherIter* searcher, FileMemoryMap& view, uint64_t size, size_t window)
+{
+    const TextQuery&   query = searcher->query->content;
+    const TextMatcher* matcher = nullptr;
+    uint64_t           found = 0;
+    uint64_t           scanned = 0; /* Content is counted as scanned up to this offset. */
+    size_t             advance = 0;
+    window = std::max(window, searcher->max_length * 2);
 
-    BoyerMoore bm(buf.data(), bufSz);
-    auto       ret = bm.Search(data, size);
-    if (!ret.has_value())
+    for (uint64_t offset = 0; offset < size && searcher->looping && searcher->workers_running; offset += advance)
     {
-        return;
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(window, size - offset));
+        void*        addr = view.Map(offset, length);
+        if (addr == nullptr)
+        {
+            return false;
+        }
+        if (matcher == nullptr)
+        {
+            matcher = TextSelectMatcher(searcher, addr, length);
+            if (matcher == nullptr)
+            {
+                return false;
+            }
+        }
+        const unsigned cut = (offset > 0 ? Regex::CutStart : 0) | (offset + length < size ? Regex::CutEnd : 0);
+        found = matcher->Search(addr, length, found, cut);
+        searcher->Count(0, 0, offset + length - scanned);
+        scanned = offset + length;
+        if (query.IsSatisfied(found))
+        {
+            return true;
+        }
+        if (offset + length >= size)
+        {
+            break;
+        }
+        advance = matcher->GetNextBlock(addr, length);
+    }
+    return false;
+}
+
+static bool TextIsNewline(const uint8_t* p, size_t unit)
+{
+    return p[0] == '\n' && (unit == 1 || p[1] == 0);
+}
+
+/**
+ * @brief Get the line around the match, cut at SnippetContext bytes on each side of it.
+ * @param[in] data Window address.
+ * @param[in] size Window length.
+ * @param[in] at Match offset in the window.
+ * @param[in] length Match length.
+ * @param[in] unit Code unit size, 2 for UTF-16LE.
+ * @param[out] end End of the snippet.
+ * @return Start of the snippet.
+ */
+static size_t TextSnippetBounds(const uint8_t* data, size_t size, size_t at, size_t length, size_t unit, size_t* end)
+{
+    const size_t align = ~(unit - 1);
+    size_t       begin = at & align;
+    const size_t first = begin > SnippetContext ? begin - SnippetContext : 0;
+    while (begin > first && !TextIsNewline(data + begin - unit, unit))
+    {
+        begin -= unit;
+    }
+
+    const size_t match_end = (at + length + unit - 1) & align;
+    const size_t stop = std::min(match_end + SnippetContext, size & align);
+    size_t       pos = std::min(match_end, stop);
+    while (pos < stop && !TextIsNewline(data + pos, unit))
+    {
+        pos += unit;
+    }
+
+    /* A cut line must not split a UTF-8 sequence. */
+    if (unit == 1)
+    {
+        while (begin < at && (data[begin] & 0xC0) == 0x80)
+        {
+            begin++;
+        }
+        while (pos > at + length && pos < size && (data[pos] & 0xC0) == 0x80)
+        {
+            pos--;
+        }
     }
+    *end = pos;
+    return begin;
+}
 
+/**
+ * @brief Decode snippet bytes, control characters such as tabs become spaces.
+ */
+static wxString TextDecodeSnippet(const uint8_t* data, size_t size, TextMatcher::Encoding encoding)
+{
+    wxString ret;
+    if (encoding == TextMatcher::Encoding::Utf16Le)
+    {
+        for (size_t i = 0; i + 2 <= size; i += 2)
+        {
+            uint32_t cp = data[i] | data[i + 1] << 8;
+            if (cp >= 0xD800 && cp < 0xDC00 && i + 4 <= size)
+            {
+                const uint32_t low = data[i + 2] | data[i + 3] << 8;
+                if (low >= 0xDC00 && low < 0xE000)
+                {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    i += 2;
+                }
+            }
+            if (cp >= 0xD800 && cp < 0xE000)
+            {
+                cp = 0xFFFD;
+            }
+            ret += wxUniChar(cp < 0x20 ? ' ' : cp);
+        }
+        return ret.Trim().Trim(false);
+    }
+
+    std::string bytes(reinterpret_cast<const char*>(data), size);
+    std::replace_if(bytes.begin(), bytes.end(), [](char c) { return static_cast<uint8_t>(c) < 0x20; }, ' ');
+    ret = wxString::FromUTF8(bytes.data(), bytes.size());
+    if (ret.empty())
+    {
+        /* Not UTF-8, show the bytes as Latin-1. */
+        for (char c : bytes)
+        {
+            ret += wxUniChar(static_cast<uint8_t>(c));
+        }
+    }
+    return ret.Trim().Trim(false);
+}
+
+/**
+ * @brief Collect the first matching lines of a matched file.
+ *
+ * The file is mapped again window by window, it was just read so it comes
+ * from the page cache. Lines are only counted up to each match, and the
+ * snippet is decoded straight from the mapped window.
+ */
+static void TextLocateMatches(TextSearcherIter* searcher, const FileSystemTraversal::FileInfo& info,
+                              Searcher::ResultBatch* batch)
+{
+    const Settings& settings = wxGetApp().settings->Get();
+    FileMemoryMap   view(info.path, false);
+    uint64_t        size = view.GetFileSize();
+    if (settings.TextMaxSize != 0 && size > settings.TextMaxSize)
+    {
+        size = settings.TextMaxSize;
+    }
+
+    /*
+     * Windows overlap by a match and the context on both sides of it, a match
+     * is located in the window where its snippet fits. Window offsets stay
+     * even, so UTF-16 code units never straddle them. A regular expression
+     * whose matches may be longer but stay within a line moves to the next
+     * window at a line feed instead, see TextMatcher::GetNextBlock().
+     */
+    const size_t overlap = (searcher->max_length + SnippetContext * 2 + 1) & ~static_cast<size_t>(1);
+    const size_t window = std::max(settings.TextWindowSize, overlap * 4) & ~static_cast<size_t>(1);
+
+    const TextMatcher* matcher = nullptr;
+    size_t             unit = 1;
+    uint64_t           line = 1;    /* Line number at offset counted. */
+    uint64_t           counted = 0; /* Line feeds are counted up to this offset. */
+    uint64_t           next = 0;    /* Search resumes at this offset. */
+    size_t             advance = 0;
+    for (uint64_t offset = 0; offset < size && searcher->looping && searcher->workers_running; offset += advance)
+    {
+        const size_t   length = static_cast<size_t>(std::min<uint64_t>(window, size - offset));
+        const uint8_t* addr = static_cast<const uint8_t*>(view.Map(offset, length));
+        if (addr == nullptr)
+        {
+            return;
+        }
+        if (matcher == nullptr)
+        {
+            matcher = TextSelectMatcher(searcher, addr, length);
+            if (matcher == nullptr)
+            {
+                return;
+            }
+            unit = matcher->GetEncoding() == TextMatcher::Encoding::Utf16Le ? 2 : 1;
+        }
+
+        const TextMatcher::Encoding encoding = matcher->GetEncoding();
+        const bool                  last = offset + length >= size;
+        const size_t                block = last ? length : matcher->GetNextBlock(addr, length);
+        const bool                  by_line = !last && block != length - (matcher->GetMaxLength() - 1);
+        const size_t                accept = last ? length : by_line ? block + 1 : length - overlap + SnippetContext;
+        advance = by_line ? block : length - overlap;
+        const unsigned              cut = (offset > 0 ? Regex::CutStart : 0) | (last ? 0 : Regex::CutEnd);
+        size_t                      pos = static_cast<size_t>(next - offset);
+        while (pos < accept)
+        {
+            size_t                      match_length = 0;
+            const std::optional<size_t> found = matcher->Find(addr, length, pos, &match_length, cut);
+            if (!found.has_value() || found.value() >= accept)
+            {
+                break;
+            }
+
+            const size_t at = found.value();
+            const size_t line_at = at & ~(unit - 1);
+            line += TextMatcher::CountNewlines(addr + (counted - offset), line_at - (counted - offset), encoding);
+            counted = offset + line_at;
+
+            size_t           end = 0;
+            const size_t     begin = TextSnippetBounds(addr, length, at, match_length, unit, &end);
+            Searcher::Match  match;
+            Searcher::Result result;
+            match.line = line;
+            match.offset = offset + at;
+            match.snippet = TextDecodeSnippet(addr + begin, end - begin, encoding);
+            result.title = info.name;
+            result.path = info.path;
+            result.match = std::move(match);
+            batch->push_back(std::move(result));
+            if (batch->size() >= settings.TextMatchesPerFile)
+            {
+                return;
+            }
+
+            /* Report a line once, the search goes on after it. An empty regular expression match still moves on. */
+            pos = std::max({ end, at + match_length, at + unit });
+        }
+        if (last)
+        {
+            break;
+        }
+
+        /* Nothing left before accept, line feeds up to the next window are counted once. */
+        const uint64_t boundary = offset + advance;
+        next = std::max<uint64_t>(offset + std::max(pos, accept), next);
+        if (counted < boundary)
+        {
+            line += TextMatcher::CountNewlines(addr + (counted - offset), boundary - counted, encoding);
+            counted = boundary;
+        }
+    }
+}
+
+static void TextPublishMatch(TextSearcherIter* searcher, const FileSystemTraversal::FileInfo& info)
+{
     Searcher::Result result;
     result.title = info.name;
     result.path = info.path;
 
     {
         std::lock_guard<std::mutex> guard(searcher->result_mutex);
-        searcher->result_list.push_back(result);
+        searcher->published.push_back(result);
     }
+
+    /* Matches are rare compared to files searched, so each one is published right away. */
+    Searcher::ResultBatch batch;
+    if (wxGetApp().settings->Get().TextMatchesPerFile != 0)
+    {
+        TraceScope scope("Locate matches");
+        TextLocateMatches(searcher, info, &batch);
+        scope.SetArg("matches", static_cast<int64_t>(batch.size()));
+    }
+    if (batch.empty())
+    {
+        batch.push_back(std::move(result));
+    }
+    searcher->PublishAll(batch, searcher->workers_running);
 }
 
 static void TextSearchFileWithPath(TextSearcherIter* searcher, const FileSystemTraversal::FileInfo& info)
 {
-    FileMemoryMap view(info.path);
-    void*         addr = view.GetAddr();
-    if (addr == nullptr)
+    const Settings& settings = wxGetApp().settings->Get();
+    TraceScope      scope("Search file");
+
+    searcher->Count(0, 1, 0);
+    FileMemoryMap view(info.path, false);
+    uint64_t      size = view.GetFileSize();
+    if (settings.TextMaxSize != 0 && size > settings.TextMaxSize)
+    {
+        size = settings.TextMaxSize;
+    }
+    scope.SetArg("bytes", static_cast<int64_t>(size));
+    if (size < searcher->min_length || (settings.TextSkipSize != 0 && view.GetFileSize() > settings.TextSkipSize))
     {
         return;
     }
-    size_t size = view.GetSize();
-    size_t cfgTextMaxSize = wxGetApp().settings->Get().TextMaxSize;
-    if (cfgTextMaxSize != 0 && size > cfgTextMaxSize)
+
+    if (!TextSearchFileStream(searcher, view, size, settings.TextWindowSize))
     {
-        size = cfgTextMaxSize;
+        /* Interrupted by Refine(), search the file again with the new query. */
+        if (!searcher->workers_running)
+        {
+            std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+            searcher->query_files.push_front(info);
+        }
+        return;
     }
 
-    TextSearchFileContent(searcher, info, addr, size);
+    TextPublishMatch(searcher, info);
 }
 
 static void TextSearchFile(TextSearcherIter* searcher)
 {
-    while (searcher->looping && !searcher->fs_traversal_finished)
+    Trace::SetThreadName("Text worker");
+    for (;;)
     {
-        (void)searcher->query_files_sem->try_acquire_for(std::chrono::milliseconds(100));
-
         FileSystemTraversal::FileInfo fileInfo;
         {
-            std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+            std::unique_lock<std::mutex> lock(searcher->query_files_mutex);
+            searcher->query_files_cond.wait(lock, [searcher] {
+                return !searcher->looping || !searcher->workers_running || searcher->fs_traversal_finished ||
+                       !searcher->query_files.empty();
+            });
+            if (!searcher->looping || !searcher->workers_running)
+            {
+                return;
+            }
             if (searcher->query_files.empty())
             {
-                continue;
+                break;
             }
             fileInfo = searcher->query_files.front();
             searcher->query_files.pop_front();
@@ -120,10 +556,338 @@ static void TextSearchFile(TextSearcherIter* searcher)
         TextSearchFileWithPath(searcher, fileInfo);
     }
 
-    ++searcher->const_query_threads_exit_count;
+    /* The last thread running out of files finishes the search. */
+    if (++searcher->workers_finished == searcher->workers_count)
+    {
+        searcher->Finish();
+    }
+}
+
+#if !defined(WIN32)
+
+/**
+ * @brief Open the next queued file for the read, files filtered by size are skipped.
+ * @return true if a file is opened, false if no file is queued.
+ */
+static bool TextReadOpen(TextSearcherIter* searcher, TextRead& read)
+{
+    const Settings& settings = wxGetApp().settings->Get();
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+            if (searcher->query_files.empty())
+            {
+                return false;
+            }
+            read.info = searcher->query_files.front();
+            searcher->query_files.pop_front();
+        }
+
+        searcher->Count(0, 1, 0);
+        const int fd = open(read.info.path.fn_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            wxLogWarning("Cannot open file `" + read.info.path + "`");
+            continue;
+        }
+
+        struct stat st;
+        uint64_t    size = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ? st.st_size : 0;
+        if (settings.TextSkipSize != 0 && size > settings.TextSkipSize)
+        {
+            size = 0;
+        }
+        if (settings.TextMaxSize != 0 && size > settings.TextMaxSize)
+        {
+            size = settings.TextMaxSize;
+        }
+        if (size == 0 || size < searcher->min_length)
+        {
+            close(fd);
+            continue;
+        }
+
+        read.fd = fd;
+        read.size = size;
+        read.offset = 0;
+        read.length = 0;
+        read.overlap = 0;
+        read.found = 0;
+        read.matcher = nullptr;
+        return true;
+    }
+}
+
+static void TextReadClose(TextRead& read)
+{
+    close(read.fd);
+    read.fd = -1;
+}
+
+/**
+ * @brief Read queued files into the reader buffers and hand every filled buffer to a worker.
+ *   A worker reads the next part of the file into the same buffer, or posts the buffer back
+ *   once the file is done, so one thread keeps every buffer busy without blocking on the disk.
+ */
+static void TextReadFiles(TextSearcherIter* searcher)
+{
+    Trace::SetThreadName("Text reader");
+
+    AsyncReader*        reader = searcher->reader;
+    std::vector<size_t> idle;
+    size_t              busy = 0;
+    for (size_t i = reader->GetBufferCount(); i > 0; i--)
+    {
+        idle.push_back(i - 1);
+    }
+
+    while (searcher->looping && searcher->workers_running)
+    {
+        while (!idle.empty() && TextReadOpen(searcher, searcher->reads[idle.back()]))
+        {
+            const size_t buffer = idle.back();
+            TextRead&    read = searcher->reads[buffer];
+            if (!reader->Submit(buffer, read.fd, 0, static_cast<size_t>(std::min<uint64_t>(read.size, ReadBufferSize))))
+            {
+                TextReadClose(read);
+                continue;
+            }
+            idle.pop_back();
+            busy++;
+        }
+
+        if (busy == 0)
+        {
+            std::unique_lock<std::mutex> lock(searcher->query_files_mutex);
+            if (searcher->fs_traversal_finished && searcher->query_files.empty())
+            {
+                break;
+            }
+            searcher->query_files_cond.wait(lock, [searcher] {
+                return !searcher->looping || !searcher->workers_running || searcher->fs_traversal_finished ||
+                       !searcher->query_files.empty();
+            });
+            continue;
+        }
+
+        AsyncReader::Completion completion;
+        {
+            TraceScope scope("Wait for reads");
+            if (!reader->Wait(completion))
+            {
+                continue;
+            }
+        }
+
+        /* A buffer is posted back once its file is done, a failed or empty read also ends the file. */
+        TextRead& read = searcher->reads[completion.buffer];
+        if (read.fd >= 0 && completion.result <= 0)
+        {
+            TextReadClose(read);
+        }
+        if (read.fd < 0)
+        {
+            idle.push_back(completion.buffer);
+            busy--;
+            continue;
+        }
+
+        read.length = static_cast<size_t>(completion.result);
+        {
+            std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+            searcher->ready_reads.push_back(completion.buffer);
+        }
+        searcher->read_cond.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+        searcher->reads_finished = true;
+    }
+    searcher->read_cond.notify_all();
 }
 
-TextSearcherIter::TextSearcherIter(const wxString& query)
+/**
+ * @brief Search a filled buffer, then read the next part of the file or post the buffer back.
+ *   Every part overlaps the previous one, like mapped windows.
+ */
+static void TextSearchRead(TextSearcherIter* searcher, size_t buffer)
+{
+    AsyncReader* reader = searcher->reader;
+    TextRead&    read = searcher->reads[buffer];
+    const void*  data = reader->GetBuffer(buffer);
+    TraceScope   scope("Search buffer");
+    scope.SetArg("bytes", static_cast<int64_t>(read.length));
+
+    if (read.matcher == nullptr)
+    {
+        read.matcher = TextSelectMatcher(searcher, data, read.length);
+        if (read.matcher == nullptr)
+        {
+            TextReadClose(read);
+            reader->Post(buffer);
+            return;
+        }
+    }
+
+    const size_t overlap = read.matcher->GetMaxLength() - 1;
+    const unsigned cut =
+        (read.offset > 0 ? Regex::CutStart : 0) | (read.offset + read.length < read.size ? Regex::CutEnd : 0);
+    read.found = read.matcher->Search(data, read.length, read.found, cut);
+    searcher->Count(0, 0, read.length - std::min(read.overlap, read.length));
+    if (searcher->query->content.IsSatisfied(read.found))
+    {
+        TextReadClose(read);
+        TextPublishMatch(searcher, read.info);
+        reader->Post(buffer);
+        return;
+    }
+
+    /* A short read that cannot move past the overlap means the file shrank. */
+    if (read.offset + read.length >= read.size || read.length <= overlap)
+    {
+        TextReadClose(read);
+        reader->Post(buffer);
+        return;
+    }
+
+    const size_t advance = read.matcher->GetNextBlock(data, read.length);
+    read.overlap = read.length - advance;
+    read.offset += advance;
+    const size_t length = static_cast<size_t>(std::min<uint64_t>(read.size - read.offset, ReadBufferSize));
+    if (!reader->Submit(buffer, read.fd, read.offset, length))
+    {
+        TextReadClose(read);
+        reader->Post(buffer);
+    }
+}
+
+static void TextSearchReads(TextSearcherIter* searcher)
+{
+    Trace::SetThreadName("Text worker");
+    for (;;)
+    {
+        size_t buffer;
+        {
+            std::unique_lock<std::mutex> lock(searcher->query_files_mutex);
+            searcher->read_cond.wait(lock, [searcher] {
+                return !searcher->looping || !searcher->workers_running || searcher->reads_finished ||
+                       !searcher->ready_reads.empty();
+            });
+            if (!searcher->looping || !searcher->workers_running)
+            {
+                return;
+            }
+            if (searcher->ready_reads.empty())
+            {
+                break;
+            }
+            buffer = searcher->ready_reads.front();
+            searcher->ready_reads.pop_front();
+        }
+        TextSearchRead(searcher, buffer);
+    }
+
+    if (++searcher->workers_finished == searcher->workers_count)
+    {
+        searcher->Finish();
+    }
+}
+
+#endif
+
+/**
+ * @brief Start the asynchronous reader if it is enabled and the query fits its buffers.
+ * @return true if workers must search buffers of the reader instead of mapping files.
+ */
+static bool TextStartReader(TextSearcherIter* searcher)
+{
+#if defined(WIN32)
+    (void)searcher;
+    return false;
+#else
+    const unsigned depth = std::min(wxGetApp().settings->Get().TextReadQueueDepth, MaxReadQueueDepth);
+    if (depth == 0 || searcher->max_length * 2 > ReadBufferSize)
+    {
+        return false;
+    }
+
+    if (searcher->reader == nullptr)
+    {
+        searcher->reader = AsyncReader::Create(depth, ReadBufferSize);
+        if (searcher->reader == nullptr)
+        {
+            return false;
+        }
+        searcher->reads.resize(searcher->reader->GetBufferCount());
+        wxLogVerbose("Text search reads %u files at once with %s", depth, searcher->reader->GetName());
+    }
+
+    searcher->ready_reads.clear();
+    searcher->reads_finished = false;
+    searcher->reader_thread = new std::thread(TextReadFiles, searcher);
+    return true;
+#endif
+}
+
+/**
+ * @brief Stop the asynchronous reader once the workers are stopped.
+ *   Files still being read are queued again, to be searched from the start with the next query.
+ */
+static void TextStopReader(TextSearcherIter* searcher)
+{
+#if !defined(WIN32)
+    if (searcher->reader_thread == nullptr)
+    {
+        return;
+    }
+
+    searcher->reader->Interrupt();
+    searcher->reader_thread->join();
+    delete searcher->reader_thread;
+    searcher->reader_thread = nullptr;
+
+    /* Nothing may read into the buffers or from the files once they are reused or closed. */
+    searcher->reader->Drain();
+
+    std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+    for (TextRead& read : searcher->reads)
+    {
+        if (read.fd >= 0)
+        {
+            searcher->query_files.push_front(read.info);
+            TextReadClose(read);
+        }
+    }
+    searcher->ready_reads.clear();
+#else
+    (void)searcher;
+#endif
+}
+
+static void TextCompileQuery(TextSearcherIter* searcher)
+{
+    const Settings& settings = wxGetApp().settings->Get();
+
+    delete searcher->utf8_matcher;
+    delete searcher->utf16_matcher;
+    searcher->utf16_matcher = nullptr;
+
+    searcher->utf8_matcher =
+        new TextMatcher(searcher->query->content, TextMatcher::Encoding::Utf8, settings.TextIgnoreCase);
+    searcher->min_length = searcher->utf8_matcher->GetMinLength();
+    searcher->max_length = searcher->utf8_matcher->GetMaxLength();
+    if (settings.TextUtf16Support && !searcher->query->content.regex)
+    {
+        searcher->utf16_matcher =
+            new TextMatcher(searcher->query->content, TextMatcher::Encoding::Utf16Le, settings.TextIgnoreCase);
+        searcher->min_length = std::min(searcher->min_length, searcher->utf16_matcher->GetMinLength());
+        searcher->max_length = std::max(searcher->max_length, searcher->utf16_matcher->GetMaxLength());
+    }
+}
+
+static void TextStartWorkers(TextSearcherIter* searcher)
 {
     /* Use max 12 threads to query text. */
     unsigned cpus = std::thread::hardware_concurrency();
@@ -132,30 +896,95 @@ TextSearcherIter::TextSearcherIter(const wxString& query)
         cpus = 12;
     }
 
-    this->query = query;
+    searcher->workers_running = true;
+    searcher->workers_count = cpus;
+    searcher->workers_finished = 0;
+
+    /* With the reader, workers only match content and never wait for the disk. */
+    const bool reading = TextStartReader(searcher);
+    for (unsigned i = 0; i < cpus; i++)
+    {
+#if !defined(WIN32)
+        if (reading)
+        {
+            searcher->content_query_threads.push_back(new std::thread(TextSearchReads, searcher));
+            continue;
+        }
+#endif
+        searcher->content_query_threads.push_back(new std::thread(TextSearchFile, searcher));
+    }
+}
+
+static void TextStopWorkers(TextSearcherIter* searcher)
+{
+    {
+        std::lock_guard<std::mutex> guard(searcher->query_files_mutex);
+        searcher->workers_running = false;
+    }
+    searcher->query_files_cond.notify_all();
+    searcher->read_cond.notify_all();
+
+    for (auto t : searcher->content_query_threads)
+    {
+        t->join();
+        delete t;
+    }
+    searcher->content_query_threads.clear();
+    TextStopReader(searcher);
+}
+
+TextSearcherIter::TextSearcherIter(TextSearcher::Data* data, const Searcher::QueryPtr& query,
+                                   Searcher::NotifierPtr notifier)
+    : Searcher::Iterator(std::move(notifier)), query(query), filters(query)
+{
+    this->data = data;
+    this->indexed = false;
+    this->utf8_matcher = nullptr;
+    this->utf16_matcher = nullptr;
+    this->min_length = 0;
+    this->max_length = 0;
     this->fs_traversal_finished = false;
-    this->const_query_threads_exit_count = 0;
-    this->query_files_sem = new std::counting_semaphore<>(0);
+    this->workers_count = 0;
+    this->workers_finished = 0;
+    this->reader = nullptr;
+    this->reader_thread = nullptr;
+    this->reads_finished = false;
+
+    this->workers_running = false;
 
-    if (!query.empty())
+    for (const std::string& ext : wxGetApp().settings->Get().TextSkipExtensions)
     {
-        looping = true;
-        fs_traversal_thread = new std::thread(TextSearchFileSystem, this);
-        for (unsigned i = 0; i < cpus; i++)
+        skip_extensions.insert(wxString::FromUTF8(ext).Lower());
+    }
+
+    /* Files are filtered by name, path and metadata first, content is searched last. */
+    if (!query->content.groups.empty() && query->IsValid())
+    {
+        TextCompileQuery(this);
+
+        /* Until the index is built every file is searched. */
+        if (data->index_ready)
         {
-            content_query_threads.push_back(new std::thread(TextSearchFile, this));
+            TraceScope scope("Query content index");
+            data->index.Query(query->content, wxGetApp().settings->Get().TextSkipBinary, &candidates);
+            indexed = true;
         }
+
+        looping = true;
+        fs_traversal_thread = new std::thread(TextSearchFileSystem, this);
+        TextStartWorkers(this);
     }
     else
     {
         looping = false;
         fs_traversal_thread = nullptr;
+        Finish();
     }
 }
 
 TextSearcherIter::~TextSearcherIter()
 {
-    looping = false;
+    Cancel();
 
     if (fs_traversal_thread != nullptr)
     {
@@ -163,40 +992,180 @@ TextSearcherIter::~TextSearcherIter()
         delete fs_traversal_thread;
     }
 
-    for (auto t : content_query_threads)
+    TextStopWorkers(this);
+
+    delete reader;
+    delete utf8_matcher;
+    delete utf16_matcher;
+}
+
+void TextSearcherIter::Cancel()
+{
+    /* Content search checks the flags between windows, so even a large file stops quickly. */
     {
-        t->join();
-        delete t;
+        std::lock_guard<std::mutex> guard(query_files_mutex);
+        looping = false;
+        workers_running = false;
+    }
+    query_files_cond.notify_all();
+    read_cond.notify_all();
+}
+
+bool TextSearcherIter::Refine(const Searcher::QueryPtr& query)
+{
+    /* The traversal keeps applying the filters it started with, so they must stay the same. */
+    if (!looping || query->content.groups.empty() || !query->SameFilters(*this->query) ||
+        !query->content.Narrows(this->query->content, wxGetApp().settings->Get().TextIgnoreCase))
+    {
+        return false;
+    }
+
+    /* The traversal keeps queueing files while the content search threads are stopped. */
+    TextStopWorkers(this);
+
+    this->query = query;
+    TextCompileQuery(this);
+    Reopen();
+
+    /* Matched files are searched again first, files that did not match can never match the refined query. */
+    {
+        std::lock_guard<std::mutex> files_guard(query_files_mutex);
+        std::lock_guard<std::mutex> result_guard(result_mutex);
+
+        PathList recheck;
+        for (const Searcher::Result& result : published)
+        {
+            FileSystemTraversal::FileInfo info;
+            info.name = result.title;
+            info.path = result.path.value();
+            info.isfile = true;
+            recheck.push_back(info);
+        }
+        published.clear();
+        query_files.splice(query_files.begin(), recheck);
     }
 
-    delete query_files_sem;
+    TextStartWorkers(this);
+    return true;
 }
 
-Searcher::ResultVariant TextSearcherIter::Next()
+/**
+ * @brief Load and update the content index, then index files found changed by queries.
+ */
+static void TextIndexThread(TextSearcher::Data* data)
 {
-    if (!looping)
+    Trace::SetThreadName("Text index");
+
+    const Settings&    settings = wxGetApp().settings->Get();
+    const wxString     root = wxGetCwd();
+    const wxString     path = LaunchRApp::GenDataPath("content.index");
+    const wxString     data_dir = LaunchRApp::GenDataPath(nullptr) + wxFileName::GetPathSeparator();
+    std::set<wxString> skip_extensions;
+    for (const std::string& ext : settings.TextSkipExtensions)
+    {
+        skip_extensions.insert(wxString::FromUTF8(ext).Lower());
+    }
+
+    /* The index lives inside the tree it indexes, keep it and the other data files out. */
+    auto filter = [&skip_extensions, &data_dir](const FileSystemTraversal::FileInfo& info) {
+        return !info.path.StartsWith(data_dir) && !TextSkipExtension(skip_extensions, info.name);
+    };
+
+    auto       start_time = std::chrono::steady_clock::now();
+    const bool loaded = data->index.Load(path, root, settings.TextMaxSize);
+    data->index.Build(root, filter, settings.TextMaxSize, data->looping);
+    if (!data->looping)
+    {
+        return;
+    }
+
+    auto duration = std::chrono::steady_clock::now() - start_time;
+    wxLogVerbose("Content index %s: %zu files, %zu trigrams in %lld ms", loaded ? "updated" : "built",
+                 data->index.GetFileCount(), data->index.GetTrigramCount(),
+                 static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()));
     {
-        return Searcher::ResultCode::End;
+        std::lock_guard<std::mutex> guard(data->stale_mutex);
+        data->index_ready = true;
     }
+    data->stale_cond.notify_all();
+    data->index.Save(path);
 
+    for (;;)
     {
-        std::lock_guard<std::mutex> guard(result_mutex);
-        if (!result_list.empty())
+        std::set<wxString> stale;
         {
-            Searcher::Result result = result_list.front();
-            result_list.pop_front();
-            return result;
+            std::unique_lock<std::mutex> lock(data->stale_mutex);
+            data->stale_cond.wait(lock, [data] { return !data->looping || !data->stale_files.empty(); });
+            if (!data->looping)
+            {
+                break;
+            }
+            stale.swap(data->stale_files);
+        }
+        for (const wxString& file : stale)
+        {
+            if (!file.StartsWith(data_dir))
+            {
+                data->index.Update(file);
+            }
         }
     }
 
-    if (const_query_threads_exit_count != content_query_threads.size())
+    if (data->index.IsDirty())
+    {
+        data->index.Save(path);
+    }
+}
+
+TextSearcher::Data::Data(bool resident)
+{
+    if (resident && wxGetApp().settings->Get().TextContentIndex)
+    {
+        index_thread = new std::thread(TextIndexThread, this);
+    }
+}
+
+TextSearcher::Data::~Data()
+{
+    {
+        std::lock_guard<std::mutex> guard(stale_mutex);
+        looping = false;
+    }
+    stale_cond.notify_all();
+
+    if (index_thread != nullptr)
     {
-        return Searcher::ResultCode::TryAgain;
+        index_thread->join();
+        delete index_thread;
     }
-    return Searcher::ResultCode::End;
 }
 
-Searcher::IteratorPtr TextSearcher::Query(const wxString& query)
+TextSearcher::TextSearcher(bool resident)
+{
+    m_data = new Data(resident);
+}
+
+TextSearcher::~TextSearcher()
 {
-    return std::make_shared<TextSearcherIter>(query);
+    delete m_data;
+}
+
+wxString TextSearcher::GetName() const
+{
+    return "Text";
+}
+
+Searcher::IteratorPtr TextSearcher::Query(const QueryPtr& query, NotifierPtr notifier)
+{
+    return std::make_shared<TextSearcherIter>(m_data, query, std::move(notifier));
+}
+
+void TextSearcher::WaitReady()
+{
+    if (m_data->index_thread == nullptr)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_data->stale_mutex);
+    m_data->stale_cond.wait(lock, [this] { return m_data->index_ready || !m_data->looping; });
 }
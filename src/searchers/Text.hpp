@@ -8,7 +8,19 @@ namespace LR
 
 struct TextSearcher : Searcher
 {
-    IteratorPtr Query(const wxString& query) override;
+    /**
+     * @param[in] resident Keep the content index up to date, if enabled in the settings.
+     *   Otherwise every query walks the disk.
+     */
+    explicit TextSearcher(bool resident = true);
+    ~TextSearcher() override;
+
+    wxString    GetName() const override;
+    IteratorPtr Query(const QueryPtr& query, NotifierPtr notifier) override;
+    void        WaitReady() override;
+
+    struct Data;
+    struct Data* m_data;
 };
 
 } // namespace LR
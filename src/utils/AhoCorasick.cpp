@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <queue>
+#include <vector>
+#include "AhoCorasick.hpp"
+
+using namespace LR;
+
+typedef uint32_t StateId;
+
+/* Transitions of every state are stored in one row of this size. */
+static const size_t AlphabetSize = 256;
+
+struct Utf16Pattern
+{
+    std::vector<uint8_t> bytes; /* Pattern, ASCII letters in lowercase. */
+    std::vector<uint8_t> fold;  /* Bits to set on each text byte before comparing. */
+    size_t               id;    /* Pattern id. */
+};
+
+struct AhoCorasick::Data
+{
+    bool                               ignore_case = false; /* ASCII case-insensitive. */
+    bool                               verify = false;      /* Matches must be verified against the patterns. */
+    std::vector<StateId>               delta;               /* Transition table, AlphabetSize entries for each state. */
+    std::vector<uint64_t>              output;              /* Ids of patterns that end in each state. */
+    std::vector<uint32_t>              length;              /* Length of the longest pattern that ends in each state. */
+    size_t                             max_length = 0;      /* Length of the longest pattern. */
+    std::vector<Utf16Pattern>          patterns;            /* Patterns to verify. */
+    std::vector<std::vector<uint32_t>> ends;                /* Patterns to verify that end in each state. */
+};
+
+static inline uint8_t FoldAscii(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<uint8_t>(c | 0x20) : c;
+}
+
+static StateId AddState(AhoCorasick::Data* data)
+{
+    const StateId state = static_cast<StateId>(data->output.size());
+    data->delta.resize(data->delta.size() + AlphabetSize, 0);
+    data->output.push_back(0);
+    data->length.push_back(0);
+    if (data->verify)
+    {
+        data->ends.emplace_back();
+    }
+    return state;
+}
+
+/**
+ * @brief Verify the patterns ending in the state.
+ *
+ * The automaton folds every byte, but in UTF-16 a byte is only an ASCII
+ * letter if it is the low byte of a unit whose high byte is zero, so a match
+ * of the automaton is only a candidate, e.g. U+4E2D also reaches the state of
+ * U+6E2D. Candidates are rare, they are checked against the patterns here.
+ * @param[in] data Automaton.
+ * @param[in] state State reached.
+ * @param[in] end End of the candidate in the text, with at least the length of the patterns before it.
+ * @param[out] length Length of the longest pattern verified.
+ * @return Ids of patterns verified.
+ */
+static uint64_t VerifyEnds(const AhoCorasick::Data* data, StateId state, const uint8_t* end, size_t* length)
+{
+    uint64_t ids = 0;
+    *length = 0;
+    for (uint32_t index : data->ends[state])
+    {
+        const Utf16Pattern& pattern = data->patterns[index];
+        const size_t        n = pattern.bytes.size();
+        const uint8_t*      text = end - n;
+        size_t              i = 0;
+        while (i < n && (text[i] | pattern.fold[i]) == pattern.bytes[i])
+        {
+            i++;
+        }
+        if (i == n)
+        {
+            ids |= static_cast<uint64_t>(1) << pattern.id;
+            *length = std::max(*length, n);
+        }
+    }
+    return ids;
+}
+
+AhoCorasick::AhoCorasick(bool ignore_case, size_t unit_size)
+{
+    m_data = new Data;
+    m_data->ignore_case = ignore_case;
+    m_data->verify = ignore_case && unit_size == 2;
+    AddState(m_data);
+}
+
+AhoCorasick::AhoCorasick(const AhoCorasick& orig)
+{
+    m_data = new Data;
+    *m_data = *orig.m_data;
+}
+
+AhoCorasick& AhoCorasick::operator=(const AhoCorasick& orig)
+{
+    if (this != &orig)
+    {
+        *m_data = *orig.m_data;
+    }
+    return *this;
+}
+
+AhoCorasick::~AhoCorasick()
+{
+    delete m_data;
+}
+
+bool AhoCorasick::AddPattern(const void* pattern, size_t length, size_t id)
+{
+    if (id >= MaxIds || length == 0)
+    {
+        return false;
+    }
+
+    /* While building, a zero transition means no edge because nothing goes back to the root. */
+    const uint8_t* pat = static_cast<const uint8_t*>(pattern);
+    StateId        state = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        const uint8_t c = m_data->ignore_case ? FoldAscii(pat[i]) : pat[i];
+        StateId       next = m_data->delta[state * AlphabetSize + c];
+        if (next == 0)
+        {
+            next = AddState(m_data);
+            m_data->delta[state * AlphabetSize + c] = next;
+        }
+        state = next;
+    }
+
+    m_data->output[state] |= static_cast<uint64_t>(1) << id;
+    m_data->length[state] = static_cast<uint32_t>(length);
+    m_data->max_length = std::max(m_data->max_length, length);
+
+    if (m_data->verify)
+    {
+        Utf16Pattern utf16{ std::vector<uint8_t>(pat, pat + length), std::vector<uint8_t>(length, 0), id };
+        for (size_t i = 0; i + 1 < length; i += 2)
+        {
+            uint8_t& c = utf16.bytes[i];
+            if (pat[i + 1] == 0 && FoldAscii(c) >= 'a' && FoldAscii(c) <= 'z')
+            {
+                c = FoldAscii(c);
+                utf16.fold[i] = 0x20;
+            }
+        }
+        m_data->ends[state].push_back(static_cast<uint32_t>(m_data->patterns.size()));
+        m_data->patterns.push_back(std::move(utf16));
+    }
+    return true;
+}
+
+void AhoCorasick::Compile()
+{
+    /*
+     * Turn the trie into a full DFA in BFS order: a missing edge follows the
+     * edge of the failure state, which is already complete since it is closer
+     * to the root.
+     */
+    std::vector<StateId> fail(m_data->output.size(), 0);
+    std::queue<StateId>  pending;
+
+    for (size_t c = 0; c < AlphabetSize; c++)
+    {
+        const StateId next = m_data->delta[c];
+        if (next != 0)
+        {
+            pending.push(next);
+        }
+    }
+
+    while (!pending.empty())
+    {
+        const StateId state = pending.front();
+        pending.pop();
+        m_data->output[state] |= m_data->output[fail[state]];
+        if (m_data->length[state] == 0)
+        {
+            m_data->length[state] = m_data->length[fail[state]];
+        }
+        if (m_data->verify)
+        {
+            const std::vector<uint32_t>& inherited = m_data->ends[fail[state]];
+            m_data->ends[state].insert(m_data->ends[state].end(), inherited.begin(), inherited.end());
+        }
+
+        StateId*       row = &m_data->delta[state * AlphabetSize];
+        const StateId* fail_row = &m_data->delta[fail[state] * AlphabetSize];
+        for (size_t c = 0; c < AlphabetSize; c++)
+        {
+            if (row[c] != 0)
+            {
+                fail[row[c]] = fail_row[c];
+                pending.push(row[c]);
+            }
+            else
+            {
+                row[c] = fail_row[c];
+            }
+        }
+    }
+
+    /* Upper case letters go wherever lower case letters go, so the text needs no folding while searching. */
+    if (m_data->ignore_case)
+    {
+        for (size_t state = 0; state < m_data->output.size(); state++)
+        {
+            StateId* row = &m_data->delta[state * AlphabetSize];
+            for (size_t c = 'A'; c <= 'Z'; c++)
+            {
+                row[c] = row[c | 0x20];
+            }
+        }
+    }
+}
+
+uint64_t AhoCorasick::Search(const void* data, size_t size, uint64_t found, const Callback& cb) const
+{
+    const uint8_t*  text = static_cast<const uint8_t*>(data);
+    const StateId*  delta = m_data->delta.data();
+    const uint64_t* output = m_data->output.data();
+
+    StateId state = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        state = delta[state * AlphabetSize + text[i]];
+
+        uint64_t out = output[state];
+        if ((out & ~found) != 0 && m_data->verify)
+        {
+            size_t length;
+            out = VerifyEnds(m_data, state, text + i + 1, &length);
+        }
+        if ((out & ~found) != 0)
+        {
+            found |= out;
+            if (!cb(found))
+            {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+std::optional<size_t> AhoCorasick::Find(const void* data, size_t size, size_t* length) const
+{
+    const uint8_t*  text = static_cast<const uint8_t*>(data);
+    const StateId*  delta = m_data->delta.data();
+    const uint64_t* output = m_data->output.data();
+
+    /*
+     * The match that ends first may start after another one, e.g. `oba` is
+     * found before `foobar`. A match starting earlier, or a longer one from
+     * the same start, ends within the longest pattern from the best start.
+     */
+    std::optional<size_t> start;
+    size_t                end = size;
+    StateId               state = 0;
+    for (size_t i = 0; i < end; i++)
+    {
+        state = delta[state * AlphabetSize + text[i]];
+        if (output[state] == 0)
+        {
+            continue;
+        }
+
+        size_t n = m_data->length[state];
+        if (m_data->verify && VerifyEnds(m_data, state, text + i + 1, &n) == 0)
+        {
+            continue;
+        }
+        const size_t pos = i + 1 - n;
+        if (!start.has_value() || pos < start.value() || (pos == start.value() && n > *length))
+        {
+            start = pos;
+            *length = n;
+            end = std::min(size, pos + m_data->max_length);
+        }
+    }
+    return start;
+}
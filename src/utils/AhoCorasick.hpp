@@ -0,0 +1,79 @@
+#ifndef LAUNCHR_UTILS_AHO_CORASICK_HPP
+#define LAUNCHR_UTILS_AHO_CORASICK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+namespace LR
+{
+
+/**
+ * @brief Aho-Corasick automaton that finds several binary patterns in one pass.
+ *
+ * Every pattern is tagged with an id below 64 and found ids are reported as a
+ * bit mask. Several patterns may share one id, for example the spellings of
+ * the same term in different encodings.
+ */
+struct AhoCorasick
+{
+    static constexpr size_t MaxIds = 64;
+
+    /**
+     * @brief Called when a pattern not in the mask yet is found.
+     * @param[in] found Mask of all ids found so far.
+     * @return true to continue search, false to stop.
+     */
+    typedef std::function<bool(uint64_t found)> Callback;
+
+    /**
+     * @brief Constructor for Aho-Corasick.
+     * @param[in] ignore_case Match ASCII letters in any case.
+     * @param[in] unit_size Code unit size, 2 for UTF-16LE where only the low byte of a unit below 0x80 is a letter.
+     */
+    explicit AhoCorasick(bool ignore_case = false, size_t unit_size = 1);
+    AhoCorasick(const AhoCorasick& orig);
+    AhoCorasick& operator=(const AhoCorasick&);
+    ~AhoCorasick();
+
+    /**
+     * @brief Add a pattern. Must be called before Compile().
+     * @param[in] pattern Pattern data.
+     * @param[in] length Pattern length.
+     * @param[in] id Pattern id, less than MaxIds.
+     * @return true if added.
+     */
+    bool AddPattern(const void* pattern, size_t length, size_t id);
+
+    /**
+     * @brief Build the automaton from added patterns.
+     */
+    void Compile();
+
+    /**
+     * @brief Search all patterns in given binary data. Safe to call from several threads.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @param[in] found Mask of ids already found, for example in previous blocks of the same file.
+     * @param[in] cb Called when a new id is found.
+     * @return Mask of ids found.
+     */
+    uint64_t Search(const void* data, size_t size, uint64_t found, const Callback& cb) const;
+
+    /**
+     * @brief Find the leftmost occurrence of any pattern. Safe to call from several threads.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @param[out] length Length of the pattern found, the longest one if several start at the same position.
+     * @return If found, return the matching start position. If not found, return null.
+     */
+    std::optional<size_t> Find(const void* data, size_t size, size_t* length) const;
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
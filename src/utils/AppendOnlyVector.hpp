@@ -0,0 +1,101 @@
+#ifndef LAUNCHR_UTILS_APPEND_ONLY_VECTOR_HPP
+#define LAUNCHR_UTILS_APPEND_ONLY_VECTOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace LR
+{
+
+/**
+ * @brief Append-only vector that is read without locks.
+ *
+ * Elements live in fixed size chunks that never move, chunk pointers live in a
+ * fixed directory. The writer publishes the size with a release store, so any
+ * thread may read elements below Size() while the writer appends.
+ *
+ * Writers must be serialized by the caller. Clear() must not run concurrently
+ * with anything else.
+ */
+template <typename T, size_t ChunkBits = 14>
+struct AppendOnlyVector
+{
+    static constexpr size_t ChunkSize = static_cast<size_t>(1) << ChunkBits;
+    static constexpr size_t MaxChunks = 16384;
+
+    AppendOnlyVector() : chunks(new std::atomic<T*>[MaxChunks])
+    {
+        for (size_t i = 0; i < MaxChunks; i++)
+        {
+            chunks[i].store(nullptr, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+    }
+    AppendOnlyVector(const AppendOnlyVector&) = delete;
+
+    ~AppendOnlyVector()
+    {
+        Clear();
+    }
+
+    /**
+     * @brief Append an element.
+     * @param[in] value Element.
+     * @return false if the vector is full.
+     */
+    bool PushBack(const T& value)
+    {
+        const size_t n = count.load(std::memory_order_relaxed);
+        const size_t c = n >> ChunkBits;
+        if (c >= MaxChunks)
+        {
+            return false;
+        }
+
+        T* chunk = chunks[c].load(std::memory_order_relaxed);
+        if (chunk == nullptr)
+        {
+            chunk = new T[ChunkSize];
+            chunks[c].store(chunk, std::memory_order_release);
+        }
+        chunk[n & (ChunkSize - 1)] = value;
+        count.store(n + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Get the number of published elements.
+     */
+    size_t Size() const
+    {
+        return count.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Get an element below Size().
+     */
+    const T& operator[](size_t index) const
+    {
+        return chunks[index >> ChunkBits].load(std::memory_order_acquire)[index & (ChunkSize - 1)];
+    }
+
+    /**
+     * @brief Remove all elements and release memory.
+     */
+    void Clear()
+    {
+        for (size_t i = 0; i < MaxChunks; i++)
+        {
+            delete[] chunks[i].exchange(nullptr, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_release);
+    }
+
+    std::unique_ptr<std::atomic<T*>[]> chunks; /* Chunk directory. */
+    std::atomic<size_t>                count;  /* Number of published elements. */
+};
+
+} // namespace LR
+
+#endif
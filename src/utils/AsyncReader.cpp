@@ -0,0 +1,554 @@
+#include <wx/wx.h>
+#include <wx/log.h>
+#include "AsyncReader.hpp"
+
+#if !defined(WIN32)
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace LR;
+
+#if !defined(WIN32)
+
+/* Threads of the pread() backend, more mostly adds contention on the same device. */
+static const size_t MaxPreadThreads = 8;
+
+/* Completion of Interrupt(). */
+static const size_t InterruptBuffer = SIZE_MAX;
+
+AsyncReader::AsyncReader(size_t buffers, size_t buffer_size)
+{
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    this->buffer_count = buffers;
+    this->buffer_size = (buffer_size + pageSize - 1) / pageSize * pageSize;
+    this->memory_size = this->buffer_count * this->buffer_size;
+
+    void* ptr = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    this->memory = ptr != MAP_FAILED ? static_cast<uint8_t*>(ptr) : nullptr;
+}
+
+AsyncReader::~AsyncReader()
+{
+    if (memory != nullptr)
+    {
+        munmap(memory, memory_size);
+    }
+}
+
+void* AsyncReader::GetBuffer(size_t buffer) const
+{
+    return memory + buffer * buffer_size;
+}
+
+size_t AsyncReader::GetBufferCount() const
+{
+    return buffer_count;
+}
+
+size_t AsyncReader::GetBufferSize() const
+{
+    return buffer_size;
+}
+
+struct PreadRequest
+{
+    size_t   buffer; /* Buffer index. */
+    int      fd;     /* File descriptor. */
+    uint64_t offset; /* File offset. */
+    size_t   length; /* Bytes to read. */
+};
+
+/**
+ * @brief Reads done by a thread pool, for systems without io_uring.
+ */
+struct PreadReader : AsyncReader
+{
+    PreadReader(size_t buffers, size_t buffer_size);
+    ~PreadReader() override;
+    const char* GetName() const override;
+    bool        Submit(size_t buffer, int fd, uint64_t offset, size_t length) override;
+    void        Post(size_t buffer) override;
+    void        Interrupt() override;
+    bool        Wait(Completion& completion) override;
+    void        Drain() override;
+
+    /**
+     * @brief Queue a completion.
+     */
+    void Complete(size_t buffer, int64_t result);
+
+    std::mutex                mutex;           /* Guard for everything below. */
+    std::condition_variable   request_cond;    /* Signaled when a request is queued or on exit. */
+    std::condition_variable   completion_cond; /* Signaled when a completion is queued. */
+    std::deque<PreadRequest>  requests;        /* Reads not started yet. */
+    std::deque<Completion>    completions;     /* Completions not fetched yet. */
+    size_t                    in_flight;       /* Requests and completions not fetched yet. */
+    bool                      looping;         /* Threads keep running. */
+    std::vector<std::thread*> threads;         /* Reading threads. */
+};
+
+static void PreadThread(PreadReader* reader)
+{
+    for (;;)
+    {
+        PreadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(reader->mutex);
+            reader->request_cond.wait(lock, [reader] { return !reader->looping || !reader->requests.empty(); });
+            if (!reader->looping)
+            {
+                return;
+            }
+            request = reader->requests.front();
+            reader->requests.pop_front();
+        }
+
+        /* Read the whole length like io_uring does for regular files, stop early only at end of file. */
+        uint8_t* addr = static_cast<uint8_t*>(reader->GetBuffer(request.buffer));
+        int64_t  result = 0;
+        while (static_cast<size_t>(result) < request.length)
+        {
+            const ssize_t ret = pread(request.fd, addr + result, request.length - result,
+                                      static_cast<off_t>(request.offset + result));
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ret < 0)
+            {
+                result = result != 0 ? result : -errno;
+                break;
+            }
+            if (ret == 0)
+            {
+                break;
+            }
+            result += ret;
+        }
+        reader->Complete(request.buffer, result);
+    }
+}
+
+PreadReader::PreadReader(size_t buffers, size_t buffer_size) : AsyncReader(buffers, buffer_size)
+{
+    in_flight = 0;
+    looping = true;
+
+    const size_t count = std::min(buffers, MaxPreadThreads);
+    for (size_t i = 0; i < count; i++)
+    {
+        threads.push_back(new std::thread(PreadThread, this));
+    }
+}
+
+PreadReader::~PreadReader()
+{
+    Drain();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        looping = false;
+    }
+    request_cond.notify_all();
+
+    for (std::thread* t : threads)
+    {
+        t->join();
+        delete t;
+    }
+}
+
+const char* PreadReader::GetName() const
+{
+    return "pread";
+}
+
+bool PreadReader::Submit(size_t buffer, int fd, uint64_t offset, size_t length)
+{
+    PreadRequest request;
+    request.buffer = buffer;
+    request.fd = fd;
+    request.offset = offset;
+    request.length = std::min(length, buffer_size);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(request);
+        in_flight++;
+    }
+    request_cond.notify_one();
+    return true;
+}
+
+void PreadReader::Complete(size_t buffer, int64_t result)
+{
+    Completion completion;
+    completion.buffer = buffer;
+    completion.result = result;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        completions.push_back(completion);
+    }
+    completion_cond.notify_one();
+}
+
+void PreadReader::Post(size_t buffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        in_flight++;
+    }
+    Complete(buffer, 0);
+}
+
+void PreadReader::Interrupt()
+{
+    Post(InterruptBuffer);
+}
+
+bool PreadReader::Wait(Completion& completion)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    completion_cond.wait(lock, [this] { return !completions.empty(); });
+    completion = completions.front();
+    completions.pop_front();
+    in_flight--;
+    return completion.buffer != InterruptBuffer;
+}
+
+void PreadReader::Drain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (in_flight != 0)
+    {
+        completion_cond.wait(lock, [this] { return !completions.empty(); });
+        completions.pop_front();
+        in_flight--;
+    }
+}
+
+#endif
+
+#if defined(__linux__)
+
+static int IoUringSetup(unsigned entries, struct io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int IoUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int IoUringRegister(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+/**
+ * @brief Reads done by the kernel through io_uring, see io_uring(7).
+ *
+ * The ring is driven with raw system calls. Every buffer has at most one
+ * request in flight and interrupts are rare, so a submission queue as large
+ * as the buffer count never overflows.
+ */
+struct IoUringReader : AsyncReader
+{
+    IoUringReader(size_t buffers, size_t buffer_size);
+    ~IoUringReader() override;
+    const char* GetName() const override;
+    bool        Submit(size_t buffer, int fd, uint64_t offset, size_t length) override;
+    void        Post(size_t buffer) override;
+    void        Interrupt() override;
+    bool        Wait(Completion& completion) override;
+    void        Drain() override;
+
+    /**
+     * @brief Map the rings and register the buffers.
+     * @return true if the ring is ready.
+     */
+    bool Open();
+
+    /**
+     * @brief Queue a request and submit it.
+     */
+    void Push(uint8_t opcode, size_t buffer, int fd, uint64_t offset, size_t length);
+
+    /**
+     * @brief Fetch the next completion, waiting for it if needed.
+     */
+    void Reap(struct io_uring_cqe& cqe);
+
+    int                  ring_fd = -1;       /* Ring instance. */
+    void*                sq_ring = nullptr;  /* Submission ring mapping. */
+    size_t               sq_ring_size = 0;   /* Size of sq_ring. */
+    void*                cq_ring = nullptr;  /* Completion ring mapping, same as sq_ring on recent kernels. */
+    size_t               cq_ring_size = 0;   /* Size of cq_ring. */
+    struct io_uring_sqe* sqes = nullptr;     /* Submission entries. */
+    size_t               sqes_size = 0;      /* Size of sqes. */
+    unsigned*            sq_head = nullptr;  /* Submission head, advanced by the kernel. */
+    unsigned*            sq_tail = nullptr;  /* Submission tail. */
+    unsigned*            sq_array = nullptr; /* Submission indexes. */
+    unsigned             sq_mask = 0;        /* Submission index mask. */
+    unsigned             sq_entries = 0;     /* Submission ring size. */
+    unsigned*            cq_head = nullptr;  /* Completion head. */
+    unsigned*            cq_tail = nullptr;  /* Completion tail, advanced by the kernel. */
+    struct io_uring_cqe* cqes = nullptr;     /* Completion entries. */
+    unsigned             cq_mask = 0;        /* Completion index mask. */
+    bool                 fixed = false;      /* Buffers are registered, reads skip page pinning. */
+    std::vector<iovec>   iovecs;             /* Read target of every buffer when not registered. */
+    std::mutex           sq_mutex;           /* Guard for the submission ring. */
+    std::mutex           cq_mutex;           /* Guard for the completion ring. */
+    std::atomic<size_t>  in_flight;          /* Requests without fetched completion. */
+};
+
+IoUringReader::IoUringReader(size_t buffers, size_t buffer_size) : AsyncReader(buffers, buffer_size)
+{
+    in_flight = 0;
+}
+
+bool IoUringReader::Open()
+{
+    if (memory == nullptr)
+    {
+        return false;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = IoUringSetup(static_cast<unsigned>(buffer_count + 2), &params);
+    if (ring_fd < 0)
+    {
+        return false;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+    {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    void* ptr = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                     IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED)
+    {
+        return false;
+    }
+    sq_ring = ptr;
+
+    if (single_mmap)
+    {
+        cq_ring = sq_ring;
+    }
+    else
+    {
+        ptr = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                   IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED)
+        {
+            return false;
+        }
+        cq_ring = ptr;
+    }
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED)
+    {
+        return false;
+    }
+    sqes = static_cast<struct io_uring_sqe*>(ptr);
+
+    uint8_t* sq = static_cast<uint8_t*>(sq_ring);
+    uint8_t* cq = static_cast<uint8_t*>(cq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+
+    iovecs.resize(buffer_count);
+    for (size_t i = 0; i < buffer_count; i++)
+    {
+        iovecs[i].iov_base = GetBuffer(i);
+        iovecs[i].iov_len = buffer_size;
+    }
+
+    /* Registration pins the buffers once, it may fail with a low RLIMIT_MEMLOCK on older kernels. */
+    const unsigned count = static_cast<unsigned>(iovecs.size());
+    fixed = IoUringRegister(ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), count) == 0;
+    return true;
+}
+
+IoUringReader::~IoUringReader()
+{
+    if (sqes != nullptr)
+    {
+        Drain();
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring != nullptr && cq_ring != sq_ring)
+    {
+        munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != nullptr)
+    {
+        munmap(sq_ring, sq_ring_size);
+    }
+    if (ring_fd >= 0)
+    {
+        close(ring_fd);
+    }
+}
+
+const char* IoUringReader::GetName() const
+{
+    return fixed ? "io_uring with registered buffers" : "io_uring";
+}
+
+void IoUringReader::Push(uint8_t opcode, size_t buffer, int fd, uint64_t offset, size_t length)
+{
+    std::lock_guard<std::mutex> lock(sq_mutex);
+
+    const unsigned       tail = *sq_tail;
+    const unsigned       idx = tail & sq_mask;
+    struct io_uring_sqe& sqe = sqes[idx];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.user_data = buffer;
+    if (opcode == IORING_OP_READ_FIXED)
+    {
+        sqe.addr = reinterpret_cast<uint64_t>(GetBuffer(buffer));
+        sqe.len = static_cast<uint32_t>(length);
+        sqe.buf_index = static_cast<uint16_t>(buffer);
+    }
+    else if (opcode == IORING_OP_READV)
+    {
+        iovecs[buffer].iov_len = length;
+        sqe.addr = reinterpret_cast<uint64_t>(&iovecs[buffer]);
+        sqe.len = 1;
+    }
+    sq_array[idx] = idx;
+    in_flight++;
+    std::atomic_ref<unsigned>(*sq_tail).store(tail + 1, std::memory_order_release);
+
+    /* If the kernel is short of resources the entry stays queued, Reap() submits it again. */
+    int ret;
+    do
+    {
+        ret = IoUringEnter(ring_fd, 1, 0, 0);
+    } while (ret < 0 && errno == EINTR);
+}
+
+void IoUringReader::Reap(struct io_uring_cqe& cqe)
+{
+    std::lock_guard<std::mutex> lock(cq_mutex);
+    for (;;)
+    {
+        const unsigned head = *cq_head;
+        if (head != std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire))
+        {
+            cqe = cqes[head & cq_mask];
+            std::atomic_ref<unsigned>(*cq_head).store(head + 1, std::memory_order_release);
+            in_flight--;
+            return;
+        }
+
+        const int ret = IoUringEnter(ring_fd, sq_entries, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && errno != EINTR)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+bool IoUringReader::Submit(size_t buffer, int fd, uint64_t offset, size_t length)
+{
+    Push(fixed ? IORING_OP_READ_FIXED : IORING_OP_READV, buffer, fd, offset, std::min(length, buffer_size));
+    return true;
+}
+
+void IoUringReader::Post(size_t buffer)
+{
+    Push(IORING_OP_NOP, buffer, -1, 0, 0);
+}
+
+void IoUringReader::Interrupt()
+{
+    Push(IORING_OP_NOP, InterruptBuffer, -1, 0, 0);
+}
+
+bool IoUringReader::Wait(Completion& completion)
+{
+    struct io_uring_cqe cqe;
+    Reap(cqe);
+    completion.buffer = static_cast<size_t>(cqe.user_data);
+    completion.result = cqe.res;
+    return completion.buffer != InterruptBuffer;
+}
+
+void IoUringReader::Drain()
+{
+    while (in_flight != 0)
+    {
+        struct io_uring_cqe cqe;
+        Reap(cqe);
+    }
+}
+
+#endif
+
+AsyncReader* AsyncReader::Create(size_t buffers, size_t buffer_size)
+{
+#if defined(WIN32)
+    (void)buffers;
+    (void)buffer_size;
+    return nullptr;
+#else
+#if defined(__linux__)
+    IoUringReader* uring = new IoUringReader(buffers, buffer_size);
+    if (uring->Open())
+    {
+        return uring;
+    }
+    wxLogVerbose("io_uring is not available, reading with pread()");
+    delete uring;
+#endif
+
+    PreadReader* reader = new PreadReader(buffers, buffer_size);
+    if (reader->memory == nullptr)
+    {
+        delete reader;
+        return nullptr;
+    }
+    return reader;
+#endif
+}
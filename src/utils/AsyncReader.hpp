@@ -0,0 +1,104 @@
+#ifndef LAUNCHR_UTILS_ASYNC_READER_HPP
+#define LAUNCHR_UTILS_ASYNC_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LR
+{
+
+/**
+ * @brief Keep many file reads in flight, each into one of a fixed set of buffers.
+ *
+ * On Linux reads go through io_uring with registered buffers, so the queue
+ * depth hides device latency without a thread per read. Where io_uring is not
+ * available a small thread pool reads with pread(). Not available on Windows.
+ */
+struct AsyncReader
+{
+    struct Completion
+    {
+        size_t  buffer; /* Buffer index. */
+        int64_t result; /* Bytes read, 0 for Post() or end of file, negative errno on failure. */
+    };
+
+    /**
+     * @brief Allocate buffers.
+     * @param[in] buffers Number of buffers, also the max reads in flight.
+     * @param[in] buffer_size Size of each buffer.
+     */
+    AsyncReader(size_t buffers, size_t buffer_size);
+    AsyncReader(const AsyncReader&) = delete;
+    virtual ~AsyncReader();
+
+    /**
+     * @brief Get the backend name, for the log.
+     */
+    virtual const char* GetName() const = 0;
+
+    /**
+     * @brief Start reading into the buffer. Safe to call from several threads.
+     * @param[in] buffer Buffer index, must not have a read or post in flight.
+     * @param[in] fd File descriptor, must stay open until the read completes.
+     * @param[in] offset File offset.
+     * @param[in] length Bytes to read, at most the buffer size.
+     * @return true if the read is queued.
+     */
+    virtual bool Submit(size_t buffer, int fd, uint64_t offset, size_t length) = 0;
+
+    /**
+     * @brief Complete the buffer without reading, e.g. to hand it back to the waiting thread.
+     * @param[in] buffer Buffer index, must not have a read or post in flight.
+     */
+    virtual void Post(size_t buffer) = 0;
+
+    /**
+     * @brief Make one Wait() return false, the current one or the next one.
+     */
+    virtual void Interrupt() = 0;
+
+    /**
+     * @brief Wait for a completed read or post. Only one thread may wait.
+     * @param[out] completion Completed buffer.
+     * @return false if interrupted.
+     */
+    virtual bool Wait(Completion& completion) = 0;
+
+    /**
+     * @brief Wait for everything in flight and discard the completions. Only one thread may wait.
+     */
+    virtual void Drain() = 0;
+
+    /**
+     * @brief Get the buffer address.
+     * @param[in] buffer Buffer index.
+     */
+    void* GetBuffer(size_t buffer) const;
+
+    /**
+     * @brief Get the number of buffers.
+     */
+    size_t GetBufferCount() const;
+
+    /**
+     * @brief Get the size of each buffer.
+     */
+    size_t GetBufferSize() const;
+
+    /**
+     * @brief Create the reader for current platform.
+     * @param[in] buffers Number of buffers, also the max reads in flight.
+     * @param[in] buffer_size Size of each buffer.
+     * @return Reader, nullptr if not available.
+     */
+    static AsyncReader* Create(size_t buffers, size_t buffer_size);
+
+    uint8_t* memory;       /* Buffers, page aligned. */
+    size_t   memory_size;  /* Size of memory. */
+    size_t   buffer_count; /* Number of buffers. */
+    size_t   buffer_size;  /* Size of each buffer. */
+};
+
+} // namespace LR
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef LAUNCHR_UTILS_BOUNDED_QUEUE_HPP
+#define LAUNCHR_UTILS_BOUNDED_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace LR
+{
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer queue.
+ *
+ * Every cell carries a sequence number that tells whether it is ready for
+ * the next push or the next pop, so producers and consumers only contend on
+ * their own index.
+ */
+template <typename T>
+struct BoundedQueue
+{
+    /**
+     * @brief Constructor for bounded queue.
+     * @param[in] capacity Maximum number of elements, rounded up to power of 2.
+     */
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+    BoundedQueue(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Push an element.
+     * @param[in,out] value Element, moved out on success.
+     * @return false if the queue is full.
+     */
+    bool TryPush(T& value)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell&     cell = cells[pos & mask];
+            size_t    seq = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Pop an element.
+     * @param[out] value Element.
+     * @return false if the queue is empty.
+     */
+    bool TryPop(T& value)
+    {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell&     cell = cells[pos & mask];
+            size_t    seq = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.value);
+                    cell.value = T();
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence; /* Push is allowed when equal to position, pop when position + 1. */
+        T                   value;    /* Stored element. */
+    };
+
+    std::unique_ptr<Cell[]>          cells; /* Ring buffer. */
+    size_t                           mask;  /* Capacity - 1. */
+    alignas(64) std::atomic<size_t> head;  /* Next position to pop. */
+    alignas(64) std::atomic<size_t> tail;  /* Next position to push. */
+};
+
+} // namespace LR
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <vector>
@@ -6,6 +7,8 @@
 #ifdef _MSC_VER
 #include <stddef.h> // For ptrdiff_t
 typedef ptrdiff_t ssize_t;
+#else
+#include <sys/types.h>
 #endif
 
 using namespace LR;
@@ -94,7 +97,7 @@ BoyerMoore::~BoyerMoore()
     delete m_data;
 }
 
-std::optional<size_t> BoyerMoore::Search(const void* data, size_t size)
+std::optional<size_t> BoyerMoore::Search(const void* data, size_t size) const
 {
     if (!m_data || m_data->m == 0 || size < m_data->m)
     {
@@ -120,7 +123,10 @@ std::optional<size_t> BoyerMoore::Search(const void* data, size_t size)
             return s; /* Match success. */
         }
 
+        /* The table holds the shift for a mismatch at the last position, adjust it to position j. */
         size_t badCharShift = m_data->badCharShift[text[s + j]];
+        size_t matched = m - 1 - j;
+        badCharShift = badCharShift > matched ? badCharShift - matched : 1;
         size_t goodSufShift = m_data->goodSuffixShift[j + 1];
         s += std::max(badCharShift, goodSufShift);
     }
@@ -28,7 +28,7 @@ struct BoyerMoore
      * @param[in] size Data length.
      * @return If found, return the matching start position. If not found, return null.
      */
-    std::optional<size_t> Search(const void* data, size_t size);
+    std::optional<size_t> Search(const void* data, size_t size) const;
 
     struct Data;
     struct Data* m_data;
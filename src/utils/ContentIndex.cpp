@@ -0,0 +1,928 @@
+#include <wx/wx.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "LaunchR.hpp"
+#include "Regex.hpp"
+#include "TextMatcher.hpp"
+#include "ContentIndex.hpp"
+
+#if !defined(WIN32)
+#include <sys/stat.h>
+#endif
+
+using namespace LR;
+
+/* Index file layout, older or foreign files are ignored. */
+static const uint32_t IndexMagic = 0x4954524c; /* "LRTI" */
+static const uint32_t IndexVersion = 1;
+
+/* Larger files are not indexed, they are always searched. */
+static const uint64_t IndexMaxFileSize = 64 * 1024 * 1024;
+
+/* Trigrams are 24-bit values. */
+static const size_t TrigramCount = 1 << 24;
+
+/* Threads reading files while building, more mostly adds contention on the same device. */
+static const unsigned MaxIndexThreads = 8;
+
+enum IndexFlag : uint8_t
+{
+    IndexFlagDead = 0x01,      /* File is removed or indexed again under a new id. */
+    IndexFlagUnindexed = 0x02, /* Content is not indexed, the file is always a candidate. */
+    IndexFlagBinary = 0x04,    /* Content looks binary. */
+};
+
+struct IndexFile
+{
+    std::string           path;      /* UTF-8 path. */
+    ContentIndex::FileKey key;       /* Key when the content was indexed. */
+    uint8_t               flags = 0; /* Bitwise of IndexFlag. */
+};
+
+/**
+ * @brief Ids of the files containing a trigram, ascending and delta encoded as varints.
+ */
+struct PostingList
+{
+    std::string bytes;     /* Encoded ids. */
+    uint32_t    last = 0;  /* Last id. */
+    uint32_t    count = 0; /* Number of ids. */
+};
+
+typedef std::unordered_map<std::string, uint32_t> PathMap;
+typedef std::unordered_map<uint32_t, PostingList> PostingMap;
+typedef std::vector<uint32_t>                     IdVec;
+
+struct ContentIndex::Data
+{
+    mutable std::shared_mutex mutex;          /* Guard for the members below. */
+    std::string               root;           /* UTF-8 root directory. */
+    uint64_t                  max_size = 0;   /* Bytes indexed per file, 0 for no limit. */
+    std::vector<IndexFile>    files;          /* Files, index is the file id. */
+    PathMap                   paths;          /* Path of every live file to its id. */
+    PostingMap                postings;       /* Trigram to files. */
+    size_t                    dead_count = 0; /* Number of dead files. */
+    uint64_t                  generation = 0; /* Changed whenever file ids are renumbered. */
+    bool                      dirty = false;  /* Changed since loaded or saved. */
+};
+
+/**
+ * @brief Collect the distinct trigrams of content, reused across files.
+ */
+struct TrigramCollector
+{
+    TrigramCollector() : seen(TrigramCount / 64, 0)
+    {
+    }
+
+    std::vector<uint64_t> seen; /* Bit per trigram already collected. */
+    IdVec                 list; /* Collected trigrams. */
+};
+
+static uint8_t FoldByte(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<uint8_t>(c + ('a' - 'A')) : c;
+}
+
+static void CollectTrigrams(TrigramCollector& collector, const uint8_t* data, size_t size)
+{
+    if (size < 3)
+    {
+        return;
+    }
+
+    uint32_t trigram = static_cast<uint32_t>(FoldByte(data[0])) << 8 | FoldByte(data[1]);
+    for (size_t i = 2; i < size; i++)
+    {
+        trigram = ((trigram << 8) | FoldByte(data[i])) & (TrigramCount - 1);
+        uint64_t&      word = collector.seen[trigram / 64];
+        const uint64_t bit = uint64_t(1) << (trigram % 64);
+        if (!(word & bit))
+        {
+            word |= bit;
+            collector.list.push_back(trigram);
+        }
+    }
+}
+
+/**
+ * @brief Move the collected trigrams out, sorted, and reset the collector for the next file.
+ */
+static void TakeTrigrams(TrigramCollector& collector, IdVec* trigrams)
+{
+    for (uint32_t trigram : collector.list)
+    {
+        collector.seen[trigram / 64] = 0;
+    }
+    std::sort(collector.list.begin(), collector.list.end());
+    trigrams->swap(collector.list);
+    collector.list.clear();
+}
+
+/**
+ * @brief Collect trigrams of a query term. Trigrams with non-ASCII bytes are left out,
+ *   their case variants are not folded in the index.
+ */
+static void CollectTermTrigrams(const std::string& term, IdVec* trigrams)
+{
+    for (size_t i = 0; i + 3 <= term.size(); i++)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(term.data()) + i;
+        if (p[0] >= 0x80 || p[1] >= 0x80 || p[2] >= 0x80)
+        {
+            continue;
+        }
+        trigrams->push_back(static_cast<uint32_t>(FoldByte(p[0])) << 16 | static_cast<uint32_t>(FoldByte(p[1])) << 8 |
+                            FoldByte(p[2]));
+    }
+    std::sort(trigrams->begin(), trigrams->end());
+    trigrams->erase(std::unique(trigrams->begin(), trigrams->end()), trigrams->end());
+}
+
+static void PutVarint(std::string& buf, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        buf.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buf.push_back(static_cast<char>(value));
+}
+
+static uint32_t GetVarint(const char*& pos)
+{
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        const uint8_t c = static_cast<uint8_t>(*pos++);
+        value |= static_cast<uint32_t>(c & 0x7F) << shift;
+        if (!(c & 0x80))
+        {
+            return value;
+        }
+    }
+}
+
+/**
+ * @brief Same as GetVarint() for untrusted data, the varint must end before `end` and fit 32 bits.
+ */
+static bool GetCheckedVarint(const char*& pos, const char* end, uint32_t* value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 35 && pos < end; shift += 7)
+    {
+        const uint8_t c = static_cast<uint8_t>(*pos++);
+        if (shift == 28 && c > 0x0F)
+        {
+            return false;
+        }
+        *value |= static_cast<uint32_t>(c & 0x7F) << shift;
+        if (!(c & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Check that the list holds exactly `count` strictly ascending ids below `file_count`, the last being `last`.
+ *
+ * Lookups decode the lists with GetVarint() and use the ids as indexes
+ * without any check, so a saved list is fully decoded once when loaded.
+ */
+static bool ValidatePostings(const PostingList& list, uint32_t file_count)
+{
+    const char* pos = list.bytes.data();
+    const char* end = pos + list.bytes.size();
+    uint64_t    id = 0;
+    for (uint32_t i = 0; i < list.count; i++)
+    {
+        uint32_t delta = 0;
+        if (!GetCheckedVarint(pos, end, &delta) || (i != 0 && delta == 0))
+        {
+            return false;
+        }
+        id += delta;
+        if (id >= file_count)
+        {
+            return false;
+        }
+    }
+    return list.count != 0 && pos == end && id == list.last;
+}
+
+static void AppendPosting(PostingList& list, uint32_t id)
+{
+    PutVarint(list.bytes, id - list.last);
+    list.last = id;
+    list.count++;
+}
+
+static void DecodePostings(const PostingList& list, IdVec* ids)
+{
+    ids->reserve(list.count);
+    const char* pos = list.bytes.data();
+    uint32_t    id = 0;
+    for (uint32_t i = 0; i < list.count; i++)
+    {
+        id += GetVarint(pos);
+        ids->push_back(id);
+    }
+}
+
+/**
+ * @brief Keep the ids of a sorted list that are also in the posting list.
+ */
+static void IntersectPostings(IdVec& ids, const PostingList& list)
+{
+    const char* pos = list.bytes.data();
+    uint32_t    id = 0;
+    uint32_t    remaining = list.count;
+    bool        decoded = false;
+    size_t      kept = 0;
+    for (uint32_t candidate : ids)
+    {
+        while ((!decoded || id < candidate) && remaining > 0)
+        {
+            id += GetVarint(pos);
+            remaining--;
+            decoded = true;
+        }
+        if (!decoded || id < candidate)
+        {
+            break;
+        }
+        if (id == candidate)
+        {
+            ids[kept++] = candidate;
+        }
+    }
+    ids.resize(kept);
+}
+
+static void IntersectIds(IdVec& ids, const IdVec& other)
+{
+    IdVec ret;
+    std::set_intersection(ids.begin(), ids.end(), other.begin(), other.end(), std::back_inserter(ret));
+    ids.swap(ret);
+}
+
+static void MarkDead(ContentIndex::Data* data, uint32_t id)
+{
+    IndexFile& file = data->files[id];
+    if (!(file.flags & IndexFlagDead))
+    {
+        file.flags |= IndexFlagDead;
+        data->dead_count++;
+        data->dirty = true;
+    }
+}
+
+/**
+ * @brief Add a file under a new id, its previous version is marked dead. Must be called with lock held.
+ */
+static void AppendFile(ContentIndex::Data* data, const std::string& path, const ContentIndex::FileKey& key,
+                       uint8_t flags, const IdVec& trigrams)
+{
+    const uint32_t id = static_cast<uint32_t>(data->files.size());
+    auto           it = data->paths.find(path);
+    if (it != data->paths.end())
+    {
+        MarkDead(data, it->second);
+        it->second = id;
+    }
+    else
+    {
+        data->paths.emplace(path, id);
+    }
+
+    IndexFile file;
+    file.path = path;
+    file.key = key;
+    file.flags = flags;
+    data->files.push_back(file);
+    for (uint32_t trigram : trigrams)
+    {
+        AppendPosting(data->postings[trigram], id);
+    }
+    data->dirty = true;
+}
+
+/**
+ * @brief Drop dead files and renumber the live ones. Must be called with lock held.
+ */
+static void CompactIndex(ContentIndex::Data* data)
+{
+    if (data->dead_count == 0)
+    {
+        return;
+    }
+
+    IdVec                  remap(data->files.size(), UINT32_MAX);
+    std::vector<IndexFile> files;
+    files.reserve(data->files.size() - data->dead_count);
+    for (size_t i = 0; i < data->files.size(); i++)
+    {
+        if (!(data->files[i].flags & IndexFlagDead))
+        {
+            remap[i] = static_cast<uint32_t>(files.size());
+            files.push_back(std::move(data->files[i]));
+        }
+    }
+
+    IdVec ids;
+    for (auto it = data->postings.begin(); it != data->postings.end();)
+    {
+        ids.clear();
+        DecodePostings(it->second, &ids);
+
+        PostingList list;
+        for (uint32_t id : ids)
+        {
+            if (remap[id] != UINT32_MAX)
+            {
+                AppendPosting(list, remap[id]);
+            }
+        }
+        if (list.count == 0)
+        {
+            it = data->postings.erase(it);
+            continue;
+        }
+        it->second = std::move(list);
+        ++it;
+    }
+
+    data->files.swap(files);
+    data->paths.clear();
+    for (size_t i = 0; i < data->files.size(); i++)
+    {
+        data->paths.emplace(data->files[i].path, static_cast<uint32_t>(i));
+    }
+    data->dead_count = 0;
+    data->generation++;
+    data->dirty = true;
+}
+
+static void ResetIndex(ContentIndex::Data* data)
+{
+    data->files.clear();
+    data->paths.clear();
+    data->postings.clear();
+    data->dead_count = 0;
+    data->generation++;
+    data->dirty = true;
+}
+
+/**
+ * @brief Read the file and collect its trigrams.
+ * @return Bitwise of IndexFlag.
+ */
+static uint8_t IndexContent(const wxString& path, const ContentIndex::FileKey& key, uint64_t max_size,
+                            TrigramCollector& collector, IdVec* trigrams)
+{
+    uint64_t size = key.size;
+    if (max_size != 0 && size > max_size)
+    {
+        size = max_size;
+    }
+    if (size > IndexMaxFileSize)
+    {
+        return IndexFlagUnindexed;
+    }
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    wxLogNull      logNo; /* Files may be removed while they are indexed. */
+    FileMemoryMap  view(path, false);
+    const uint8_t* addr = static_cast<const uint8_t*>(view.Map(0, static_cast<size_t>(size)));
+    if (addr == nullptr)
+    {
+        return IndexFlagUnindexed;
+    }
+
+    /* UTF-16 content is matched in its own encoding, its trigrams would not agree with the query. */
+    size = view.GetSize();
+    if (TextMatcher::DetectEncoding(addr, static_cast<size_t>(size)) == TextMatcher::Encoding::Utf16Le)
+    {
+        return IndexFlagUnindexed;
+    }
+
+    const uint8_t flags = TextMatcher::IsBinary(addr, static_cast<size_t>(size)) ? IndexFlagBinary : 0;
+    CollectTrigrams(collector, addr, static_cast<size_t>(size));
+    TakeTrigrams(collector, trigrams);
+    return flags;
+}
+
+static void PutBytes(std::string& buf, const void* data, size_t size)
+{
+    buf.append(static_cast<const char*>(data), size);
+}
+
+static void PutString(std::string& buf, const std::string& str)
+{
+    const uint32_t length = static_cast<uint32_t>(str.size());
+    PutBytes(buf, &length, sizeof(length));
+    PutBytes(buf, str.data(), str.size());
+}
+
+static bool GetBytes(const char*& pos, const char* end, void* data, size_t size)
+{
+    if (static_cast<size_t>(end - pos) < size)
+    {
+        return false;
+    }
+    memcpy(data, pos, size);
+    pos += size;
+    return true;
+}
+
+static bool GetString(const char*& pos, const char* end, std::string* str)
+{
+    uint32_t length = 0;
+    if (!GetBytes(pos, end, &length, sizeof(length)) || static_cast<size_t>(end - pos) < length)
+    {
+        return false;
+    }
+    str->assign(pos, length);
+    pos += length;
+    return true;
+}
+
+static bool DeserializeIndex(ContentIndex::Data* data, const char* pos, const char* end)
+{
+    uint32_t file_count = 0;
+    if (!GetBytes(pos, end, &file_count, sizeof(file_count)))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < file_count; i++)
+    {
+        IndexFile file;
+        if (!GetString(pos, end, &file.path) || !GetBytes(pos, end, &file.key.dev, sizeof(file.key.dev)) ||
+            !GetBytes(pos, end, &file.key.ino, sizeof(file.key.ino)) ||
+            !GetBytes(pos, end, &file.key.mtime, sizeof(file.key.mtime)) ||
+            !GetBytes(pos, end, &file.key.size, sizeof(file.key.size)) ||
+            !GetBytes(pos, end, &file.flags, sizeof(file.flags)))
+        {
+            return false;
+        }
+        if (!data->paths.emplace(file.path, i).second)
+        {
+            return false;
+        }
+        data->files.push_back(std::move(file));
+    }
+
+    uint32_t posting_count = 0;
+    if (!GetBytes(pos, end, &posting_count, sizeof(posting_count)))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < posting_count; i++)
+    {
+        uint32_t    header[3] = {}; /* Trigram, count and last id. */
+        PostingList list;
+        if (!GetBytes(pos, end, header, sizeof(header)) || !GetString(pos, end, &list.bytes))
+        {
+            return false;
+        }
+        list.count = header[1];
+        list.last = header[2];
+        if (!ValidatePostings(list, file_count) || !data->postings.emplace(header[0], std::move(list)).second)
+        {
+            return false;
+        }
+    }
+    return pos == end;
+}
+
+ContentIndex::ContentIndex()
+{
+    m_data = new Data;
+}
+
+ContentIndex::~ContentIndex()
+{
+    delete m_data;
+}
+
+bool ContentIndex::GetFileKey(const wxString& path, FileKey* key)
+{
+#if !defined(WIN32)
+    struct stat st;
+    if (stat(path.fn_str(), &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+    key->dev = static_cast<uint64_t>(st.st_dev);
+    key->ino = static_cast<uint64_t>(st.st_ino);
+#if defined(__APPLE__)
+    key->mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    key->mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    key->size = static_cast<uint64_t>(st.st_size);
+    return true;
+#else
+    /* Without inode numbers the path, time and size identify the content. */
+    std::error_code             ec;
+    const std::filesystem::path p(path.ToStdWstring());
+    const auto                  mtime = std::filesystem::last_write_time(p, ec);
+    const uint64_t              size = ec ? 0 : std::filesystem::file_size(p, ec);
+    if (ec)
+    {
+        return false;
+    }
+    key->dev = 0;
+    key->ino = 0;
+    key->mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    key->size = size;
+    return true;
+#endif
+}
+
+bool ContentIndex::Load(const wxString& path, const wxString& root, uint64_t max_size)
+{
+    wxLogNull logNo; /* The file does not exist at the first start. */
+    wxFile    file;
+    if (!file.Open(path, wxFile::read))
+    {
+        return false;
+    }
+
+    std::string buf(static_cast<size_t>(std::max<wxFileOffset>(file.Length(), 0)), '\0');
+    if (file.Read(&buf[0], buf.size()) != static_cast<ssize_t>(buf.size()))
+    {
+        return false;
+    }
+
+    const char* pos = buf.data();
+    const char* end = buf.data() + buf.size();
+    uint32_t    header[2] = {};
+    uint64_t    saved_max_size = 0;
+    std::string saved_root;
+    if (!GetBytes(pos, end, header, sizeof(header)) || header[0] != IndexMagic || header[1] != IndexVersion ||
+        !GetBytes(pos, end, &saved_max_size, sizeof(saved_max_size)) || !GetString(pos, end, &saved_root) ||
+        saved_max_size != max_size || saved_root != std::string(root.utf8_str()))
+    {
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_data->mutex);
+    ResetIndex(m_data);
+    if (!DeserializeIndex(m_data, pos, end))
+    {
+        ResetIndex(m_data);
+        return false;
+    }
+    m_data->root = saved_root;
+    m_data->max_size = max_size;
+    m_data->dirty = false;
+    return true;
+}
+
+bool ContentIndex::Save(const wxString& path)
+{
+    wxFileName f(path);
+    if (!f.DirExists() && !f.Mkdir(wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+    {
+        wxLogWarning("Failed to create directory: %s", path);
+        return false;
+    }
+
+    std::string buf;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_data->mutex);
+        CompactIndex(m_data);
+
+        const uint32_t header[2] = { IndexMagic, IndexVersion };
+        PutBytes(buf, header, sizeof(header));
+        PutBytes(buf, &m_data->max_size, sizeof(m_data->max_size));
+        PutString(buf, m_data->root);
+
+        const uint32_t file_count = static_cast<uint32_t>(m_data->files.size());
+        PutBytes(buf, &file_count, sizeof(file_count));
+        for (const IndexFile& file : m_data->files)
+        {
+            PutString(buf, file.path);
+            PutBytes(buf, &file.key.dev, sizeof(file.key.dev));
+            PutBytes(buf, &file.key.ino, sizeof(file.key.ino));
+            PutBytes(buf, &file.key.mtime, sizeof(file.key.mtime));
+            PutBytes(buf, &file.key.size, sizeof(file.key.size));
+            PutBytes(buf, &file.flags, sizeof(file.flags));
+        }
+
+        const uint32_t posting_count = static_cast<uint32_t>(m_data->postings.size());
+        PutBytes(buf, &posting_count, sizeof(posting_count));
+        for (const auto& it : m_data->postings)
+        {
+            const uint32_t header_list[3] = { it.first, it.second.count, it.second.last };
+            PutBytes(buf, header_list, sizeof(header_list));
+            PutString(buf, it.second.bytes);
+        }
+        m_data->dirty = false;
+    }
+
+    /* Write aside and rename, so a crash never leaves a truncated index behind. */
+    const wxString tmp_path = path + ".tmp";
+    wxFile         file;
+    if (!file.Open(tmp_path, wxFile::write) || file.Write(buf.data(), buf.size()) != buf.size())
+    {
+        wxLogWarning("Failed to write content index: %s", tmp_path);
+        return false;
+    }
+    file.Close();
+    return wxRenameFile(tmp_path, path, true);
+}
+
+void ContentIndex::Build(const wxString& root, Filter filter, uint64_t max_size, const std::atomic<bool>& looping)
+{
+    /* Walk first, reading content is much slower than listing it. */
+    std::vector<FileSystemTraversal::FileInfo> found;
+    std::mutex                                 found_mutex;
+    auto cb = [&found, &found_mutex, &filter, &looping](const FileSystemTraversal::FileInfo& info) {
+        if (info.isfile && filter(info))
+        {
+            std::lock_guard<std::mutex> lock(found_mutex);
+            found.push_back(info);
+        }
+        return static_cast<bool>(looping);
+    };
+    FileSystemTraversal::ParallelTraversal(root, SIZE_MAX, cb, wxGetApp().settings->Get().TraversalThreads);
+    if (!looping)
+    {
+        return;
+    }
+
+    size_t initial_count;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_data->mutex);
+        const std::string root_utf8(root.utf8_str());
+        if (m_data->root != root_utf8 || m_data->max_size != max_size)
+        {
+            ResetIndex(m_data);
+            m_data->root = root_utf8;
+            m_data->max_size = max_size;
+        }
+        initial_count = m_data->files.size();
+    }
+
+    /* Every thread stats files and reads the changed ones, each path appears once so seen has no conflicts. */
+    std::vector<uint8_t> seen(initial_count, 0);
+    std::atomic<size_t>  next = 0;
+    auto                 worker = [this, &found, &seen, &next, &looping, max_size, initial_count]() {
+        TrigramCollector collector;
+        IdVec            trigrams;
+        for (size_t i = next++; i < found.size() && looping; i = next++)
+        {
+            FileKey key;
+            if (!GetFileKey(found[i].path, &key))
+            {
+                continue;
+            }
+
+            const std::string path(found[i].path.utf8_str());
+            {
+                std::shared_lock<std::shared_mutex> lock(m_data->mutex);
+                auto                                it = m_data->paths.find(path);
+                if (it != m_data->paths.end() && m_data->files[it->second].key == key)
+                {
+                    if (it->second < initial_count)
+                    {
+                        seen[it->second] = 1;
+                    }
+                    continue;
+                }
+            }
+
+            trigrams.clear();
+            const uint8_t flags = IndexContent(found[i].path, key, max_size, collector, &trigrams);
+
+            std::unique_lock<std::shared_mutex> lock(m_data->mutex);
+            AppendFile(m_data, path, key, flags, trigrams);
+        }
+    };
+
+    const unsigned           threads = std::clamp(std::thread::hardware_concurrency(), 1u, MaxIndexThreads);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& t : workers)
+    {
+        t.join();
+    }
+    if (!looping)
+    {
+        return;
+    }
+
+    /* Files not found by the walk are removed. */
+    std::unique_lock<std::shared_mutex> lock(m_data->mutex);
+    for (size_t i = 0; i < initial_count; i++)
+    {
+        if (!seen[i] && !(m_data->files[i].flags & IndexFlagDead))
+        {
+            m_data->paths.erase(m_data->files[i].path);
+            MarkDead(m_data, static_cast<uint32_t>(i));
+        }
+    }
+    if (m_data->dead_count * 2 > m_data->files.size())
+    {
+        CompactIndex(m_data);
+    }
+}
+
+void ContentIndex::Update(const wxString& path)
+{
+    const std::string path_utf8(path.utf8_str());
+    FileKey           key;
+    uint64_t          max_size;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_data->mutex);
+        auto                                it = m_data->paths.find(path_utf8);
+        if (!GetFileKey(path, &key))
+        {
+            if (it != m_data->paths.end())
+            {
+                MarkDead(m_data, it->second);
+                m_data->paths.erase(it);
+            }
+            return;
+        }
+        if (it != m_data->paths.end() && m_data->files[it->second].key == key)
+        {
+            return;
+        }
+        max_size = m_data->max_size;
+    }
+
+    TrigramCollector collector;
+    IdVec            trigrams;
+    const uint8_t    flags = IndexContent(path, key, max_size, collector, &trigrams);
+
+    std::unique_lock<std::shared_mutex> lock(m_data->mutex);
+    AppendFile(m_data, path_utf8, key, flags, trigrams);
+}
+
+void ContentIndex::Query(const TextQuery& query, bool skip_binary, Candidates* candidates) const
+{
+    /* Trigrams of each term, the pattern is only parsed and outside the lock. */
+    std::vector<IdVec> term_trigrams(query.terms.size());
+    for (size_t i = 0; i < query.terms.size(); i++)
+    {
+        if (query.regex)
+        {
+            /* Every match of the pattern contains its literals. */
+            std::vector<std::string> literals;
+            Regex::ParseLiterals(query.terms[i], true, &literals);
+            for (const std::string& literal : literals)
+            {
+                CollectTermTrigrams(literal, &term_trigrams[i]);
+            }
+        }
+        else
+        {
+            CollectTermTrigrams(query.terms[i], &term_trigrams[i]);
+        }
+    }
+
+    std::shared_lock<std::shared_mutex> lock(m_data->mutex);
+    candidates->generation = m_data->generation;
+    candidates->skip_binary = skip_binary;
+    candidates->files.assign(m_data->files.size(), false);
+
+    /* Files that may contain each term, terms without usable trigrams may be anywhere. */
+    std::vector<IdVec> term_files(query.terms.size());
+    std::vector<bool>  term_anywhere(query.terms.size(), false);
+    for (size_t i = 0; i < query.terms.size(); i++)
+    {
+        const IdVec& trigrams = term_trigrams[i];
+        if (trigrams.empty())
+        {
+            term_anywhere[i] = true;
+            continue;
+        }
+
+        /* Start from the rarest trigram, so the intersections stay small. */
+        std::vector<const PostingList*> lists;
+        for (uint32_t trigram : trigrams)
+        {
+            auto it = m_data->postings.find(trigram);
+            if (it == m_data->postings.end())
+            {
+                lists.clear();
+                break;
+            }
+            lists.push_back(&it->second);
+        }
+        if (lists.empty())
+        {
+            continue;
+        }
+        std::sort(lists.begin(), lists.end(),
+                  [](const PostingList* a, const PostingList* b) { return a->count < b->count; });
+
+        DecodePostings(*lists[0], &term_files[i]);
+        for (size_t j = 1; j < lists.size() && !term_files[i].empty(); j++)
+        {
+            IntersectPostings(term_files[i], *lists[j]);
+        }
+    }
+
+    for (uint64_t group : query.groups)
+    {
+        IdVec ids;
+        bool  constrained = false;
+        for (size_t i = 0; i < query.terms.size(); i++)
+        {
+            if (!(group & (uint64_t(1) << i)) || term_anywhere[i])
+            {
+                continue;
+            }
+            if (!constrained)
+            {
+                ids = term_files[i];
+                constrained = true;
+            }
+            else
+            {
+                IntersectIds(ids, term_files[i]);
+            }
+        }
+
+        if (!constrained)
+        {
+            candidates->files.assign(m_data->files.size(), true);
+            return;
+        }
+        for (uint32_t id : ids)
+        {
+            candidates->files[id] = true;
+        }
+    }
+}
+
+ContentIndex::Verdict ContentIndex::Check(const Candidates& candidates, const wxString& path,
+                                          const FileKey& key) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_data->mutex);
+    if (candidates.generation != m_data->generation)
+    {
+        return Verdict::Unknown;
+    }
+
+    auto it = m_data->paths.find(std::string(path.utf8_str()));
+    if (it == m_data->paths.end() || it->second >= candidates.files.size())
+    {
+        return Verdict::Unknown;
+    }
+
+    const IndexFile& file = m_data->files[it->second];
+    if (!(file.key == key))
+    {
+        return Verdict::Unknown;
+    }
+    if (file.flags & IndexFlagUnindexed)
+    {
+        return Verdict::Candidate;
+    }
+    if ((file.flags & IndexFlagBinary) && candidates.skip_binary)
+    {
+        return Verdict::Skip;
+    }
+    return candidates.files[it->second] ? Verdict::Candidate : Verdict::Skip;
+}
+
+bool ContentIndex::IsDirty() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_data->mutex);
+    return m_data->dirty;
+}
+
+size_t ContentIndex::GetFileCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_data->mutex);
+    return m_data->files.size() - m_data->dead_count;
+}
+
+size_t ContentIndex::GetTrigramCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_data->mutex);
+    return m_data->postings.size();
+}
@@ -0,0 +1,141 @@
+#ifndef LAUNCHR_UTILS_CONTENT_INDEX_HPP
+#define LAUNCHR_UTILS_CONTENT_INDEX_HPP
+
+#include <wx/wx.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "FileSystem.hpp"
+#include "TextQuery.hpp"
+
+namespace LR
+{
+
+/**
+ * @brief Trigram index of file content.
+ *
+ * Every file is keyed by device, inode, modification time and size, and the
+ * trigrams of its content, ASCII letters folded to lowercase, map to the
+ * files containing them. A query only yields candidate files, the content
+ * of every candidate must still be verified by the matcher. Files the index
+ * cannot answer for, UTF-16 or too large ones, are always candidates.
+ */
+struct ContentIndex
+{
+    struct FileKey
+    {
+        uint64_t dev = 0;   /* Device id. */
+        uint64_t ino = 0;   /* Inode number. */
+        int64_t  mtime = 0; /* Modification time in nanoseconds. */
+        uint64_t size = 0;  /* File size. */
+
+        bool operator==(const FileKey& other) const = default;
+    };
+
+    enum class Verdict : int
+    {
+        Candidate, /* Content may match, it must be searched. */
+        Skip,      /* Content cannot match. */
+        Unknown,   /* File is not indexed or changed since, it must be searched. */
+    };
+
+    struct Candidates
+    {
+        uint64_t          generation = 0;      /* Index generation the file ids belong to. */
+        std::vector<bool> files;               /* Candidate flag by file id. */
+        bool              skip_binary = false; /* Binary files are never candidates. */
+    };
+
+    /**
+     * @brief Build filter.
+     * @return true to index the file.
+     */
+    typedef std::function<bool(const FileSystemTraversal::FileInfo& info)> Filter;
+
+    ContentIndex();
+    ContentIndex(const ContentIndex&) = delete;
+    ~ContentIndex();
+
+    /**
+     * @brief Get the key of a file.
+     * @param[in] path File path.
+     * @param[out] key File key.
+     * @return true if the file exists.
+     */
+    static bool GetFileKey(const wxString& path, FileKey* key);
+
+    /**
+     * @brief Load a saved index, it is kept only if built with the same parameters.
+     * @param[in] path Index file path.
+     * @param[in] root Root directory.
+     * @param[in] max_size Bytes indexed per file, 0 for no limit.
+     * @return true if loaded.
+     */
+    bool Load(const wxString& path, const wxString& root, uint64_t max_size);
+
+    /**
+     * @brief Save the index, removed files are compacted first.
+     * @param[in] path Index file path.
+     * @return true if saved.
+     */
+    bool Save(const wxString& path);
+
+    /**
+     * @brief Walk the root directory, index new and changed files and drop removed ones.
+     *
+     * Unchanged files keep their trigrams, so updating a loaded index only
+     * reads the files changed since it was saved.
+     *
+     * @param[in] root Root directory.
+     * @param[in] filter Files to index.
+     * @param[in] max_size Bytes indexed per file, 0 for no limit.
+     * @param[in] looping Building stops once it becomes false.
+     */
+    void Build(const wxString& root, Filter filter, uint64_t max_size, const std::atomic<bool>& looping);
+
+    /**
+     * @brief Index the file again if it changed.
+     * @param[in] path File path.
+     */
+    void Update(const wxString& path);
+
+    /**
+     * @brief Collect files whose content may match the query.
+     * @param[in] query Parsed query.
+     * @param[in] skip_binary Binary files are never candidates.
+     * @param[out] candidates Candidate files, only valid for Check().
+     */
+    void Query(const TextQuery& query, bool skip_binary, Candidates* candidates) const;
+
+    /**
+     * @brief Check if a file found on disk must be searched.
+     * @param[in] candidates Result of Query().
+     * @param[in] path File path.
+     * @param[in] key Current key of the file.
+     * @return Verdict.
+     */
+    Verdict Check(const Candidates& candidates, const wxString& path, const FileKey& key) const;
+
+    /**
+     * @brief Check if the index changed since it was loaded or saved.
+     */
+    bool IsDirty() const;
+
+    /**
+     * @brief Get the number of indexed files.
+     */
+    size_t GetFileCount() const;
+
+    /**
+     * @brief Get the number of distinct trigrams.
+     */
+    size_t GetTrigramCount() const;
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
@@ -0,0 +1,948 @@
+#include <wx/wx.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "FileSystem.hpp"
+#include "FileSystemWatcher.hpp"
+#include "LaunchR.hpp"
+#include "FileCatalog.hpp"
+
+using namespace LR;
+
+enum EntryFlag : uint16_t
+{
+    EntryFlagDir = 0x01,  /* Entry is a directory. */
+    EntryFlagDead = 0x02, /* Entry is removed, its bytes are reclaimed by compaction. */
+};
+
+struct CatalogEntry
+{
+    FileCatalog::EntryId parent;      /* Parent directory id. */
+    uint32_t             name_offset; /* Display name offset in `names`. */
+    uint32_t             key_offset;  /* Lowercase key offset in `keys`. */
+    uint32_t             size;        /* Live entries in the subtree, the entry included. */
+    uint16_t             name_length; /* Display name length in bytes. */
+    uint16_t             flags;       /* Bitwise of EntryFlag. */
+};
+
+struct CatalogTable
+{
+    std::vector<CatalogEntry>         entries;         /* Entry list, index is the entry id. */
+    std::string                       names;           /* Packed UTF-8 display names. */
+    std::string                       keys;            /* Packed lowercase UTF-8 keys, each one terminated by NUL. */
+    std::vector<FileCatalog::EntryId> index;           /* Open addressing table of (parent, name) to entry id. */
+    size_t                            index_count = 0; /* Number of used slots in index. */
+    size_t                            dead_count = 0;  /* Number of dead entries, and live ones under them. */
+    size_t                            stale_bytes = 0; /* Bytes of names and keys left behind by renames. */
+};
+
+typedef std::vector<FileSystemWatcher::Event> EventList;
+
+struct FileCatalog::Data
+{
+    CatalogTable              table;          /* Catalog content. */
+    wxString                  root;           /* Root directory. */
+    mutable std::shared_mutex mutex;          /* Guard for table and root. */
+    std::atomic<bool>         looping = true; /* Looping flag. */
+
+    FileSystemWatcher* watcher = nullptr; /* Filesystem change notification. */
+    std::mutex         pending_mutex;     /* Guard for building, pending and rescans. */
+    bool               building = false;  /* Building or rescanning in progress, events are deferred. */
+    EventList          pending;           /* Events received while building. */
+
+    std::mutex              build_mutex;             /* Held while the table is built or a subtree is rescanned. */
+    std::vector<wxString>   rescans;                 /* Subtrees waiting for the rescan thread, none inside another. */
+    std::condition_variable rescan_cond;             /* Signaled when a rescan is queued or looping changes. */
+    std::thread*            rescan_thread = nullptr; /* Walks rescanned subtrees off the watcher thread. */
+};
+
+typedef std::unordered_map<std::wstring, FileCatalog::EntryId> DirMap;
+
+/* Dead entries are only reclaimed for catalogs larger than this. */
+static const size_t CompactMinEntries = 4096;
+
+/**
+ * @brief Remove trailing path separators so that `C:\` and `C:\foo` agree on their parent key.
+ */
+static std::wstring NormalizeDirKey(const std::wstring& path)
+{
+    size_t len = path.size();
+    while (len > 0 && (path[len - 1] == L'/' || path[len - 1] == L'\\'))
+    {
+        len--;
+    }
+    return path.substr(0, len);
+}
+
+/**
+ * @brief Split path into parent directory and name.
+ */
+static bool SplitPath(const std::wstring& path, std::wstring* parent, std::wstring* name)
+{
+    const std::wstring norm = NormalizeDirKey(path);
+    const size_t       pos = norm.find_last_of(L"/\\");
+    if (pos == std::wstring::npos)
+    {
+        return false;
+    }
+
+    *parent = norm.substr(0, pos + 1);
+    *name = norm.substr(pos + 1);
+    return !name->empty();
+}
+
+static uint64_t HashChild(FileCatalog::EntryId parent, const char* name, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL ^ parent;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ static_cast<uint8_t>(name[i])) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t HashEntry(const CatalogTable& table, FileCatalog::EntryId id)
+{
+    const CatalogEntry& e = table.entries[id];
+    return HashChild(e.parent, table.names.data() + e.name_offset, e.name_length);
+}
+
+static void IndexPut(CatalogTable& table, FileCatalog::EntryId id)
+{
+    const size_t mask = table.index.size() - 1;
+    for (size_t i = HashEntry(table, id) & mask;; i = (i + 1) & mask)
+    {
+        if (table.index[i] == FileCatalog::InvalidId)
+        {
+            table.index[i] = id;
+            table.index_count++;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Rebuild the child index from live entries.
+ */
+static void IndexRebuild(CatalogTable& table)
+{
+    const size_t live = table.entries.size() - table.dead_count;
+
+    size_t cap = 16;
+    while (cap < live * 2 + 2)
+    {
+        cap *= 2;
+    }
+
+    table.index.assign(cap, FileCatalog::InvalidId);
+    table.index_count = 0;
+    for (size_t id = 0; id < table.entries.size(); id++)
+    {
+        if ((table.entries[id].flags & EntryFlagDead) == 0)
+        {
+            IndexPut(table, static_cast<FileCatalog::EntryId>(id));
+        }
+    }
+}
+
+static void IndexInsert(CatalogTable& table, FileCatalog::EntryId id)
+{
+    if ((table.index_count + 1) * 2 > table.index.size())
+    {
+        IndexRebuild(table);
+        return;
+    }
+    IndexPut(table, id);
+}
+
+static FileCatalog::EntryId IndexFind(const CatalogTable& table, FileCatalog::EntryId parent, const std::string& name)
+{
+    if (table.index.empty())
+    {
+        return FileCatalog::InvalidId;
+    }
+
+    const size_t mask = table.index.size() - 1;
+    for (size_t i = HashChild(parent, name.data(), name.size()) & mask; table.index[i] != FileCatalog::InvalidId;
+         i = (i + 1) & mask)
+    {
+        const CatalogEntry& e = table.entries[table.index[i]];
+        if (e.parent == parent && (e.flags & EntryFlagDead) == 0 && e.name_length == name.size() &&
+            memcmp(table.names.data() + e.name_offset, name.data(), name.size()) == 0)
+        {
+            return table.index[i];
+        }
+    }
+    return FileCatalog::InvalidId;
+}
+
+/**
+ * @brief Add delta to the subtree size of the entry and of all its ancestors.
+ */
+static void AddSubtreeSize(CatalogTable& table, FileCatalog::EntryId id, int64_t delta)
+{
+    for (; id < table.entries.size(); id = table.entries[id].parent)
+    {
+        table.entries[id].size = static_cast<uint32_t>(table.entries[id].size + delta);
+    }
+}
+
+static FileCatalog::EntryId AppendEntry(CatalogTable& table, FileCatalog::EntryId parent, const char* name,
+                                        size_t name_len, const char* key, size_t key_len, uint16_t flags)
+{
+    if (name_len > UINT16_MAX || table.entries.size() >= FileCatalog::InvalidId ||
+        table.names.size() + name_len > UINT32_MAX || table.keys.size() + key_len + 1 > UINT32_MAX)
+    {
+        return FileCatalog::InvalidId;
+    }
+
+    CatalogEntry entry;
+    entry.parent = parent;
+    entry.name_offset = static_cast<uint32_t>(table.names.size());
+    entry.key_offset = static_cast<uint32_t>(table.keys.size());
+    entry.size = 0;
+    entry.name_length = static_cast<uint16_t>(name_len);
+    entry.flags = flags;
+
+    table.names.append(name, name_len);
+    table.keys.append(key, key_len);
+    table.keys.push_back('\0');
+    table.entries.push_back(entry);
+
+    FileCatalog::EntryId id = static_cast<FileCatalog::EntryId>(table.entries.size() - 1);
+    AddSubtreeSize(table, id, 1);
+    IndexInsert(table, id);
+    return id;
+}
+
+static FileCatalog::EntryId AddEntry(CatalogTable& table, FileCatalog::EntryId parent, const wxString& name, bool isdir)
+{
+    const wxScopedCharBuffer name_utf8 = name.ToUTF8();
+    const wxScopedCharBuffer key_utf8 = name.Lower().ToUTF8();
+    return AppendEntry(table, parent, name_utf8.data(), name_utf8.length(), key_utf8.data(), key_utf8.length(),
+                       isdir ? EntryFlagDir : 0);
+}
+
+/**
+ * @brief Remove the entry. Its descendants are hidden by their dead ancestor and counted as dead too.
+ */
+static void MarkDead(CatalogTable& table, FileCatalog::EntryId id)
+{
+    if ((table.entries[id].flags & EntryFlagDead) == 0)
+    {
+        const uint32_t size = table.entries[id].size;
+        AddSubtreeSize(table, id, -static_cast<int64_t>(size));
+        table.entries[id].flags |= EntryFlagDead;
+        table.dead_count += size;
+    }
+}
+
+/**
+ * @brief Rewrite the table without dead entries.
+ *
+ * Entries are renumbered breadth first, so parents precede their children and
+ * key offsets grow with the entry id again.
+ */
+static void CompactTable(CatalogTable& table)
+{
+    const size_t count = table.entries.size();
+
+    /* Group children by parent. */
+    std::vector<size_t> start(count + 1, 0);
+    for (const CatalogEntry& e : table.entries)
+    {
+        if (e.parent < count)
+        {
+            start[e.parent + 1]++;
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        start[i + 1] += start[i];
+    }
+    std::vector<size_t>               fill(start.begin(), start.end() - 1);
+    std::vector<FileCatalog::EntryId> children(count);
+    for (size_t id = 0; id < count; id++)
+    {
+        const FileCatalog::EntryId parent = table.entries[id].parent;
+        if (parent < count)
+        {
+            children[fill[parent]++] = static_cast<FileCatalog::EntryId>(id);
+        }
+    }
+
+    CatalogTable                      out;
+    std::vector<FileCatalog::EntryId> remap(count, FileCatalog::InvalidId);
+    std::vector<FileCatalog::EntryId> queue;
+    out.index.assign(16, FileCatalog::InvalidId);
+    queue.push_back(0);
+
+    for (size_t i = 0; i < queue.size(); i++)
+    {
+        const FileCatalog::EntryId old = queue[i];
+        const CatalogEntry&        e = table.entries[old];
+        if (e.flags & EntryFlagDead)
+        {
+            continue;
+        }
+
+        const char* key = table.keys.data() + e.key_offset;
+        remap[old] = AppendEntry(out, e.parent < count ? remap[e.parent] : FileCatalog::InvalidId,
+                                 table.names.data() + e.name_offset, e.name_length, key, strlen(key), e.flags);
+
+        queue.insert(queue.end(), children.begin() + start[old], children.begin() + start[old + 1]);
+    }
+
+    table = std::move(out);
+}
+
+static void MaybeCompactTable(CatalogTable& table)
+{
+    if (table.entries.size() > CompactMinEntries && (table.dead_count * 2 > table.entries.size() ||
+                                                     table.stale_bytes * 2 > table.names.size() + table.keys.size()))
+    {
+        CompactTable(table);
+    }
+}
+
+/**
+ * @brief Add an entry reported by FileSystemTraversal. Its parent must be in `dirs`.
+ * @return false if the catalog is full.
+ */
+static bool AppendTreeEntry(CatalogTable& table, DirMap& dirs, const FileSystemTraversal::FileInfo& info)
+{
+    const std::wstring path = info.path.ToStdWstring();
+    const size_t       name_len = info.name.length();
+    if (path.size() < name_len)
+    {
+        return true;
+    }
+
+    DirMap::iterator it = dirs.find(NormalizeDirKey(path.substr(0, path.size() - name_len)));
+    if (it == dirs.end())
+    {
+        return true;
+    }
+
+    FileCatalog::EntryId id = AddEntry(table, it->second, info.name, !info.isfile);
+    if (id == FileCatalog::InvalidId)
+    {
+        wxLogWarning("File catalog is full, stop indexing at `%s`", info.path);
+        return false;
+    }
+
+    if (!info.isfile)
+    {
+        dirs[NormalizeDirKey(path)] = id;
+    }
+    return true;
+}
+
+static void BuildCatalogTable(FileCatalog::Data* data, CatalogTable& table, const wxString& root,
+                              const std::atomic<bool>& looping)
+{
+    DirMap     dirs;
+    std::mutex mutex;
+    dirs[NormalizeDirKey(root.ToStdWstring())] = AddEntry(table, FileCatalog::InvalidId, root, true);
+    data->watcher->AddDirectory(root);
+
+    /* Directories are reported before their content, so the parent is always known. */
+    auto cb = [&](const FileSystemTraversal::FileInfo& info) {
+        if (!looping || !data->looping)
+        {
+            return false;
+        }
+        if (!info.isfile)
+        {
+            data->watcher->AddDirectory(info.path);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return AppendTreeEntry(table, dirs, info);
+    };
+    FileSystemTraversal::ParallelTraversal(root, SIZE_MAX, cb, wxGetApp().settings->Get().TraversalThreads);
+}
+
+/**
+ * @brief Resolve path to a live entry. Must be called with lock held.
+ */
+static FileCatalog::EntryId FindPath(const FileCatalog::Data* data, const std::wstring& path)
+{
+    const std::wstring root = NormalizeDirKey(data->root.ToStdWstring());
+    const std::wstring norm = NormalizeDirKey(path);
+    if (data->table.entries.empty() || norm.compare(0, root.size(), root) != 0)
+    {
+        return FileCatalog::InvalidId;
+    }
+    if (norm.size() == root.size())
+    {
+        return 0;
+    }
+    if (!root.empty() && norm[root.size()] != L'/' && norm[root.size()] != L'\\')
+    {
+        return FileCatalog::InvalidId;
+    }
+
+    FileCatalog::EntryId id = 0;
+    size_t               pos = root.size();
+    while (id != FileCatalog::InvalidId && pos < norm.size())
+    {
+        const size_t begin = norm.find_first_not_of(L"/\\", pos);
+        if (begin == std::wstring::npos)
+        {
+            break;
+        }
+        size_t end = norm.find_first_of(L"/\\", begin);
+        if (end == std::wstring::npos)
+        {
+            end = norm.size();
+        }
+
+        const wxString name(norm.substr(begin, end - begin));
+        id = IndexFind(data->table, id, name.ToUTF8().data());
+        pos = end;
+    }
+    return id;
+}
+
+static void ApplyEvent(FileCatalog::Data* data, const FileSystemWatcher::Event& e);
+
+/**
+ * @brief Walk the whole tree and replace the table. Must be called with build_mutex held.
+ */
+static void BuildTable(FileCatalog::Data* data, const wxString& root, const std::atomic<bool>& looping)
+{
+    CatalogTable table;
+    BuildCatalogTable(data, table, root, looping);
+
+    std::unique_lock<std::shared_mutex> lock(data->mutex);
+    data->table = std::move(table);
+    data->root = root;
+}
+
+/**
+ * @brief Apply the events deferred while building, then let events through again.
+ */
+static void ReplayPending(FileCatalog::Data* data)
+{
+    for (;;)
+    {
+        EventList events;
+        {
+            std::lock_guard<std::mutex> lock(data->pending_mutex);
+            if (data->pending.empty())
+            {
+                data->building = false;
+                break;
+            }
+            events.swap(data->pending);
+        }
+
+        for (const auto& e : events)
+        {
+            ApplyEvent(data, e);
+        }
+    }
+}
+
+static void BuildAndSwap(FileCatalog::Data* data, const wxString& root, const std::atomic<bool>& looping)
+{
+    std::lock_guard<std::mutex> build_lock(data->build_mutex);
+    {
+        std::lock_guard<std::mutex> lock(data->pending_mutex);
+        data->building = true;
+    }
+
+    BuildTable(data, root, looping);
+
+    /* Replay changes that happened while walking. */
+    ReplayPending(data);
+}
+
+/**
+ * @brief Add the entry unless it exists. Must be called with lock held.
+ * @return Entry id, InvalidId if its parent is unknown or the catalog is full.
+ */
+static FileCatalog::EntryId InsertPathLocked(FileCatalog::Data* data, const wxString& path, bool isdir)
+{
+    std::wstring parent, name;
+    if (!SplitPath(path.ToStdWstring(), &parent, &name))
+    {
+        return FileCatalog::InvalidId;
+    }
+
+    FileCatalog::EntryId parent_id = FindPath(data, parent);
+    if (parent_id == FileCatalog::InvalidId)
+    {
+        return FileCatalog::InvalidId;
+    }
+    FileCatalog::EntryId id = IndexFind(data->table, parent_id, wxString(name).ToUTF8().data());
+    if (id != FileCatalog::InvalidId)
+    {
+        return id;
+    }
+    return AddEntry(data->table, parent_id, name, isdir);
+}
+
+/**
+ * @brief Remove the entry and its subtree. Must be called with lock held.
+ */
+static void RemovePathLocked(FileCatalog::Data* data, const wxString& path)
+{
+    FileCatalog::EntryId id = FindPath(data, path.ToStdWstring());
+    if (id == FileCatalog::InvalidId || id == 0)
+    {
+        return;
+    }
+
+    MarkDead(data->table, id);
+    MaybeCompactTable(data->table);
+}
+
+static void InsertPath(FileCatalog::Data* data, const wxString& path, bool isdir)
+{
+    std::unique_lock<std::shared_mutex> lock(data->mutex);
+    InsertPathLocked(data, path, isdir);
+}
+
+static void RemovePath(FileCatalog::Data* data, const wxString& path)
+{
+    std::unique_lock<std::shared_mutex> lock(data->mutex);
+    RemovePathLocked(data, path);
+}
+
+/**
+ * @brief Walk the subtree again and replace its entries at once, queries never see it half filled.
+ *
+ * The root is rebuilt as a whole, which is only done on the rescan thread with build_mutex held.
+ */
+static void RescanPath(FileCatalog::Data* data, const wxString& path)
+{
+    wxString root;
+    {
+        std::shared_lock<std::shared_mutex> lock(data->mutex);
+        root = data->root;
+    }
+    if (NormalizeDirKey(path.ToStdWstring()) == NormalizeDirKey(root.ToStdWstring()))
+    {
+        BuildTable(data, root, data->looping);
+        return;
+    }
+
+    std::error_code                            ec;
+    const std::filesystem::file_status         st = std::filesystem::status(path.ToStdWstring(), ec);
+    const bool                                 isdir = !ec && std::filesystem::is_directory(st);
+    const bool                                 exists = isdir || (!ec && std::filesystem::is_regular_file(st));
+    std::vector<FileSystemTraversal::FileInfo> infos;
+
+    if (isdir)
+    {
+        data->watcher->AddDirectory(path);
+        FileSystemTraversal::Traversal(path, SIZE_MAX, [data, &infos](const FileSystemTraversal::FileInfo& info) {
+            if (!info.isfile)
+            {
+                data->watcher->AddDirectory(info.path);
+            }
+            infos.push_back(info);
+            return static_cast<bool>(data->looping);
+        });
+    }
+
+    std::unique_lock<std::shared_mutex> lock(data->mutex);
+    RemovePathLocked(data, path);
+    if (!exists)
+    {
+        return;
+    }
+    FileCatalog::EntryId id = InsertPathLocked(data, path, isdir);
+    if (id == FileCatalog::InvalidId)
+    {
+        return;
+    }
+
+    DirMap dirs;
+    dirs[NormalizeDirKey(path.ToStdWstring())] = id;
+    for (const auto& info : infos)
+    {
+        if (!AppendTreeEntry(data->table, dirs, info))
+        {
+            break;
+        }
+    }
+}
+
+static void RenamePath(FileCatalog::Data* data, const wxString& from, const wxString& to, bool isdir)
+{
+    std::wstring parent, name;
+    if (!SplitPath(to.ToStdWstring(), &parent, &name))
+    {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(data->mutex);
+    CatalogTable&                       table = data->table;
+    FileCatalog::EntryId                id = FindPath(data, from.ToStdWstring());
+    FileCatalog::EntryId                parent_id = FindPath(data, parent);
+    if (id == FileCatalog::InvalidId)
+    {
+        /* Source was never indexed, treat as a new entry. */
+        lock.unlock();
+        RescanPath(data, to);
+        return;
+    }
+    if (id == 0)
+    {
+        return;
+    }
+
+    if (parent_id == FileCatalog::InvalidId)
+    {
+        MarkDead(table, id);
+        MaybeCompactTable(table);
+        return;
+    }
+
+    const wxScopedCharBuffer name_utf8 = wxString(name).ToUTF8();
+    const wxScopedCharBuffer key_utf8 = wxString(name).Lower().ToUTF8();
+    FileCatalog::EntryId     existing = IndexFind(table, parent_id, name_utf8.data());
+    if (existing == id)
+    {
+        return;
+    }
+    if (existing != FileCatalog::InvalidId)
+    {
+        MarkDead(table, existing);
+    }
+
+    /* A directory is never moved below itself, a catalog out of sync must not make a loop. */
+    for (FileCatalog::EntryId up = parent_id; up < table.entries.size(); up = table.entries[up].parent)
+    {
+        if (up == id)
+        {
+            return;
+        }
+    }
+
+    CatalogEntry& e = table.entries[id];
+    if (name_utf8.length() > UINT16_MAX || table.names.size() + name_utf8.length() > UINT32_MAX ||
+        table.keys.size() + key_utf8.length() + 1 > UINT32_MAX)
+    {
+        MarkDead(table, id);
+        MaybeCompactTable(table);
+        return;
+    }
+
+    /*
+     * The entry is moved in place, so its descendants keep their parent.
+     * The new name is appended and the old bytes are reclaimed on compaction,
+     * the index slot of the old name is left behind and never matches again.
+     */
+    AddSubtreeSize(table, e.parent, -static_cast<int64_t>(e.size));
+    table.stale_bytes += e.name_length + strlen(table.keys.data() + e.key_offset) + 1;
+    e.parent = parent_id;
+    e.name_offset = static_cast<uint32_t>(table.names.size());
+    e.key_offset = static_cast<uint32_t>(table.keys.size());
+    e.name_length = static_cast<uint16_t>(name_utf8.length());
+    e.flags = static_cast<uint16_t>((e.flags & ~EntryFlagDir) | (isdir ? EntryFlagDir : 0));
+    table.names.append(name_utf8.data(), name_utf8.length());
+    table.keys.append(key_utf8.data(), key_utf8.length());
+    table.keys.push_back('\0');
+    AddSubtreeSize(table, parent_id, e.size);
+    IndexInsert(table, id);
+    MaybeCompactTable(table);
+}
+
+static bool IsSameOrSubPath(const std::wstring& path, const std::wstring& prefix)
+{
+    return path.compare(0, prefix.size(), prefix) == 0 &&
+           (path.size() == prefix.size() || path[prefix.size()] == L'/' || path[prefix.size()] == L'\\');
+}
+
+/**
+ * @brief Hand a subtree to the rescan thread. A subtree already queued, or inside a queued one, is walked once.
+ */
+static void QueueRescan(FileCatalog::Data* data, const wxString& path)
+{
+    const std::wstring          key = NormalizeDirKey(path.ToStdWstring());
+    std::lock_guard<std::mutex> lock(data->pending_mutex);
+    for (const wxString& queued : data->rescans)
+    {
+        if (IsSameOrSubPath(key, NormalizeDirKey(queued.ToStdWstring())))
+        {
+            return;
+        }
+    }
+    data->rescans.erase(std::remove_if(data->rescans.begin(), data->rescans.end(),
+                                       [&key](const wxString& queued) {
+                                           return IsSameOrSubPath(NormalizeDirKey(queued.ToStdWstring()), key);
+                                       }),
+                        data->rescans.end());
+    data->rescans.push_back(path);
+    data->rescan_cond.notify_one();
+}
+
+/**
+ * @brief Walk queued subtrees. Events that arrive meanwhile are deferred like during a build,
+ *   so the watcher thread keeps draining the kernel queue.
+ */
+static void RescanThread(FileCatalog::Data* data)
+{
+    for (;;)
+    {
+        std::vector<wxString> paths;
+        {
+            std::unique_lock<std::mutex> lock(data->pending_mutex);
+            data->rescan_cond.wait(lock, [data]() { return !data->looping || !data->rescans.empty(); });
+            if (!data->looping)
+            {
+                return;
+            }
+        }
+
+        std::lock_guard<std::mutex> build_lock(data->build_mutex);
+        {
+            std::lock_guard<std::mutex> lock(data->pending_mutex);
+            paths.swap(data->rescans);
+            data->building = true;
+        }
+        for (size_t i = 0; i < paths.size() && data->looping; i++)
+        {
+            RescanPath(data, paths[i]);
+        }
+        ReplayPending(data);
+    }
+}
+
+static void ApplyEvent(FileCatalog::Data* data, const FileSystemWatcher::Event& e)
+{
+    switch (e.action)
+    {
+    case FileSystemWatcher::Action::Create:
+        if (e.isdir)
+        {
+            /* The directory may already have content when it is moved in. */
+            RescanPath(data, e.path);
+        }
+        else
+        {
+            InsertPath(data, e.path, false);
+        }
+        break;
+    case FileSystemWatcher::Action::Delete:
+        RemovePath(data, e.path);
+        break;
+    case FileSystemWatcher::Action::Rename:
+        RenamePath(data, e.path, e.new_path, e.isdir);
+        break;
+    case FileSystemWatcher::Action::Rescan:
+        QueueRescan(data, e.path);
+        break;
+    }
+}
+
+static void OnWatchEvent(FileCatalog::Data* data, const FileSystemWatcher::Event& e)
+{
+    if (e.action == FileSystemWatcher::Action::Rescan)
+    {
+        QueueRescan(data, e.path);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(data->pending_mutex);
+        if (data->building)
+        {
+            data->pending.push_back(e);
+            return;
+        }
+    }
+    ApplyEvent(data, e);
+}
+
+static wxString GetEntryName(const CatalogTable& table, FileCatalog::EntryId id)
+{
+    const CatalogEntry& e = table.entries[id];
+    return wxString::FromUTF8(table.names.data() + e.name_offset, e.name_length);
+}
+
+/**
+ * @brief Build full path of entry.
+ * @return false if the entry or any of its ancestors is dead.
+ */
+static bool GetEntryPath(const CatalogTable& table, FileCatalog::EntryId id, wxString* ret)
+{
+    std::vector<FileCatalog::EntryId> chain;
+    for (; id < table.entries.size(); id = table.entries[id].parent)
+    {
+        if (table.entries[id].flags & EntryFlagDead)
+        {
+            return false;
+        }
+        chain.push_back(id);
+    }
+
+    const char  sep = static_cast<char>(wxFileName::GetPathSeparator());
+    std::string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+    {
+        const CatalogEntry& e = table.entries[*it];
+        if (!path.empty() && path.back() != sep)
+        {
+            path.push_back(sep);
+        }
+        path.append(table.names.data() + e.name_offset, e.name_length);
+    }
+
+    *ret = wxString::FromUTF8(path.data(), path.size());
+    return true;
+}
+
+/**
+ * @brief Get the file info of a live regular file entry.
+ * @return false if the entry is a directory or dead.
+ */
+static bool GetEntryInfo(const CatalogTable& table, FileCatalog::EntryId id, FileSystemTraversal::FileInfo* info)
+{
+    if (table.entries[id].flags & (EntryFlagDir | EntryFlagDead))
+    {
+        return false;
+    }
+    if (!GetEntryPath(table, id, &info->path))
+    {
+        return false;
+    }
+    info->name = GetEntryName(table, id);
+    info->isfile = true;
+    return true;
+}
+
+/**
+ * @brief Report the candidate files of a range of entries.
+ *   Candidates are collected under the shared lock, the callback runs after it is released,
+ *   so that filters doing I/O never hold back updates of the catalog.
+ */
+static void ScanCatalogRange(FileCatalog::Data* data, const FuzzyMatch& query, size_t begin, size_t end,
+                             const FileCatalog::Callback& cb, std::atomic_bool& looping)
+{
+    std::vector<FileSystemTraversal::FileInfo> found;
+    {
+        std::shared_lock<std::shared_mutex> lock(data->mutex);
+        const CatalogTable&                 table = data->table;
+
+        /* The table may have been rebuilt since the query started. */
+        end = std::min(end, table.entries.size());
+        for (size_t id = begin; id < end && looping; id++)
+        {
+            const char* key = table.keys.data() + table.entries[id].key_offset;
+            if (!query.IsEmpty() && !query.IsCandidate(key))
+            {
+                continue;
+            }
+            FileSystemTraversal::FileInfo info;
+            if (GetEntryInfo(table, static_cast<FileCatalog::EntryId>(id), &info))
+            {
+                found.push_back(std::move(info));
+            }
+        }
+    }
+
+    for (const FileSystemTraversal::FileInfo& info : found)
+    {
+        if (!looping || !cb(info))
+        {
+            looping = false;
+            break;
+        }
+    }
+}
+
+FileCatalog::FileCatalog()
+{
+    m_data = new Data;
+}
+
+FileCatalog::~FileCatalog()
+{
+    /* The rescan thread adds watches, it stops before the watcher goes. */
+    {
+        std::lock_guard<std::mutex> lock(m_data->pending_mutex);
+        m_data->looping = false;
+    }
+    m_data->rescan_cond.notify_all();
+    if (m_data->rescan_thread != nullptr)
+    {
+        m_data->rescan_thread->join();
+        delete m_data->rescan_thread;
+    }
+    delete m_data->watcher;
+    delete m_data;
+}
+
+void FileCatalog::Build(const wxString& root, const std::atomic<bool>& looping)
+{
+    /* Nothing is watched until the first build. */
+    if (m_data->watcher == nullptr)
+    {
+        m_data->watcher =
+            FileSystemWatcher::Create([this](const FileSystemWatcher::Event& e) { OnWatchEvent(m_data, e); });
+        m_data->rescan_thread = new std::thread(RescanThread, m_data);
+    }
+    BuildAndSwap(m_data, root, looping);
+}
+
+void FileCatalog::Query(const FuzzyMatch& query, Callback cb) const
+{
+    size_t count;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_data->mutex);
+        count = m_data->table.entries.size();
+    }
+
+    unsigned threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+
+    /* Split into more chunks than threads so that a slow chunk does not stall the whole query. */
+    const size_t        chunk = std::max<size_t>(4096, count / (threads * 8) + 1);
+    std::atomic<size_t> next = 0;
+    std::atomic_bool    looping = true;
+
+    auto worker = [&]() {
+        size_t begin;
+        while (looping && (begin = next.fetch_add(chunk)) < count)
+        {
+            ScanCatalogRange(m_data, query, begin, std::min(begin + chunk, count), cb, looping);
+        }
+    };
+
+    threads = static_cast<unsigned>(std::min<size_t>(threads, count / chunk + 1));
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+}
+
+size_t FileCatalog::GetCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_data->mutex);
+    return m_data->table.entries.size() - m_data->table.dead_count;
+}
@@ -0,0 +1,65 @@
+#ifndef LAUNCHR_UTILS_FILE_CATALOG_HPP
+#define LAUNCHR_UTILS_FILE_CATALOG_HPP
+
+#include <wx/wx.h>
+#include <atomic>
+#include <cstdint>
+#include "FileSystem.hpp"
+#include "FuzzyMatch.hpp"
+
+namespace LR
+{
+
+/**
+ * @brief Resident filename catalog.
+ *
+ * All names are packed contiguously into one buffer and addressed by offset,
+ * every entry only keeps the id of its parent directory. Queries scan the
+ * packed lowercase keys in parallel without touching the disk.
+ */
+struct FileCatalog
+{
+    typedef uint32_t EntryId;
+    static constexpr EntryId InvalidId = UINT32_MAX;
+
+    /**
+     * @brief Query callback. May be called from several threads at the same time.
+     * @return true to continue query, false to stop.
+     */
+    typedef FileSystemTraversal::Callback Callback;
+
+    FileCatalog();
+    ~FileCatalog();
+
+    /**
+     * @brief Rebuild the catalog from the given directory. The first build also starts watching it.
+     * @param[in] root Root directory.
+     * @param[in] looping Building stops once it becomes false.
+     */
+    void Build(const wxString& root, const std::atomic<bool>& looping);
+
+    /**
+     * @brief Search regular files whose name may match the fuzzy query.
+     *
+     * Only the cheap FuzzyMatch::IsCandidate() check is done on the packed
+     * keys, the callback scores the reported files. It runs from several
+     * threads without the catalog lock, so a file changed meanwhile may be
+     * reported as it was.
+     *
+     * @param[in] query Fuzzy query. Empty query matches all files.
+     * @param[in] cb Match callback.
+     */
+    void Query(const FuzzyMatch& query, Callback cb) const;
+
+    /**
+     * @brief Get the number of entries, including directories.
+     */
+    size_t GetCount() const;
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
@@ -1,31 +1,241 @@
 #include <wx/wx.h>
+#include <wx/filename.h>
 #include <wx/log.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "FileSystem.hpp"
 
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
+
 using namespace LR;
 
+#if defined(__linux__)
+/* Bytes of directory entries read by one getdents64() call, several hundred entries. */
+static const size_t DirentBufferSize = 64 * 1024;
+#endif
+
 struct PathRecord
 {
     typedef std::list<PathRecord> Queue;
-    PathRecord(const std::wstring& path, size_t level);
-    std::wstring path;
-    size_t       level;
+    PathRecord() = default;
+    PathRecord(wxString path, size_t level);
+    wxString path;
+    size_t   level = 0;
 };
 
-PathRecord::PathRecord(const std::wstring& path, size_t level)
+/**
+ * @brief Directory queue owned by one traversal worker.
+ *   The owner works on the back, idle workers steal from the front.
+ */
+struct TraversalWorker
 {
-    this->path = path;
+    std::mutex             mutex; /* Guard for queue. */
+    std::deque<PathRecord> queue; /* Directories to visit. */
+};
+
+struct ParallelTraversalContext
+{
+    ParallelTraversalContext(size_t level, FileSystemTraversal::Callback cb, unsigned threads);
+
+    size_t                                        level;   /* Max directory level. */
+    FileSystemTraversal::Callback                 cb;      /* Result callback. */
+    std::vector<std::unique_ptr<TraversalWorker>> workers; /* Worker queues. */
+    std::atomic<size_t>                           pending; /* Directories queued or being visited. */
+    std::atomic<bool>                             looping; /* Looping flag. */
+    std::mutex                                    mutex;   /* Mutex for cond. */
+    std::condition_variable                       cond;    /* Wakeup for idle workers. */
+};
+
+PathRecord::PathRecord(wxString path, size_t level)
+{
+    this->path = std::move(path);
     this->level = level;
 }
 
-void FileSystemTraversal::Traversal(const wxString& path, size_t level, Callback cb)
+#if defined(__linux__)
+
+/**
+ * @brief Get the type of an entry d_type does not tell, following symbolic links.
+ * @return DT_REG, DT_DIR, or DT_UNKNOWN for anything else.
+ */
+static unsigned char GetEntryType(int dir_fd, const char* name)
+{
+    struct statx stx;
+    if (statx(dir_fd, name, AT_STATX_SYNC_AS_STAT, STATX_TYPE, &stx) != 0 || !(stx.stx_mask & STATX_TYPE))
+    {
+        return DT_UNKNOWN;
+    }
+    if (S_ISREG(stx.stx_mode))
+    {
+        return DT_REG;
+    }
+    return S_ISDIR(stx.stx_mode) ? DT_DIR : DT_UNKNOWN;
+}
+
+bool FileSystemTraversal::ListDirectory(const wxString& path, const EntryCallback& cb)
+{
+    const int fd = open(path.fn_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        wxLogVerbose("Access fs failed: cannot open `%s`: %s", path, strerror(errno));
+        return true;
+    }
+
+    /* Entries are 8-byte aligned records. */
+    std::unique_ptr<uint64_t[]> buffer(new uint64_t[DirentBufferSize / sizeof(uint64_t)]);
+    bool                        looping = true;
+    while (looping)
+    {
+        const long length = syscall(SYS_getdents64, fd, buffer.get(), DirentBufferSize);
+        if (length <= 0)
+        {
+            if (length < 0)
+            {
+                wxLogVerbose("Access fs failed: cannot read `%s`: %s", path, strerror(errno));
+            }
+            break;
+        }
+
+        const char* data = reinterpret_cast<const char*>(buffer.get());
+        for (long pos = 0; pos < length && looping;)
+        {
+            const struct dirent64* entry = reinterpret_cast<const struct dirent64*>(data + pos);
+            pos += entry->d_reclen;
+
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            {
+                continue;
+            }
+
+            unsigned char type = entry->d_type;
+            if (type == DT_LNK || type == DT_UNKNOWN)
+            {
+                type = GetEntryType(fd, name);
+            }
+            if (type != DT_REG && type != DT_DIR)
+            {
+                continue;
+            }
+
+            /*
+             * Names are bytes, decode them the way fn_str() encodes paths. An empty
+             * name would make the entry path its parent directory, so skip it.
+             */
+            FileInfo info;
+            info.name = wxString(name, *wxConvFileName);
+            if (info.name.empty())
+            {
+                wxLogVerbose("Access fs failed: cannot decode an entry name in `%s`", path);
+                continue;
+            }
+            info.isfile = type == DT_REG;
+            looping = cb(info);
+        }
+    }
+
+    close(fd);
+    return looping;
+}
+
+#else
+
+bool FileSystemTraversal::ListDirectory(const wxString& path, const EntryCallback& cb)
+{
+    try
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(path.ToStdWstring()))
+        {
+            const bool is_directory = entry.is_directory();
+            const bool is_regular_file = entry.is_regular_file();
+            if (!is_regular_file && !is_directory)
+            {
+                continue;
+            }
+
+            FileInfo info;
+            info.name = entry.path().filename().wstring();
+            info.isfile = is_regular_file;
+            if (!cb(info))
+            {
+                return false;
+            }
+        }
+    }
+    catch (const std::filesystem::filesystem_error& e)
+    {
+        wxLogVerbose("Access fs failed: %s", e.what());
+    }
+    return true;
+}
+
+#endif
+
+wxString FileSystemTraversal::JoinPath(const wxString& dir, const wxString& name)
 {
-    const std::wstring wpath = path.ToStdWstring();
+    const wxUniChar sep = wxFileName::GetPathSeparator();
+    wxString        path;
+    path.reserve(dir.length() + 1 + name.length());
+    path += dir;
+    if (!dir.empty() && dir.Last() != sep && dir.Last() != '/')
+    {
+        path += sep;
+    }
+    path += name;
+    return path;
+}
 
+/**
+ * @brief Report entries of one directory.
+ * @param[in] record Directory to visit.
+ * @param[in] cb Result callback.
+ * @param[in] push Called for every subdirectory.
+ * @return false if the callback requests to stop.
+ */
+template <typename Push>
+static bool TraversalDirectory(const PathRecord& record, const FileSystemTraversal::Callback& cb, Push push)
+{
+    return FileSystemTraversal::ListDirectory(record.path, [&record, &cb, &push](FileSystemTraversal::FileInfo& info) {
+        info.path = FileSystemTraversal::JoinPath(record.path, info.name);
+        if (!cb(info))
+        {
+            return false;
+        }
+
+        /* The path is not needed any more, the directory record takes it. */
+        if (!info.isfile)
+        {
+            push(PathRecord(std::move(info.path), record.level + 1));
+        }
+        return true;
+    });
+}
+
+void FileSystemTraversal::Traversal(const wxString& path, size_t level, Callback cb)
+{
     PathRecord::Queue pathQueue;
-    pathQueue.push_back(PathRecord(wpath, 0));
+    pathQueue.push_back(PathRecord(path, 0));
 
     bool looping = true;
     while (looping && !pathQueue.empty())
@@ -38,80 +248,167 @@ void FileSystemTraversal::Traversal(const wxString& path, size_t level, Callback
             break;
         }
 
-        try
+        looping = TraversalDirectory(record, cb, [&pathQueue](PathRecord&& r) { pathQueue.push_back(std::move(r)); });
+    }
+}
+
+ParallelTraversalContext::ParallelTraversalContext(size_t level, FileSystemTraversal::Callback cb, unsigned threads)
+    : level(level), cb(cb), pending(0), looping(true)
+{
+    for (unsigned i = 0; i < threads; i++)
+    {
+        workers.push_back(std::make_unique<TraversalWorker>());
+    }
+}
+
+static bool PopLocal(TraversalWorker* worker, PathRecord& record)
+{
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    if (worker->queue.empty())
+    {
+        return false;
+    }
+    record = std::move(worker->queue.back());
+    worker->queue.pop_back();
+    return true;
+}
+
+static bool StealRemote(ParallelTraversalContext* ctx, size_t self, PathRecord& record)
+{
+    const size_t count = ctx->workers.size();
+    for (size_t i = 1; i < count; i++)
+    {
+        TraversalWorker*            victim = ctx->workers[(self + i) % count].get();
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->queue.empty())
+        {
+            /* The oldest directory is likely the biggest subtree. */
+            record = std::move(victim->queue.front());
+            victim->queue.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ParallelTraversalThread(ParallelTraversalContext* ctx, size_t self)
+{
+    TraversalWorker* worker = ctx->workers[self].get();
+
+    while (ctx->looping)
+    {
+        PathRecord record;
+        if (!PopLocal(worker, record) && !StealRemote(ctx, self, record))
         {
-            for (const auto& entry : std::filesystem::directory_iterator(record.path))
+            std::unique_lock<std::mutex> lock(ctx->mutex);
+            if (ctx->pending == 0)
             {
-                const bool is_directory = entry.is_directory();
-                const bool is_regular_file = entry.is_regular_file();
-                if (!is_regular_file && !is_directory)
-                {
-                    continue;
-                }
-
-                std::filesystem::path filePath = entry.path();
-                FileInfo              info;
-                info.name = filePath.filename().wstring();
-                info.path = filePath.wstring();
-                info.isfile = is_regular_file;
-                if (!cb(info))
-                {
-                    looping = false;
-                    break;
-                }
-
-                if (is_directory)
-                {
-                    pathQueue.push_back(PathRecord(filePath.wstring(), record.level + 1));
-                }
+                break;
             }
+            ctx->cond.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
         }
-        catch (const std::filesystem::filesystem_error& e)
+
+        auto push = [ctx, worker](PathRecord&& r) {
+            if (r.level > ctx->level)
+            {
+                return;
+            }
+            ctx->pending++;
+            {
+                std::lock_guard<std::mutex> lock(worker->mutex);
+                worker->queue.push_back(std::move(r));
+            }
+            ctx->cond.notify_one();
+        };
+        if (!TraversalDirectory(record, ctx->cb, push))
+        {
+            ctx->looping = false;
+        }
+
+        if (--ctx->pending == 0 || !ctx->looping)
         {
-            wxLogVerbose("Access fs failed: %s", e.what());
+            std::lock_guard<std::mutex> lock(ctx->mutex);
+            ctx->cond.notify_all();
         }
     }
 }
 
+void FileSystemTraversal::ParallelTraversal(const wxString& path, size_t level, Callback cb, unsigned threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    if (threads == 1)
+    {
+        Traversal(path, level, cb);
+        return;
+    }
+
+    ParallelTraversalContext ctx(level, cb, threads);
+    ctx.pending = 1;
+    ctx.workers[0]->queue.push_back(PathRecord(path, 0));
+
+    std::vector<std::thread> threadList;
+    for (unsigned i = 1; i < threads; i++)
+    {
+        threadList.emplace_back(ParallelTraversalThread, &ctx, i);
+    }
+    ParallelTraversalThread(&ctx, 0);
+
+    for (auto& t : threadList)
+    {
+        t.join();
+    }
+}
+
+#if defined(WIN32)
+
 struct FileMemoryMap::Data
 {
     Data(const wxString& path);
     ~Data();
+    void     Unmap();
     wxString path;
     HANDLE   hFile = INVALID_HANDLE_VALUE;
     HANDLE   hMapFile = nullptr;
-    LPVOID   pMappedView = nullptr;
+    LPVOID   pMappedView = nullptr; /* Start of view, aligned to allocation granularity. */
+    void*    addr = nullptr;        /* Start of requested region. */
+    size_t   size = 0;              /* Size of requested region. */
+    uint64_t file_size = 0;         /* File size. */
 };
 
 FileMemoryMap::Data::Data(const wxString& path)
 {
     this->path = path;
 
-    hFile = CreateFileW(path.wc_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
-                        nullptr);
+    hFile = CreateFileW(path.wc_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
     if (hFile == INVALID_HANDLE_VALUE)
     {
         wxLogWarning("Cannot open file `" + path + "`");
         return;
     }
 
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+    {
+        return;
+    }
+    file_size = fileSize.QuadPart;
+
     hMapFile = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
     if (hMapFile == nullptr)
     {
         wxLogWarning("Cannot create file mapping for `" + path + "`");
         return;
     }
-
-    pMappedView = MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
 }
 
 FileMemoryMap::Data::~Data()
 {
-    if (pMappedView != nullptr)
-    {
-        UnmapViewOfFile(pMappedView);
-        pMappedView = nullptr;
-    }
+    Unmap();
     if (hMapFile != nullptr)
     {
         CloseHandle(hMapFile);
@@ -124,9 +421,139 @@ FileMemoryMap::Data::~Data()
     }
 }
 
-FileMemoryMap::FileMemoryMap(const wxString& path)
+void FileMemoryMap::Data::Unmap()
+{
+    if (pMappedView != nullptr)
+    {
+        UnmapViewOfFile(pMappedView);
+        pMappedView = nullptr;
+    }
+    addr = nullptr;
+    size = 0;
+}
+
+void* FileMemoryMap::Map(uint64_t offset, size_t length)
+{
+    m_data->Unmap();
+    if (m_data->hMapFile == nullptr || offset >= m_data->file_size)
+    {
+        return nullptr;
+    }
+    length = static_cast<size_t>(std::min<uint64_t>(length, m_data->file_size - offset));
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    const uint64_t base = offset - offset % si.dwAllocationGranularity;
+    const size_t   delta = static_cast<size_t>(offset - base);
+
+    m_data->pMappedView = MapViewOfFile(m_data->hMapFile, FILE_MAP_READ, static_cast<DWORD>(base >> 32),
+                                        static_cast<DWORD>(base & 0xFFFFFFFF), length + delta);
+    if (m_data->pMappedView == nullptr)
+    {
+        wxLogWarning("Cannot map view of `" + m_data->path + "`");
+        return nullptr;
+    }
+
+    m_data->addr = static_cast<char*>(m_data->pMappedView) + delta;
+    m_data->size = length;
+    return m_data->addr;
+}
+
+#else
+
+struct FileMemoryMap::Data
+{
+    Data(const wxString& path);
+    ~Data();
+    void     Unmap();
+    wxString path;
+    int      fd = -1;
+    void*    base = nullptr; /* Start of mapping, aligned to page size. */
+    size_t   base_len = 0;   /* Length of mapping. */
+    void*    addr = nullptr; /* Start of requested region. */
+    size_t   size = 0;       /* Size of requested region. */
+    uint64_t file_size = 0;  /* File size. */
+};
+
+FileMemoryMap::Data::Data(const wxString& path)
+{
+    this->path = path;
+
+    fd = open(path.fn_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        wxLogWarning("Cannot open file `" + path + "`");
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        file_size = st.st_size;
+    }
+}
+
+FileMemoryMap::Data::~Data()
+{
+    Unmap();
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void FileMemoryMap::Data::Unmap()
+{
+    if (base != nullptr)
+    {
+        munmap(base, base_len);
+        base = nullptr;
+        base_len = 0;
+    }
+    addr = nullptr;
+    size = 0;
+}
+
+void* FileMemoryMap::Map(uint64_t offset, size_t length)
+{
+    m_data->Unmap();
+    if (m_data->fd < 0 || offset >= m_data->file_size)
+    {
+        return nullptr;
+    }
+    length = static_cast<size_t>(std::min<uint64_t>(length, m_data->file_size - offset));
+
+    static const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+    const uint64_t        base = offset - offset % pageSize;
+    const size_t          delta = static_cast<size_t>(offset - base);
+
+    void* ptr = mmap(nullptr, length + delta, PROT_READ, MAP_PRIVATE, m_data->fd, static_cast<off_t>(base));
+    if (ptr == MAP_FAILED)
+    {
+        wxLogWarning("Cannot create file mapping for `" + m_data->path + "`");
+        return nullptr;
+    }
+
+    /* Content search reads every byte once, let the kernel read ahead aggressively. */
+    madvise(ptr, length + delta, MADV_SEQUENTIAL);
+
+    m_data->base = ptr;
+    m_data->base_len = length + delta;
+    m_data->addr = static_cast<char*>(ptr) + delta;
+    m_data->size = length;
+    return m_data->addr;
+}
+
+#endif
+
+FileMemoryMap::FileMemoryMap(const wxString& path, bool map_all)
 {
     m_data = new Data(path);
+    if (map_all && m_data->file_size != 0)
+    {
+        Map(0, static_cast<size_t>(std::min<uint64_t>(m_data->file_size, SIZE_MAX)));
+    }
 }
 
 FileMemoryMap::~FileMemoryMap()
@@ -136,16 +563,15 @@ FileMemoryMap::~FileMemoryMap()
 
 void* FileMemoryMap::GetAddr()
 {
-    return m_data->pMappedView;
+    return m_data->addr;
 }
 
 size_t FileMemoryMap::GetSize()
 {
-    DWORD fileSizeHigh = 0;
-    DWORD fileSizeLow = GetFileSize(m_data->hFile, &fileSizeHigh);
+    return m_data->size;
+}
 
-    LARGE_INTEGER fileSize;
-    fileSize.LowPart = fileSizeLow;
-    fileSize.HighPart = fileSizeHigh;
-    return fileSize.QuadPart;
+uint64_t FileMemoryMap::GetFileSize()
+{
+    return m_data->file_size;
 }
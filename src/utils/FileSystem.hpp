@@ -22,6 +22,34 @@ struct FileSystemTraversal
      */
     typedef std::function<bool(const FileInfo& info)> Callback;
 
+    /**
+     * @brief Directory entry callback.
+     * @param[in,out] info Entry name and type, the path is left empty. The callback may take the strings.
+     * @return true to continue listing, false to stop.
+     */
+    typedef std::function<bool(FileInfo& info)> EntryCallback;
+
+    /**
+     * @brief List regular files and directories of one directory, symbolic links are followed.
+     *
+     * On Linux entries are read in large getdents64() batches and their type
+     * is taken from d_type, statx() is only called for links and on
+     * filesystems that do not fill d_type. Elsewhere std::filesystem is used.
+     *
+     * @param[in] path Directory path.
+     * @param[in] cb Entry callback.
+     * @return false if the callback requests to stop.
+     */
+    static bool ListDirectory(const wxString& path, const EntryCallback& cb);
+
+    /**
+     * @brief Build the path of a directory entry.
+     * @param[in] dir Directory path.
+     * @param[in] name Entry name.
+     * @return Entry path.
+     */
+    static wxString JoinPath(const wxString& dir, const wxString& name);
+
     /**
      * @brief FileSystem traversal.
      * @param[in] path Filesystem path.
@@ -29,16 +57,55 @@ struct FileSystemTraversal
      * @param[in] cb Result callback.
      */
     static void Traversal(const wxString& path, size_t level, Callback cb);
+
+    /**
+     * @brief Multi-threaded filesystem traversal.
+     *
+     * Every worker visits directories from its own queue and steals from the
+     * others when it runs dry. A directory is always reported before its
+     * content, but the callback is called from several threads at the same time.
+     *
+     * @param[in] path Filesystem path.
+     * @param[in] level Directory level. 0 is the first level.
+     * @param[in] cb Result callback.
+     * @param[in] threads Number of threads. 0 to use all cores, 1 is the same as Traversal().
+     */
+    static void ParallelTraversal(const wxString& path, size_t level, Callback cb, unsigned threads = 0);
 };
 
 struct FileMemoryMap
 {
-    explicit FileMemoryMap(const wxString& path);
+    /**
+     * @brief Open file for reading.
+     * @param[in] path File path.
+     * @param[in] map_all Map the whole file. If false, use Map() to map part of the file.
+     */
+    explicit FileMemoryMap(const wxString& path, bool map_all = true);
     ~FileMemoryMap();
 
+    /**
+     * @brief Map a region of the file. The previous region is unmapped.
+     * @param[in] offset Region offset, no alignment required.
+     * @param[in] length Region length, truncated at the end of file.
+     * @return Region address, or nullptr if failed.
+     */
+    void* Map(uint64_t offset, size_t length);
+
+    /**
+     * @brief Get the address of the mapped region.
+     */
     void* GetAddr();
+
+    /**
+     * @brief Get the size of the mapped region.
+     */
     size_t GetSize();
 
+    /**
+     * @brief Get the size of the file.
+     */
+    uint64_t GetFileSize();
+
     struct Data;
     struct Data* m_data;
 };
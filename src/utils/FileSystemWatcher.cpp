@@ -0,0 +1,474 @@
+#include <wx/wx.h>
+#include <wx/log.h>
+#include "FileSystemWatcher.hpp"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#endif
+
+using namespace LR;
+
+bool FileSystemWatcher::AddDirectory(const wxString&)
+{
+    return false;
+}
+
+#if defined(__linux__)
+
+/* Directories that cannot be watched are rescanned with this interval. */
+static const int UnwatchedRescanInterval = 60 * 1000;
+
+/* A move source waits this long for its destination before it is reported as deleted. */
+static const int MovePairTimeout = 100;
+
+static const uint32_t InotifyWatchMask =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+typedef std::unordered_map<int, std::string> WatchMap;
+typedef std::set<std::string>                PathSet;
+
+struct PendingMove
+{
+    std::string path;  /* Source path. */
+    bool        isdir; /* True if directory. */
+    uint64_t    batch; /* Batch of events the source was read in. */
+};
+typedef std::map<uint32_t, PendingMove> PendingMoveMap;
+
+struct InotifyWatcher : FileSystemWatcher
+{
+    explicit InotifyWatcher(Callback cb);
+    ~InotifyWatcher() override;
+    bool AddDirectory(const wxString& path) override;
+
+    Callback       cb;                /* Event callback. */
+    int            inotify_fd = -1;   /* Inotify instance. */
+    int            event_fd = -1;     /* Wakeup for exit. */
+    std::thread*   thread = nullptr;  /* Watcher thread. */
+    PendingMoveMap moves;             /* Move sources waiting for their destination, by cookie. Watcher thread only. */
+    uint64_t       batch = 0;         /* Number of event batches read. Watcher thread only. */
+    PathSet        dirty;             /* Directories with events in the current batch. Watcher thread only. */
+    bool           overflow = false;  /* The kernel dropped events of the current batch. Watcher thread only. */
+    bool           limit_hit = false; /* Watch limit reached, already logged. */
+    std::mutex     mutex;             /* Guard for watches and unwatched. */
+    WatchMap       watches;           /* Watch descriptor to directory path. */
+    PathSet        unwatched;         /* Directories failed to watch. */
+};
+
+static std::string ToNativePath(const wxString& path)
+{
+    return std::filesystem::path(path.ToStdWstring()).native();
+}
+
+static wxString FromNativePath(const std::string& path)
+{
+    return std::filesystem::path(path).wstring();
+}
+
+static bool IsSubPath(const std::string& path, const std::string& prefix)
+{
+    return path.size() > prefix.size() && path.compare(0, prefix.size(), prefix) == 0 && path[prefix.size()] == '/';
+}
+
+/**
+ * @brief Drop the paths that have an ancestor in the same set, so every subtree is only reported once.
+ */
+static std::vector<std::string> GetTopMostPaths(const PathSet& paths)
+{
+    std::vector<std::string> ret;
+    for (const std::string& path : paths)
+    {
+        bool   covered = false;
+        size_t pos = path.size();
+        while (!covered && (pos = path.rfind('/', pos - 1)) != std::string::npos && pos > 0)
+        {
+            covered = paths.find(path.substr(0, pos)) != paths.end();
+        }
+        if (!covered)
+        {
+            ret.push_back(path);
+        }
+    }
+    return ret;
+}
+
+static void PushEvent(std::vector<FileSystemWatcher::Event>& events, FileSystemWatcher::Action action,
+                      const std::string& path, bool isdir)
+{
+    FileSystemWatcher::Event e;
+    e.action = action;
+    e.path = FromNativePath(path);
+    e.isdir = isdir;
+    events.push_back(e);
+}
+
+/**
+ * @brief Keep watch paths in sync after a directory is renamed. Must be called with lock held.
+ */
+static void RenameWatches(InotifyWatcher* w, const std::string& from, const std::string& to)
+{
+    for (auto& it : w->watches)
+    {
+        if (it.second == from)
+        {
+            it.second = to;
+        }
+        else if (IsSubPath(it.second, from))
+        {
+            it.second = to + it.second.substr(from.size());
+        }
+    }
+}
+
+/**
+ * @brief Stop watching a directory tree that left the watched area. Must be called with lock held.
+ */
+static void RemoveWatches(InotifyWatcher* w, const std::string& path)
+{
+    for (auto it = w->watches.begin(); it != w->watches.end(); ++it)
+    {
+        if (it->second == path || IsSubPath(it->second, path))
+        {
+            /* The map entry is erased when IN_IGNORED arrives. */
+            inotify_rm_watch(w->inotify_fd, it->first);
+        }
+    }
+}
+
+/**
+ * @brief Report a move without destination as Delete, the entry left the watched area. Must be called with lock held.
+ */
+static void ExpireMove(InotifyWatcher* w, PendingMoveMap::iterator move, std::vector<FileSystemWatcher::Event>& events)
+{
+    if (move->second.isdir)
+    {
+        RemoveWatches(w, move->second.path);
+    }
+    PushEvent(events, FileSystemWatcher::Action::Delete, move->second.path, move->second.isdir);
+    w->moves.erase(move);
+}
+
+/**
+ * @brief Expire the moves read before the given batch. Must be called with lock held.
+ */
+static void ExpireMoves(InotifyWatcher* w, uint64_t batch, std::vector<FileSystemWatcher::Event>& events)
+{
+    for (auto it = w->moves.begin(); it != w->moves.end();)
+    {
+        auto next = std::next(it);
+        if (it->second.batch < batch)
+        {
+            ExpireMove(w, it, events);
+        }
+        it = next;
+    }
+}
+
+static void ProcessInotifyEvent(InotifyWatcher* w, const struct inotify_event* ev,
+                                std::vector<FileSystemWatcher::Event>& events)
+{
+    std::lock_guard<std::mutex> lock(w->mutex);
+
+    if (ev->mask & IN_Q_OVERFLOW)
+    {
+        /* Rescans are reported once the batch is read, see ReportOverflow(). */
+        w->overflow = true;
+        return;
+    }
+
+    if (ev->mask & IN_IGNORED)
+    {
+        w->watches.erase(ev->wd);
+        return;
+    }
+
+    WatchMap::iterator it = w->watches.find(ev->wd);
+    if (it == w->watches.end() || ev->len == 0)
+    {
+        return;
+    }
+
+    const std::string path = it->second + "/" + ev->name;
+    const bool        isdir = (ev->mask & IN_ISDIR) != 0;
+    w->dirty.insert(it->second);
+
+    /* A pending move of the same path happened before this event, it must be reported first. */
+    if (!(ev->mask & IN_MOVED_TO))
+    {
+        for (auto move = w->moves.begin(); move != w->moves.end(); ++move)
+        {
+            if (move->second.path == path)
+            {
+                ExpireMove(w, move, events);
+                break;
+            }
+        }
+    }
+
+    if (ev->mask & IN_CREATE)
+    {
+        PushEvent(events, FileSystemWatcher::Action::Create, path, isdir);
+    }
+    else if (ev->mask & IN_DELETE)
+    {
+        PushEvent(events, FileSystemWatcher::Action::Delete, path, isdir);
+    }
+    else if (ev->mask & IN_MOVED_FROM)
+    {
+        w->moves[ev->cookie] = PendingMove{ path, isdir, w->batch };
+    }
+    else if (ev->mask & IN_MOVED_TO)
+    {
+        PendingMoveMap::iterator move = w->moves.find(ev->cookie);
+        if (move == w->moves.end())
+        {
+            PushEvent(events, FileSystemWatcher::Action::Create, path, isdir);
+            return;
+        }
+
+        if (isdir)
+        {
+            RenameWatches(w, move->second.path, path);
+        }
+
+        PushEvent(events, FileSystemWatcher::Action::Rename, move->second.path, isdir);
+        events.back().new_path = FromNativePath(path);
+        w->moves.erase(move);
+    }
+}
+
+/**
+ * @brief Report the directories to walk again after the kernel dropped events. Must be called with lock held.
+ *
+ * What was dropped is unknown, but a burst that fills the queue keeps hitting
+ * the directories it already touched, so the subtrees of the directories with
+ * events in this batch are rescanned. Only a batch without any other event
+ * falls back to every watched tree.
+ */
+static void ReportOverflow(InotifyWatcher* w, std::vector<FileSystemWatcher::Event>& events)
+{
+    PathSet paths;
+    paths.swap(w->dirty);
+    if (paths.empty())
+    {
+        for (const auto& it : w->watches)
+        {
+            paths.insert(it.second);
+        }
+    }
+
+    const std::vector<std::string> topmost = GetTopMostPaths(paths);
+    for (const std::string& path : topmost)
+    {
+        PushEvent(events, FileSystemWatcher::Action::Rescan, path, true);
+    }
+    wxLogWarning("Filesystem event queue overflow, rescan %zu directories", topmost.size());
+}
+
+static void ReadInotifyEvents(InotifyWatcher* w)
+{
+    alignas(struct inotify_event) char buf[64 * 1024];
+
+    std::vector<FileSystemWatcher::Event> events;
+
+    ssize_t n;
+    while ((n = read(w->inotify_fd, buf, sizeof(buf))) > 0)
+    {
+        for (char* p = buf; p < buf + n;)
+        {
+            const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(p);
+            ProcessInotifyEvent(w, ev, events);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    /*
+     * The destination of a move may be queued after the read drained the
+     * queue, so sources of this batch wait for the next one. Older sources
+     * never got their pair, the entry left the watched area.
+     */
+    {
+        std::lock_guard<std::mutex> lock(w->mutex);
+        ExpireMoves(w, w->batch, events);
+        if (w->overflow)
+        {
+            ReportOverflow(w, events);
+            w->overflow = false;
+        }
+        w->dirty.clear();
+    }
+    w->batch++;
+
+    for (const auto& e : events)
+    {
+        w->cb(e);
+    }
+}
+
+static void RescanUnwatched(InotifyWatcher* w)
+{
+    std::vector<std::string> paths;
+    {
+        std::lock_guard<std::mutex> lock(w->mutex);
+        paths = GetTopMostPaths(w->unwatched);
+
+        /* Consumers add the directories again while rescanning, so they are retried. */
+        w->unwatched.clear();
+        w->limit_hit = false;
+    }
+
+    for (const std::string& path : paths)
+    {
+        FileSystemWatcher::Event e;
+        e.action = FileSystemWatcher::Action::Rescan;
+        e.path = FromNativePath(path);
+        e.isdir = true;
+        w->cb(e);
+    }
+}
+
+static void InotifyThread(InotifyWatcher* w)
+{
+    auto last_rescan = std::chrono::steady_clock::now();
+
+    for (;;)
+    {
+        struct pollfd fds[2];
+        fds[0].fd = w->inotify_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = w->event_fd;
+        fds[1].events = POLLIN;
+
+        int ret = poll(fds, 2, w->moves.empty() ? UnwatchedRescanInterval : MovePairTimeout);
+        if (ret < 0 && errno != EINTR)
+        {
+            wxLogError("poll() failed: %s", strerror(errno));
+            break;
+        }
+        if (ret > 0 && (fds[1].revents & POLLIN))
+        {
+            break;
+        }
+        if (ret > 0 && (fds[0].revents & POLLIN))
+        {
+            ReadInotifyEvents(w);
+        }
+        else if (ret == 0 && !w->moves.empty())
+        {
+            /* No destination came in time. */
+            std::vector<FileSystemWatcher::Event> events;
+            {
+                std::lock_guard<std::mutex> lock(w->mutex);
+                ExpireMoves(w, UINT64_MAX, events);
+            }
+            for (const auto& e : events)
+            {
+                w->cb(e);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_rescan >= std::chrono::milliseconds(UnwatchedRescanInterval))
+        {
+            RescanUnwatched(w);
+            last_rescan = now;
+        }
+    }
+}
+
+InotifyWatcher::InotifyWatcher(Callback cb)
+{
+    this->cb = cb;
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+        wxLogWarning("inotify_init1() failed: %s", strerror(errno));
+        return;
+    }
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0)
+    {
+        wxLogWarning("eventfd() failed: %s", strerror(errno));
+        close(inotify_fd);
+        inotify_fd = -1;
+        return;
+    }
+
+    thread = new std::thread(InotifyThread, this);
+}
+
+InotifyWatcher::~InotifyWatcher()
+{
+    if (thread != nullptr)
+    {
+        uint64_t v = 1;
+        (void)!write(event_fd, &v, sizeof(v));
+        thread->join();
+        delete thread;
+    }
+    if (event_fd >= 0)
+    {
+        close(event_fd);
+    }
+    if (inotify_fd >= 0)
+    {
+        close(inotify_fd);
+    }
+}
+
+bool InotifyWatcher::AddDirectory(const wxString& path)
+{
+    const std::string native = ToNativePath(path);
+    const int         wd = inotify_add_watch(inotify_fd, native.c_str(), InotifyWatchMask);
+    const int         err = errno;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (wd < 0)
+    {
+        if (err == ENOSPC || err == ENOMEM)
+        {
+            if (!limit_hit)
+            {
+                limit_hit = true;
+                wxLogWarning("Out of inotify watches, `%s` and others are rescanned periodically", path);
+            }
+            unwatched.insert(native);
+        }
+        return false;
+    }
+
+    watches[wd] = native;
+    return true;
+}
+
+#endif
+
+FileSystemWatcher* FileSystemWatcher::Create(Callback cb)
+{
+#if defined(__linux__)
+    InotifyWatcher* w = new InotifyWatcher(cb);
+    if (w->thread != nullptr)
+    {
+        return w;
+    }
+    delete w;
+#else
+    (void)cb;
+#endif
+    return new FileSystemWatcher;
+}
@@ -0,0 +1,63 @@
+#ifndef LAUNCHR_UTILS_FILE_SYSTEM_WATCHER_HPP
+#define LAUNCHR_UTILS_FILE_SYSTEM_WATCHER_HPP
+
+#include <wx/wx.h>
+#include <functional>
+
+namespace LR
+{
+
+/**
+ * @brief Filesystem change notification.
+ *
+ * The base implementation watches nothing, platforms with a backend override it.
+ */
+struct FileSystemWatcher
+{
+    enum class Action : int
+    {
+        Create, /* Entry created or moved into a watched directory. */
+        Delete, /* Entry deleted or moved out of watched directories. */
+        Rename, /* Entry renamed between watched directories. */
+        Rescan, /* Changes inside the tree are unknown, it must be walked again. */
+    };
+
+    struct Event
+    {
+        Action   action;   /* Event type. */
+        wxString path;     /* Affected path, the old path for Rename. */
+        wxString new_path; /* New path for Rename. */
+        bool     isdir;    /* True if directory. */
+    };
+
+    /**
+     * @brief Event callback, called from the watcher thread.
+     */
+    typedef std::function<void(const Event& e)> Callback;
+
+    FileSystemWatcher() = default;
+    FileSystemWatcher(const FileSystemWatcher&) = delete;
+    virtual ~FileSystemWatcher() = default;
+
+    /**
+     * @brief Watch direct children of the directory. Subdirectories must be added separately.
+     *
+     * If the system runs out of watch descriptors the directory is remembered and
+     * reported periodically as Rescan, so that its content is refreshed anyway.
+     *
+     * @param[in] path Directory path.
+     * @return true if the directory is watched.
+     */
+    virtual bool AddDirectory(const wxString& path);
+
+    /**
+     * @brief Create the watcher for current platform.
+     * @param[in] cb Event callback.
+     * @return Watcher instance.
+     */
+    static FileSystemWatcher* Create(Callback cb);
+};
+
+} // namespace LR
+
+#endif
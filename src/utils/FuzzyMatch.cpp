@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <climits>
+#include "FuzzyMatch.hpp"
+
+using namespace LR;
+
+static const int ScoreMatch = 16;        /* Every matched character. */
+static const int ScoreGapStart = -3;     /* First unmatched character between two matches. */
+static const int ScoreGapExtension = -1; /* Every further unmatched character. */
+static const int BonusBoundary = 8;      /* Match at start or after a separator. */
+static const int BonusCamelCase = 7;     /* Match at an uppercase letter after a lowercase one. */
+static const int BonusConsecutive = 4;   /* Match right after the previous one. */
+static const int BonusFirstFactor = 2;   /* Boundary bonus of the first character counts more. */
+static const int BonusExactName = 32;    /* Query is the whole name, or the name without extension. */
+static const int PenaltyDepth = 2;       /* Every directory level of the path. */
+static const int MaxDepth = 16;          /* Deeper levels cost no more. */
+
+static const int ScoreNone = INT_MIN / 2;
+
+static bool IsSeparator(uint32_t c)
+{
+    return c == '/' || c == '\\' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+static std::vector<uint32_t> ToChars(const wxString& str)
+{
+    std::vector<uint32_t> chars;
+    chars.reserve(str.length());
+    for (wxString::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+        chars.push_back(static_cast<uint32_t>((*it).GetValue()));
+    }
+    return chars;
+}
+
+/**
+ * @brief Bonus for a match at every position of the name.
+ */
+static std::vector<int> ComputeBonus(const wxString& name)
+{
+    std::vector<int> bonus;
+    bonus.reserve(name.length());
+
+    uint32_t prev = '/';
+    for (wxString::const_iterator it = name.begin(); it != name.end(); ++it)
+    {
+        const uint32_t c = static_cast<uint32_t>((*it).GetValue());
+        if (IsSeparator(prev) && !IsSeparator(c))
+        {
+            bonus.push_back(BonusBoundary);
+        }
+        else if (wxIslower(prev) && wxIsupper(c))
+        {
+            bonus.push_back(BonusCamelCase);
+        }
+        else
+        {
+            bonus.push_back(0);
+        }
+        prev = c;
+    }
+    return bonus;
+}
+
+/**
+ * @brief Score the best alignment of pattern in text.
+ *
+ * Row by row over the pattern, every cell holds the best score with the current
+ * pattern character matched at that position. Gaps are carried along the row,
+ * so the cost is O(pattern length * text length).
+ */
+static int ScoreAlignment(const std::vector<uint32_t>& pattern, const std::vector<uint32_t>& text,
+                          const std::vector<int>& bonus)
+{
+    const size_t     n = text.size();
+    std::vector<int> prev(n, ScoreNone);
+    std::vector<int> cur(n, ScoreNone);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (text[i] == pattern[0])
+        {
+            prev[i] = ScoreMatch + bonus[i] * BonusFirstFactor;
+        }
+    }
+
+    for (size_t j = 1; j < pattern.size(); j++)
+    {
+        int carry = ScoreNone; /* Best score with a gap ending right before i. */
+        for (size_t i = 0; i < n; i++)
+        {
+            if (i >= 2)
+            {
+                carry = std::max(carry + ScoreGapExtension, prev[i - 2] + ScoreGapStart);
+            }
+
+            cur[i] = ScoreNone;
+            if (text[i] != pattern[j] || i == 0)
+            {
+                continue;
+            }
+            if (prev[i - 1] > ScoreNone)
+            {
+                cur[i] = prev[i - 1] + ScoreMatch + std::max(bonus[i], BonusConsecutive);
+            }
+            if (carry > ScoreNone)
+            {
+                cur[i] = std::max(cur[i], carry + ScoreMatch + bonus[i]);
+            }
+        }
+        prev.swap(cur);
+    }
+
+    return *std::max_element(prev.begin(), prev.end());
+}
+
+static int ScoreDepth(const wxString& path)
+{
+    int depth = 0;
+    for (wxString::const_iterator it = path.begin(); it != path.end() && depth < MaxDepth; ++it)
+    {
+        if (*it == '/' || *it == '\\')
+        {
+            depth++;
+        }
+    }
+    return -depth * PenaltyDepth;
+}
+
+FuzzyMatch::FuzzyMatch(const wxString& query)
+{
+    const wxString lower = query.Lower();
+    key = lower.ToUTF8().data();
+    pattern = ToChars(lower);
+}
+
+bool FuzzyMatch::IsEmpty() const
+{
+    return pattern.empty();
+}
+
+bool FuzzyMatch::IsCandidate(std::string_view key) const
+{
+    /* Bytes of a UTF-8 subsequence are a subsequence of the bytes too. */
+    size_t pos = 0;
+    for (char c : this->key)
+    {
+        pos = key.find(c, pos);
+        if (pos == std::string_view::npos)
+        {
+            return false;
+        }
+        pos++;
+    }
+    return true;
+}
+
+std::optional<int> FuzzyMatch::Score(const wxString& name, const wxString& path) const
+{
+    const int depth = ScoreDepth(path);
+    if (pattern.empty())
+    {
+        return depth;
+    }
+
+    const wxString              lower = name.Lower();
+    const std::vector<uint32_t> text = ToChars(lower);
+    if (text.size() < pattern.size())
+    {
+        return std::nullopt;
+    }
+
+    /* Greedy scan first, most names fail here. */
+    size_t pos = 0;
+    for (uint32_t c : pattern)
+    {
+        while (pos < text.size() && text[pos] != c)
+        {
+            pos++;
+        }
+        if (pos == text.size())
+        {
+            return std::nullopt;
+        }
+        pos++;
+    }
+
+    int score = ScoreAlignment(pattern, text, ComputeBonus(name)) + depth;
+
+    const size_t dot = lower.rfind('.');
+    if (text.size() == pattern.size() ||
+        (dot != wxString::npos && dot == pattern.size() && std::equal(pattern.begin(), pattern.end(), text.begin())))
+    {
+        score += BonusExactName;
+    }
+    return score;
+}
+
+bool FuzzyMatch::Narrows(const FuzzyMatch& other) const
+{
+    /* If the other query is a subsequence of this one, so it is of every name this one matches. */
+    size_t pos = 0;
+    for (uint32_t c : other.pattern)
+    {
+        while (pos < pattern.size() && pattern[pos] != c)
+        {
+            pos++;
+        }
+        if (pos == pattern.size())
+        {
+            return false;
+        }
+        pos++;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef LAUNCHR_UTILS_FUZZY_MATCH_HPP
+#define LAUNCHR_UTILS_FUZZY_MATCH_HPP
+
+#include <wx/wx.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace LR
+{
+
+/**
+ * @brief Fuzzy name matcher with relevance score.
+ *
+ * A name matches if all query characters appear in it in order, in any case.
+ * The best alignment is scored: consecutive characters and characters at word
+ * boundaries (start, after a separator, camelCase hump) earn bonuses, gaps cost
+ * a little. Names equal to the query and shallow paths rank higher.
+ */
+struct FuzzyMatch
+{
+    /**
+     * @brief Compile query.
+     * @param[in] query Query string. Empty query matches everything.
+     */
+    explicit FuzzyMatch(const wxString& query = wxEmptyString);
+
+    /**
+     * @brief Check if query is empty.
+     */
+    bool IsEmpty() const;
+
+    /**
+     * @brief Cheap check before scoring, on a key that is already lowercase.
+     * @param[in] key Lowercase UTF-8 name.
+     * @return false if the name can never match.
+     */
+    bool IsCandidate(std::string_view key) const;
+
+    /**
+     * @brief Match and score a name.
+     * @param[in] name Display name.
+     * @param[in] path Full path, only its depth is used. Empty if none.
+     * @return Score, higher is better. std::nullopt if not matched.
+     */
+    std::optional<int> Score(const wxString& name, const wxString& path) const;
+
+    /**
+     * @brief Check if all names matching this query also match the other one.
+     * @param[in] other The other query.
+     * @return true if this query is narrower or the same.
+     */
+    bool Narrows(const FuzzyMatch& other) const;
+
+    std::string           key;     /* Lowercase query in UTF-8. */
+    std::vector<uint32_t> pattern; /* Lowercase query characters. */
+};
+
+} // namespace LR
+
+#endif
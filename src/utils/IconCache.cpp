@@ -0,0 +1,389 @@
+#include <wx/wx.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+#include <wx/mimetype.h>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "LaunchR.hpp"
+#include "IconCache.hpp"
+
+using namespace LR;
+
+/* Cache file layout, older or foreign files are ignored. */
+static const uint32_t CacheMagic = 0x4349524c; /* "LRIC" */
+static const uint32_t CacheVersion = 1;
+
+/* At most this many icons are saved. */
+static const size_t MaxSavedIcons = 4096;
+
+enum IconFlag : uint8_t
+{
+    IconFlagExecutable = 0x01, /* Key is an executable path, otherwise a file extension. */
+    IconFlagImage = 0x02,      /* Pixels follow. */
+    IconFlagAlpha = 0x04,      /* Alpha channel follows the pixels. */
+};
+
+struct IconEntry
+{
+    bool    executable = false; /* Key is an executable path. */
+    int64_t mtime = 0;          /* Modification time of the executable when it was loaded. */
+    wxImage image;              /* Rescaled icon, invalid if there is none. */
+};
+
+typedef std::map<std::wstring, IconEntry>             IconEntryMap;
+typedef std::list<std::pair<std::wstring, bool>>      RequestList;
+typedef std::list<std::pair<std::wstring, IconEntry>> ResolvedList;
+
+struct IconCache::Data
+{
+    Data(int width, int height, Callback cb);
+    ~Data();
+
+    int      width;  /* Icon width. */
+    int      height; /* Icon height. */
+    wxString path;   /* Cache file path. */
+    Callback cb;     /* Resolve callback. */
+
+    RequestList requests; /* Keys to resolve, the latest first. UI thread only. */
+
+    std::mutex              mutex;         /* Guard for the members below. */
+    std::condition_variable cond;          /* Signaled when a resolved icon is queued. */
+    IconEntryMap            entries;       /* Rescaled icons. */
+    ResolvedList            resolved;      /* Icons resolved on the UI thread, to rescale. */
+    std::set<std::wstring>  pending;       /* Keys queued, resolved or being rescaled. */
+    bool                    dirty;         /* Entries changed since the cache file was loaded. */
+    bool                    looping;       /* Looping flag. */
+    std::thread*            loader_thread; /* Loader thread. */
+};
+
+static int64_t GetFileMtime(const wxString& path)
+{
+    std::error_code ec;
+    const auto      mtime = std::filesystem::last_write_time(std::filesystem::path(path.ToStdWstring()), ec);
+    return ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count());
+}
+
+static wxIcon GetSystemIconForExtension(const wxString& ext)
+{
+    std::unique_ptr<wxFileType> fileType(wxTheMimeTypesManager->GetFileTypeFromExtension(ext));
+    if (fileType == nullptr)
+    {
+        return wxNullIcon;
+    }
+
+    wxIconLocation iconPath;
+    if (!fileType->GetIcon(&iconPath))
+    {
+        return wxNullIcon;
+    }
+    return wxIcon(iconPath);
+}
+
+/**
+ * @brief Get the icon in its original size. UI thread only.
+ */
+static wxImage LoadIconImage(const wxString& key, bool executable)
+{
+    wxLogNull logNo; /* Files without icons are common, do not report them. */
+    wxIcon    icon = executable ? wxIcon(key, wxBITMAP_TYPE_ICO) : GetSystemIconForExtension(key);
+    if (!icon.IsOk())
+    {
+        return wxImage();
+    }
+
+    wxBitmap bmp;
+    bmp.CopyFromIcon(icon);
+    return bmp.ConvertToImage();
+}
+
+static void PutBytes(std::string& buf, const void* data, size_t size)
+{
+    buf.append(static_cast<const char*>(data), size);
+}
+
+static bool GetBytes(const char*& pos, const char* end, void* data, size_t size)
+{
+    if (static_cast<size_t>(end - pos) < size)
+    {
+        return false;
+    }
+    memcpy(data, pos, size);
+    pos += size;
+    return true;
+}
+
+static void SerializeEntry(std::string& buf, const std::wstring& key, const IconEntry& entry, size_t pixels)
+{
+    uint8_t flags = 0;
+    flags |= entry.executable ? IconFlagExecutable : 0;
+    flags |= entry.image.IsOk() ? IconFlagImage : 0;
+    flags |= entry.image.IsOk() && entry.image.HasAlpha() ? IconFlagAlpha : 0;
+
+    const wxScopedCharBuffer key_utf8 = wxString(key).ToUTF8();
+    const uint32_t           key_length = static_cast<uint32_t>(key_utf8.length());
+    PutBytes(buf, &flags, sizeof(flags));
+    PutBytes(buf, &key_length, sizeof(key_length));
+    PutBytes(buf, key_utf8.data(), key_length);
+    PutBytes(buf, &entry.mtime, sizeof(entry.mtime));
+    if (flags & IconFlagImage)
+    {
+        PutBytes(buf, entry.image.GetData(), pixels * 3);
+    }
+    if (flags & IconFlagAlpha)
+    {
+        PutBytes(buf, entry.image.GetAlpha(), pixels);
+    }
+}
+
+static bool DeserializeEntry(const char*& pos, const char* end, int width, int height, std::wstring* key,
+                             IconEntry* entry)
+{
+    const size_t pixels = static_cast<size_t>(width) * height;
+    uint8_t      flags = 0;
+    uint32_t     key_length = 0;
+    if (!GetBytes(pos, end, &flags, sizeof(flags)) || !GetBytes(pos, end, &key_length, sizeof(key_length)) ||
+        static_cast<size_t>(end - pos) < key_length)
+    {
+        return false;
+    }
+    *key = wxString::FromUTF8(pos, key_length).ToStdWstring();
+    pos += key_length;
+    entry->executable = (flags & IconFlagExecutable) != 0;
+    if (!GetBytes(pos, end, &entry->mtime, sizeof(entry->mtime)))
+    {
+        return false;
+    }
+    if (!(flags & IconFlagImage))
+    {
+        return true;
+    }
+
+    /* wxImage takes ownership of buffers allocated with malloc(). */
+    unsigned char* rgb = static_cast<unsigned char*>(malloc(pixels * 3));
+    if (!GetBytes(pos, end, rgb, pixels * 3))
+    {
+        free(rgb);
+        return false;
+    }
+    entry->image = wxImage(width, height, rgb);
+    if (flags & IconFlagAlpha)
+    {
+        unsigned char* alpha = static_cast<unsigned char*>(malloc(pixels));
+        if (!GetBytes(pos, end, alpha, pixels))
+        {
+            free(alpha);
+            return false;
+        }
+        entry->image.SetAlpha(alpha);
+    }
+    return true;
+}
+
+static IconEntryMap LoadCacheFile(const IconCache::Data* data)
+{
+    IconEntryMap entries;
+    wxLogNull    logNo; /* The file does not exist at the first start. */
+    wxFile       file;
+    if (!file.Open(data->path, wxFile::read))
+    {
+        return entries;
+    }
+
+    std::string buf(static_cast<size_t>(std::max<wxFileOffset>(file.Length(), 0)), '\0');
+    if (file.Read(&buf[0], buf.size()) != static_cast<ssize_t>(buf.size()))
+    {
+        return entries;
+    }
+
+    const char* pos = buf.data();
+    const char* end = buf.data() + buf.size();
+    uint32_t    header[4] = {};
+    if (!GetBytes(pos, end, header, sizeof(header)) || header[0] != CacheMagic || header[1] != CacheVersion ||
+        header[2] != static_cast<uint32_t>(data->width) || header[3] != static_cast<uint32_t>(data->height))
+    {
+        return entries;
+    }
+
+    std::wstring key;
+    IconEntry    entry;
+    while (pos < end && DeserializeEntry(pos, end, data->width, data->height, &key, &entry))
+    {
+        /* An executable may have been replaced, its icon is loaded again. */
+        if (!entry.executable || entry.mtime == GetFileMtime(key))
+        {
+            entries[key] = entry;
+        }
+        entry = IconEntry();
+    }
+    return entries;
+}
+
+static void SaveCacheFile(const IconCache::Data* data)
+{
+    wxFileName f(data->path);
+    if (!f.DirExists() && !f.Mkdir(wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+    {
+        wxLogWarning("Failed to create directory: %s", data->path);
+        return;
+    }
+
+    const size_t   pixels = static_cast<size_t>(data->width) * data->height;
+    const uint32_t header[4] = { CacheMagic, CacheVersion, static_cast<uint32_t>(data->width),
+                                 static_cast<uint32_t>(data->height) };
+    std::string    buf;
+    PutBytes(buf, header, sizeof(header));
+
+    size_t count = 0;
+    for (auto it = data->entries.begin(); it != data->entries.end() && count < MaxSavedIcons; ++it, count++)
+    {
+        SerializeEntry(buf, it->first, it->second, pixels);
+    }
+
+    /* Write aside and rename, so a crash never leaves a truncated cache behind. */
+    const wxString tmp_path = data->path + ".tmp";
+    wxFile         file;
+    if (!file.Open(tmp_path, wxFile::write) || file.Write(buf.data(), buf.size()) != buf.size())
+    {
+        wxLogWarning("Failed to write icon cache: %s", tmp_path);
+        return;
+    }
+    file.Close();
+    wxRenameFile(tmp_path, data->path, true);
+}
+
+static void IconLoaderThread(IconCache::Data* data)
+{
+    IconEntryMap loaded = LoadCacheFile(data);
+    {
+        std::lock_guard<std::mutex> lock(data->mutex);
+        data->entries.merge(loaded);
+    }
+    data->cb();
+
+    std::unique_lock<std::mutex> lock(data->mutex);
+    for (;;)
+    {
+        data->cond.wait(lock, [data] { return !data->looping || !data->resolved.empty(); });
+        if (!data->looping)
+        {
+            break;
+        }
+
+        std::pair<std::wstring, IconEntry> icon = std::move(data->resolved.front());
+        data->resolved.pop_front();
+        if (data->entries.find(icon.first) == data->entries.end())
+        {
+            lock.unlock();
+            IconEntry& entry = icon.second;
+            entry.mtime = entry.executable ? GetFileMtime(icon.first) : 0;
+            if (entry.image.IsOk())
+            {
+                entry.image.Rescale(data->width, data->height);
+            }
+            lock.lock();
+
+            data->entries[icon.first] = std::move(entry);
+            data->dirty = true;
+        }
+        data->pending.erase(icon.first);
+
+        /* Notify once per burst of icons, not for every icon. */
+        if (data->resolved.empty())
+        {
+            lock.unlock();
+            data->cb();
+            lock.lock();
+        }
+    }
+}
+
+IconCache::Data::Data(int width, int height, Callback cb)
+{
+    this->width = width;
+    this->height = height;
+    this->path = LaunchRApp::GenDataPath("icons.cache");
+    this->cb = std::move(cb);
+    this->dirty = false;
+    this->looping = true;
+    this->loader_thread = new std::thread(IconLoaderThread, this);
+}
+
+IconCache::Data::~Data()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        looping = false;
+    }
+    cond.notify_one();
+    loader_thread->join();
+    delete loader_thread;
+
+    if (dirty)
+    {
+        SaveCacheFile(this);
+    }
+}
+
+IconCache::IconCache(int width, int height, Callback cb)
+{
+    m_data = new Data(width, height, std::move(cb));
+}
+
+IconCache::~IconCache()
+{
+    delete m_data;
+}
+
+bool IconCache::Lookup(const wxString& key, bool executable, wxImage* image)
+{
+    const std::wstring          wkey = key.ToStdWstring();
+    std::lock_guard<std::mutex> lock(m_data->mutex);
+
+    IconEntryMap::const_iterator it = m_data->entries.find(wkey);
+    if (it != m_data->entries.end())
+    {
+        *image = it->second.image;
+        return true;
+    }
+
+    if (m_data->pending.insert(wkey).second)
+    {
+        m_data->requests.emplace_front(wkey, executable);
+    }
+    return false;
+}
+
+bool IconCache::ResolvePending(size_t max_count)
+{
+    for (size_t count = 0; count < max_count && !m_data->requests.empty(); count++)
+    {
+        const std::pair<std::wstring, bool> request = m_data->requests.front();
+        m_data->requests.pop_front();
+
+        /* The icon may have come from the cache file in the meantime. */
+        {
+            std::lock_guard<std::mutex> lock(m_data->mutex);
+            if (m_data->entries.find(request.first) != m_data->entries.end())
+            {
+                m_data->pending.erase(request.first);
+                continue;
+            }
+        }
+
+        IconEntry entry;
+        entry.executable = request.second;
+        entry.image = LoadIconImage(request.first, request.second);
+
+        std::lock_guard<std::mutex> lock(m_data->mutex);
+        m_data->resolved.emplace_back(request.first, std::move(entry));
+        m_data->cond.notify_one();
+    }
+    return !m_data->requests.empty();
+}
@@ -0,0 +1,58 @@
+#ifndef LAUNCHR_UTILS_ICON_CACHE_HPP
+#define LAUNCHR_UTILS_ICON_CACHE_HPP
+
+#include <wx/wx.h>
+#include <functional>
+
+namespace LR
+{
+
+/**
+ * @brief Asynchronous and persistent icon cache.
+ *
+ * Icons are resolved by file extension through the MIME types manager, or
+ * from the executable itself. Both create GUI objects and must run on the UI
+ * thread, so missing icons are only queued by Lookup() and resolved a few at
+ * a time by ResolvePending(). The loader thread rescales them and keeps them
+ * as images, which are saved to `.LaunchR/icons.cache` on exit and decoded
+ * again in background at the next start.
+ */
+struct IconCache
+{
+    /**
+     * @brief Called on the loader thread once queued icons are rescaled, or the cache file is loaded.
+     */
+    typedef std::function<void()> Callback;
+
+    /**
+     * @brief Constructor for icon cache.
+     * @param[in] width Icon width.
+     * @param[in] height Icon height.
+     * @param[in] cb Resolve callback.
+     */
+    IconCache(int width, int height, Callback cb);
+    ~IconCache();
+
+    /**
+     * @brief Get icon, or queue it for ResolvePending(). UI thread only, never blocks on resolving.
+     * @param[in] key File extension, or full path if executable.
+     * @param[in] executable The icon is stored in the file itself.
+     * @param[out] image Icon of the requested size, invalid if there is none.
+     * @return true if resolved, false if queued and the callback is called later.
+     */
+    bool Lookup(const wxString& key, bool executable, wxImage* image);
+
+    /**
+     * @brief Resolve icons queued by Lookup(), the latest first, and hand them to the loader. UI thread only.
+     * @param[in] max_count Resolve at most this many icons, to keep the UI responsive.
+     * @return true if icons are still queued.
+     */
+    bool ResolvePending(size_t max_count);
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
@@ -0,0 +1,46 @@
+#include "Notifier.hpp"
+
+using namespace LR;
+
+Notifier::Notifier()
+{
+    epoch = 0;
+    waiters = 0;
+}
+
+uint64_t Notifier::GetEpoch() const
+{
+    return epoch;
+}
+
+void Notifier::Wait(uint64_t epoch)
+{
+    ++waiters;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this, epoch] { return this->epoch != epoch; });
+    }
+    --waiters;
+}
+
+void Notifier::WaitFor(uint64_t epoch, std::chrono::milliseconds timeout)
+{
+    ++waiters;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, timeout, [this, epoch] { return this->epoch != epoch; });
+    }
+    --waiters;
+}
+
+void Notifier::Notify()
+{
+    ++epoch;
+
+    /* A waiter registers before checking the epoch under the lock, so it either sees the new epoch or gets woken. */
+    if (waiters != 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef LAUNCHR_UTILS_NOTIFIER_HPP
+#define LAUNCHR_UTILS_NOTIFIER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace LR
+{
+
+/**
+ * @brief Wake a sleeping consumer up when producers have news.
+ *
+ * The consumer reads the epoch, checks its sources, then waits for the epoch
+ * to change, so a notification between the check and the wait is not lost.
+ * Notify() only takes the lock while somebody is waiting.
+ */
+struct Notifier
+{
+    Notifier();
+    Notifier(const Notifier&) = delete;
+
+    /**
+     * @brief Get current epoch, must be read before checking the sources.
+     */
+    uint64_t GetEpoch() const;
+
+    /**
+     * @brief Wait until notified after the epoch was read.
+     * @param[in] epoch Epoch from GetEpoch().
+     */
+    void Wait(uint64_t epoch);
+
+    /**
+     * @brief Wait until notified after the epoch was read, or timeout.
+     * @param[in] epoch Epoch from GetEpoch().
+     * @param[in] timeout Max wait time.
+     */
+    void WaitFor(uint64_t epoch, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Wake the consumer up. Safe to call from any thread.
+     */
+    void Notify();
+
+    std::atomic<uint64_t>   epoch;   /* Increased on every notification. */
+    std::atomic<size_t>     waiters; /* Number of threads waiting. */
+    std::mutex              mutex;   /* Mutex for cond. */
+    std::condition_variable cond;    /* Condition for waiters. */
+};
+
+} // namespace LR
+
+#endif
@@ -0,0 +1,154 @@
+#include "QueryMetrics.hpp"
+
+using namespace LR;
+
+static Searcher::Counters SubtractCounters(const Searcher::Counters& a, const Searcher::Counters& b)
+{
+    Searcher::Counters ret;
+    ret.directories = a.directories - b.directories;
+    ret.files = a.files - b.files;
+    ret.bytes = a.bytes - b.bytes;
+    return ret;
+}
+
+/**
+ * @brief Format a size in bytes with a binary unit.
+ */
+static wxString FormatBytes(double bytes)
+{
+    static const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+    size_t             unit = 0;
+    while (bytes >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0]))
+    {
+        bytes /= 1024;
+        unit++;
+    }
+    if (unit == 0)
+    {
+        return wxString::Format("%.0f %s", bytes, units[unit]);
+    }
+    return wxString::Format("%.1f %s", bytes, units[unit]);
+}
+
+QueryMetrics::QueryMetrics()
+{
+    start = Clock::now();
+}
+
+size_t QueryMetrics::AddSource(const wxString& name, const Searcher::Counters& baseline)
+{
+    Source source;
+    source.name = name;
+    source.results = 0;
+    source.baseline = baseline;
+    sources.push_back(source);
+    return sources.size() - 1;
+}
+
+void QueryMetrics::OnResults(size_t idx, size_t count, const Searcher::Counters& counters)
+{
+    Source& source = sources[idx];
+    if (count != 0 && !source.first_ms.has_value())
+    {
+        source.first_ms = GetElapsedMs();
+    }
+    source.results += count;
+    source.counters = SubtractCounters(counters, source.baseline);
+}
+
+void QueryMetrics::OnFinished(size_t idx, const Searcher::Counters& counters)
+{
+    Source& source = sources[idx];
+    source.end_ms = GetElapsedMs();
+    source.counters = SubtractCounters(counters, source.baseline);
+}
+
+double QueryMetrics::GetElapsedMs() const
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+size_t QueryMetrics::GetResults() const
+{
+    size_t results = 0;
+    for (const Source& source : sources)
+    {
+        results += source.results;
+    }
+    return results;
+}
+
+std::optional<double> QueryMetrics::GetFirstMs() const
+{
+    std::optional<double> first_ms;
+    for (const Source& source : sources)
+    {
+        if (source.first_ms.has_value() && (!first_ms.has_value() || source.first_ms.value() < first_ms.value()))
+        {
+            first_ms = source.first_ms;
+        }
+    }
+    return first_ms;
+}
+
+wxString QueryMetrics::FormatSummary() const
+{
+    std::optional<double> end_ms;
+    for (const Source& source : sources)
+    {
+        if (source.end_ms.has_value() && (!end_ms.has_value() || source.end_ms.value() > end_ms.value()))
+        {
+            end_ms = source.end_ms;
+        }
+    }
+
+    const std::optional<double> first_ms = GetFirstMs();
+    wxString                    msg = wxString::Format("Done in %.0f ms", end_ms.value_or(GetElapsedMs()));
+    if (first_ms.has_value())
+    {
+        msg += wxString::Format(", first result after %.0f ms", first_ms.value());
+    }
+    return msg;
+}
+
+wxString QueryMetrics::FormatSource(size_t idx) const
+{
+    const Source& source = sources[idx];
+    const double  end_ms = source.end_ms.value_or(GetElapsedMs());
+    wxString      msg = wxString::Format("%s: %zu results", source.name, source.results);
+    if (source.first_ms.has_value())
+    {
+        msg += wxString::Format(", first after %.1f ms", source.first_ms.value());
+    }
+    if (source.end_ms.has_value())
+    {
+        msg += wxString::Format(", finished after %.1f ms", end_ms);
+    }
+    else
+    {
+        msg += wxString::Format(", stopped after %.1f ms", end_ms);
+    }
+
+    const Searcher::Counters& counters = source.counters;
+    if (counters.directories != 0)
+    {
+        msg += wxString::Format(", %llu directories", static_cast<unsigned long long>(counters.directories));
+    }
+    if (counters.files != 0)
+    {
+        msg += wxString::Format(", %llu files", static_cast<unsigned long long>(counters.files));
+        if (end_ms > 0)
+        {
+            msg += wxString::Format(" (%.0f/s)", counters.files * 1000.0 / end_ms);
+        }
+    }
+    if (counters.bytes != 0)
+    {
+        msg += ", " + FormatBytes(static_cast<double>(counters.bytes));
+        if (end_ms > 0)
+        {
+            msg += " (" + FormatBytes(counters.bytes * 1000.0 / end_ms) + "/s)";
+        }
+    }
+    return msg;
+}
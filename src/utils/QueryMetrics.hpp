@@ -0,0 +1,94 @@
+#ifndef LAUNCHR_UTILS_QUERY_METRICS_HPP
+#define LAUNCHR_UTILS_QUERY_METRICS_HPP
+
+#include <wx/wx.h>
+#include <chrono>
+#include <optional>
+#include <vector>
+#include "searchers/Searcher.hpp"
+
+namespace LR
+{
+
+/**
+ * @brief Timing and work of one query, for every searcher.
+ *
+ * Filled by the thread that fetches the results. Counters of refined
+ * iterators include the work of the previous query, so the counters seen at
+ * start are subtracted.
+ */
+struct QueryMetrics
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Source
+    {
+        wxString              name;     /* Searcher name. */
+        size_t                results;  /* Results fetched. */
+        std::optional<double> first_ms; /* Time of the first result. */
+        std::optional<double> end_ms;   /* Time of completion, unset while running. */
+        Searcher::Counters    baseline; /* Counters when the query started. */
+        Searcher::Counters    counters; /* Work done by this query. */
+    };
+
+    /**
+     * @brief Start measuring, the query starts now.
+     */
+    QueryMetrics();
+
+    /**
+     * @brief Add a searcher.
+     * @param[in] name Searcher name.
+     * @param[in] baseline Counters of the iterator when the query starts.
+     * @return Source index.
+     */
+    size_t AddSource(const wxString& name, const Searcher::Counters& baseline);
+
+    /**
+     * @brief Record fetched results.
+     * @param[in] idx Source index.
+     * @param[in] count Number of results fetched, may be 0.
+     * @param[in] counters Current counters of the iterator.
+     */
+    void OnResults(size_t idx, size_t count, const Searcher::Counters& counters);
+
+    /**
+     * @brief Record completion of a searcher.
+     * @param[in] idx Source index.
+     * @param[in] counters Final counters of the iterator.
+     */
+    void OnFinished(size_t idx, const Searcher::Counters& counters);
+
+    /**
+     * @brief Get time since the query started.
+     */
+    double GetElapsedMs() const;
+
+    /**
+     * @brief Get total results.
+     */
+    size_t GetResults() const;
+
+    /**
+     * @brief Get time of the first result of any searcher.
+     */
+    std::optional<double> GetFirstMs() const;
+
+    /**
+     * @brief Format a short summary, for the status bar.
+     */
+    wxString FormatSummary() const;
+
+    /**
+     * @brief Format a searcher breakdown on one line, for the log.
+     * @param[in] idx Source index.
+     */
+    wxString FormatSource(size_t idx) const;
+
+    Clock::time_point   start;   /* When the query started. */
+    std::vector<Source> sources; /* Searchers. */
+};
+
+} // namespace LR
+
+#endif
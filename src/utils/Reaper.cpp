@@ -0,0 +1,96 @@
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include "Reaper.hpp"
+
+using namespace LR;
+
+typedef std::list<std::shared_ptr<void>> ObjectList;
+
+struct Reaper::Data
+{
+    Data();
+    ~Data();
+
+    std::mutex              mutex;         /* Guard for objects, pending and looping. */
+    std::condition_variable cond;          /* Signaled when objects are queued. */
+    std::condition_variable idle_cond;     /* Signaled when pending drops to zero. */
+    ObjectList              objects;       /* Objects to release. */
+    size_t                  pending;       /* Objects queued or being released. */
+    bool                    looping;       /* Looping flag. */
+    std::thread*            reaper_thread; /* Reaper thread. */
+};
+
+static void ReaperThread(Reaper::Data* data)
+{
+    std::unique_lock<std::mutex> lock(data->mutex);
+    for (;;)
+    {
+        data->cond.wait(lock, [data] { return !data->looping || !data->objects.empty(); });
+        if (data->objects.empty())
+        {
+            break;
+        }
+
+        /* Release outside the lock, so the caller is never blocked by a destructor. */
+        ObjectList objects;
+        objects.swap(data->objects);
+        lock.unlock();
+        const size_t count = objects.size();
+        objects.clear();
+        lock.lock();
+
+        data->pending -= count;
+        if (data->pending == 0)
+        {
+            data->idle_cond.notify_all();
+        }
+    }
+}
+
+Reaper::Data::Data()
+{
+    pending = 0;
+    looping = true;
+    reaper_thread = new std::thread(ReaperThread, this);
+}
+
+Reaper::Data::~Data()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        looping = false;
+    }
+    cond.notify_one();
+
+    /* Queued objects are still released before the thread exits. */
+    reaper_thread->join();
+    delete reaper_thread;
+}
+
+Reaper::Reaper()
+{
+    m_data = new Data;
+}
+
+Reaper::~Reaper()
+{
+    delete m_data;
+}
+
+void Reaper::Dispose(std::shared_ptr<void> obj)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_data->mutex);
+        m_data->objects.push_back(std::move(obj));
+        m_data->pending++;
+    }
+    m_data->cond.notify_one();
+}
+
+void Reaper::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_data->mutex);
+    m_data->idle_cond.wait(lock, [this] { return m_data->pending == 0; });
+}
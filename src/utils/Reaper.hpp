@@ -0,0 +1,37 @@
+#ifndef LAUNCHR_UTILS_REAPER_HPP
+#define LAUNCHR_UTILS_REAPER_HPP
+
+#include <memory>
+
+namespace LR
+{
+
+/**
+ * @brief Destroy objects on a background thread.
+ *
+ * Objects whose destructor joins threads are handed over here, so the caller
+ * never waits for them.
+ */
+struct Reaper
+{
+    Reaper();
+    ~Reaper();
+
+    /**
+     * @brief Release the reference on the reaper thread.
+     * @param[in] obj Object to release.
+     */
+    void Dispose(std::shared_ptr<void> obj);
+
+    /**
+     * @brief Wait until all disposed objects are released.
+     */
+    void Flush();
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
@@ -0,0 +1,1691 @@
+#include <wx/wx.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include "SubstringSearch.hpp"
+#include "Regex.hpp"
+
+using namespace LR;
+
+/* Highest Unicode code point. */
+static const uint32_t MaxCodePoint = 0x10FFFF;
+
+/* Groups nested deeper are rejected, so recursion stays bounded. */
+static const int MaxNesting = 128;
+
+/* Largest count of a bounded repeat. */
+static const int MaxRepeat = 1000;
+
+/* Repeats are expanded into copies, automata with more states are rejected. */
+static const size_t MaxNfaStates = 50000;
+
+/* DFAs with more states are not built, the NFA is simulated instead. */
+static const size_t MaxDfaStates = 2000;
+
+/* Case variants of non-ASCII code points are added for ranges up to this size. */
+static const uint32_t MaxFoldRange = 512;
+
+/* Set in a DFA transition when a match ends before its byte is consumed. */
+static const uint32_t DfaMatchBit = 0x80000000;
+
+/* Context of one side of a position, the assertions depend only on it. */
+enum Context : uint8_t
+{
+    ContextBreak = 0,   /* Line feed or edge of the content. */
+    ContextWord = 1,    /* ASCII letter, digit or underscore. */
+    ContextOther = 2,   /* Anything else. */
+    ContextInside = 3,  /* UTF-8 continuation byte, the position is inside a code point. */
+    ContextUnknown = 4, /* Cut edge of the data, no assertion holds there. */
+    ContextReturn = 5,  /* Carriage return, a line ends before it in CRLF content. */
+    ContextCount = 6,
+};
+
+enum class AssertKind : uint8_t
+{
+    LineStart,
+    LineEnd,
+    WordBoundary,
+    NotWordBoundary,
+};
+
+enum class NodeKind : uint8_t
+{
+    Empty,
+    Class,
+    Concat,
+    Alternate,
+    Repeat,
+    Assert,
+};
+
+struct CodeRange
+{
+    uint32_t lo; /* First code point. */
+    uint32_t hi; /* Last code point, inclusive. */
+};
+
+typedef std::vector<CodeRange> CodeRangeVec;
+
+struct RegexNode
+{
+    NodeKind               kind = NodeKind::Empty;
+    CodeRangeVec           ranges;                       /* Code points of Class, sorted and merged. */
+    std::vector<RegexNode> children;                     /* Items of Concat and Alternate, the repeated node. */
+    int                    min = 0;                      /* Min count of Repeat. */
+    int                    max = 0;                      /* Max count of Repeat, -1 for no limit. */
+    AssertKind             assertion = AssertKind::LineStart; /* Condition of Assert. */
+};
+
+struct RegexParser
+{
+    std::u32string pattern;             /* Pattern code points. */
+    size_t         pos = 0;             /* Parse position. */
+    bool           ignore_case = false; /* Classes get case variants. */
+    std::string    error;               /* Why parsing failed. */
+};
+
+enum class NfaKind : uint8_t
+{
+    Byte,   /* Consume a byte of the set. */
+    Split,  /* Go on to both next states. */
+    Assert, /* Go on if the condition holds. */
+    Match,  /* Match found. */
+};
+
+struct NfaState
+{
+    NfaKind    kind = NfaKind::Match;
+    AssertKind assertion = AssertKind::LineStart; /* Condition of Assert. */
+    uint32_t   set = 0;                           /* Byte set index of Byte. */
+    uint32_t   out = 0;                           /* Next state. */
+    uint32_t   out1 = 0;                          /* Second next state of Split. */
+};
+
+struct ByteSet
+{
+    std::array<uint64_t, 4> bits = {};
+
+    void Add(uint8_t lo, uint8_t hi)
+    {
+        for (unsigned c = lo; c <= hi; c++)
+        {
+            bits[c >> 6] |= static_cast<uint64_t>(1) << (c & 63);
+        }
+    }
+
+    bool Has(uint8_t c) const
+    {
+        return (bits[c >> 6] >> (c & 63)) & 1;
+    }
+};
+
+struct Automaton
+{
+    std::vector<NfaState> states;             /* NFA states. */
+    std::vector<ByteSet>  sets;               /* Byte sets of Byte states. */
+    uint32_t              start = 0;          /* NFA start state. */
+    bool                  reverse = false;    /* Runs from the end of a match to its start. */
+    bool                  unanchored = false; /* Start state is entered again after every byte. */
+
+    bool                  has_dfa = false;     /* DFA is built, otherwise the NFA is simulated. */
+    uint8_t               byte_class[256];     /* Equivalence class of each byte. */
+    size_t                class_count = 0;     /* Number of byte classes. */
+    std::vector<uint32_t> next;                /* Next DFA state by state and byte class, states are row offsets. */
+    std::vector<uint8_t>  match;               /* Match flag by DFA state and context of the next byte. */
+    uint32_t              dfa_start[ContextCount]; /* Start state by context before the first byte. */
+    uint32_t              dead = UINT32_MAX;   /* DFA state that never matches. */
+};
+
+struct NfaScratch
+{
+    std::vector<uint32_t> stack;     /* States to visit. */
+    std::vector<uint32_t> mark;      /* Stamp of the last closure that visited each state. */
+    uint32_t              stamp = 0; /* Stamp of the current closure. */
+
+    explicit NfaScratch(size_t count)
+        : mark(count, 0)
+    {
+    }
+};
+
+struct Regex::Data
+{
+    std::string              error;             /* Why the pattern did not compile. */
+    Automaton                forward;           /* Finds where matches end. */
+    Automaton                reverse;           /* Finds where a match starts from its end. */
+    std::vector<std::string> literals;          /* Fragments every match contains. */
+    SubstringSearch*         prefilter = nullptr; /* Search for the longest literal. */
+    bool                     line_mode = false; /* No match spans a line feed. */
+    size_t                   min_length = 0;    /* Shortest match. */
+    size_t                   max_length = 0;    /* Longest match, SIZE_MAX if unbounded. */
+};
+
+static uint8_t GetContext(uint8_t c)
+{
+    if (c == '\n')
+    {
+        return ContextBreak;
+    }
+    if (c == '\r')
+    {
+        return ContextReturn;
+    }
+    if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_')
+    {
+        return ContextWord;
+    }
+    return (c & 0xC0) == 0x80 ? ContextInside : ContextOther;
+}
+
+static uint8_t GetContextBefore(const uint8_t* text, size_t pos, unsigned cut)
+{
+    if (pos > 0)
+    {
+        return GetContext(text[pos - 1]);
+    }
+    return (cut & Regex::CutStart) != 0 ? ContextUnknown : ContextBreak;
+}
+
+static uint8_t GetContextAfter(const uint8_t* text, size_t size, size_t pos, unsigned cut)
+{
+    if (pos < size)
+    {
+        return GetContext(text[pos]);
+    }
+    return (cut & Regex::CutEnd) != 0 ? ContextUnknown : ContextBreak;
+}
+
+static bool CheckAssert(AssertKind kind, uint8_t left, uint8_t right)
+{
+    /* Assertions only hold between code points, and where both sides are known. */
+    if (right == ContextInside || left == ContextUnknown || right == ContextUnknown)
+    {
+        return false;
+    }
+    switch (kind)
+    {
+    case AssertKind::LineStart:
+        return left == ContextBreak;
+    case AssertKind::LineEnd:
+        return right == ContextBreak || right == ContextReturn;
+    case AssertKind::WordBoundary:
+        return (left == ContextWord) != (right == ContextWord);
+    case AssertKind::NotWordBoundary:
+        return (left == ContextWord) == (right == ContextWord);
+    }
+    return false;
+}
+
+static size_t AddLength(size_t a, size_t b)
+{
+    return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+}
+
+static size_t MulLength(size_t a, size_t n)
+{
+    if (a == 0 || n == 0)
+    {
+        return 0;
+    }
+    return a > SIZE_MAX / n ? SIZE_MAX : a * n;
+}
+
+static size_t Utf8Length(uint32_t cp)
+{
+    return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+static void EncodeUtf8(uint32_t cp, std::string* out)
+{
+    if (cp < 0x80)
+    {
+        out->push_back(static_cast<char>(cp));
+    }
+    else if (cp < 0x800)
+    {
+        out->push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else if (cp < 0x10000)
+    {
+        out->push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else
+    {
+        out->push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+static bool DecodeUtf8(const std::string& text, std::u32string* out)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(text.data());
+    const size_t   size = text.size();
+    for (size_t i = 0; i < size;)
+    {
+        const uint8_t c = p[i];
+        size_t        count = 0;
+        uint32_t      cp = 0;
+        if (c < 0x80)
+        {
+            cp = c;
+        }
+        else if ((c & 0xE0) == 0xC0)
+        {
+            count = 1;
+            cp = c & 0x1F;
+        }
+        else if ((c & 0xF0) == 0xE0)
+        {
+            count = 2;
+            cp = c & 0x0F;
+        }
+        else if ((c & 0xF8) == 0xF0)
+        {
+            count = 3;
+            cp = c & 0x07;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (i + count >= size)
+        {
+            return false;
+        }
+        for (size_t k = 1; k <= count; k++)
+        {
+            if ((p[i + k] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+            cp = (cp << 6) | (p[i + k] & 0x3F);
+        }
+        if (cp > MaxCodePoint || (cp >= 0xD800 && cp <= 0xDFFF) || Utf8Length(cp) != count + 1)
+        {
+            return false;
+        }
+        out->push_back(cp);
+        i += count + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Sort ranges and merge the overlapping or adjacent ones.
+ */
+static void NormalizeRanges(CodeRangeVec* ranges)
+{
+    std::sort(ranges->begin(), ranges->end(),
+              [](const CodeRange& a, const CodeRange& b) { return a.lo < b.lo; });
+
+    CodeRangeVec merged;
+    for (const CodeRange& range : *ranges)
+    {
+        if (!merged.empty() && range.lo <= static_cast<uint64_t>(merged.back().hi) + 1)
+        {
+            merged.back().hi = std::max(merged.back().hi, range.hi);
+        }
+        else
+        {
+            merged.push_back(range);
+        }
+    }
+    ranges->swap(merged);
+}
+
+/**
+ * @brief Get the code points not in the ranges.
+ * @param[in] ranges Normalized ranges.
+ */
+static CodeRangeVec ComplementRanges(const CodeRangeVec& ranges)
+{
+    CodeRangeVec result;
+    uint32_t     next = 0;
+    for (const CodeRange& range : ranges)
+    {
+        if (range.lo > next)
+        {
+            result.push_back({ next, range.lo - 1 });
+        }
+        next = range.hi + 1;
+    }
+    if (next <= MaxCodePoint)
+    {
+        result.push_back({ next, MaxCodePoint });
+    }
+    return result;
+}
+
+static uint32_t ChangeCase(uint32_t cp, bool upper)
+{
+    std::string bytes;
+    EncodeUtf8(cp, &bytes);
+    const wxString text = wxString::FromUTF8(bytes.data(), bytes.size());
+    const wxString changed = upper ? text.Upper() : text.Lower();
+    return changed.length() == 1 ? static_cast<uint32_t>(changed[0].GetValue()) : cp;
+}
+
+/**
+ * @brief Add the other case of every letter in the ranges.
+ */
+static void FoldRanges(CodeRangeVec* ranges)
+{
+    CodeRangeVec variants;
+    for (const CodeRange& range : *ranges)
+    {
+        const uint32_t lo = std::max<uint32_t>(range.lo, 'A');
+        const uint32_t hi = std::min<uint32_t>(range.hi, 'z');
+        for (uint32_t c = lo; c <= hi; c++)
+        {
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+            {
+                variants.push_back({ c ^ 0x20, c ^ 0x20 });
+            }
+        }
+
+        /* Large ranges are mostly made of whole scripts, which already hold both cases. */
+        const uint32_t wide = std::max<uint32_t>(range.lo, 0x80);
+        if (range.hi < wide || range.hi - wide >= MaxFoldRange)
+        {
+            continue;
+        }
+        for (uint32_t c = wide; c <= range.hi; c++)
+        {
+            for (const uint32_t other : { ChangeCase(c, false), ChangeCase(c, true) })
+            {
+                if (other != c)
+                {
+                    variants.push_back({ other, other });
+                }
+            }
+        }
+    }
+    ranges->insert(ranges->end(), variants.begin(), variants.end());
+    NormalizeRanges(ranges);
+}
+
+static void MakeClass(const RegexParser& parser, CodeRangeVec ranges, bool negate, RegexNode* node)
+{
+    NormalizeRanges(&ranges);
+    if (parser.ignore_case)
+    {
+        FoldRanges(&ranges);
+    }
+    node->kind = NodeKind::Class;
+    node->ranges = negate ? ComplementRanges(ranges) : std::move(ranges);
+}
+
+static bool ParseAlternate(RegexParser& parser, RegexNode* node, int depth);
+
+static bool AtEnd(const RegexParser& parser)
+{
+    return parser.pos >= parser.pattern.size();
+}
+
+static bool Accept(RegexParser& parser, char32_t c)
+{
+    if (!AtEnd(parser) && parser.pattern[parser.pos] == c)
+    {
+        parser.pos++;
+        return true;
+    }
+    return false;
+}
+
+static bool Fail(RegexParser& parser, const std::string& error)
+{
+    parser.error = error;
+    return false;
+}
+
+static bool ParseHex(RegexParser& parser, size_t digits, bool braced, uint32_t* value)
+{
+    *value = 0;
+    size_t count = 0;
+    while (!AtEnd(parser) && (braced || count < digits))
+    {
+        const char32_t c = parser.pattern[parser.pos];
+        uint32_t       digit = 0;
+        if (c >= '0' && c <= '9')
+        {
+            digit = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            digit = c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            digit = c - 'A' + 10;
+        }
+        else
+        {
+            break;
+        }
+        *value = (*value << 4) | digit;
+        parser.pos++;
+        if (++count > 6)
+        {
+            return Fail(parser, "Invalid hex escape");
+        }
+    }
+    if (count == 0 || (!braced && count != digits) || (braced && !Accept(parser, '}')) || *value > MaxCodePoint)
+    {
+        return Fail(parser, "Invalid hex escape");
+    }
+    return true;
+}
+
+/**
+ * @brief Parse an escape after its backslash into the code points it matches.
+ */
+static bool ParseEscape(RegexParser& parser, CodeRangeVec* ranges)
+{
+    static const CodeRangeVec Digits = { { '0', '9' } };
+    static const CodeRangeVec Words = { { '0', '9' }, { 'A', 'Z' }, { '_', '_' }, { 'a', 'z' } };
+    static const CodeRangeVec Spaces = { { '\t', '\r' }, { ' ', ' ' } };
+
+    if (AtEnd(parser))
+    {
+        return Fail(parser, "Trailing backslash");
+    }
+
+    const char32_t c = parser.pattern[parser.pos++];
+    uint32_t       cp = c;
+    switch (c)
+    {
+    case 'd':
+        ranges->insert(ranges->end(), Digits.begin(), Digits.end());
+        return true;
+    case 'w':
+        ranges->insert(ranges->end(), Words.begin(), Words.end());
+        return true;
+    case 's':
+        ranges->insert(ranges->end(), Spaces.begin(), Spaces.end());
+        return true;
+    case 'D':
+    case 'W':
+    case 'S': {
+        const CodeRangeVec others = ComplementRanges(c == 'D' ? Digits : c == 'W' ? Words : Spaces);
+        ranges->insert(ranges->end(), others.begin(), others.end());
+        return true;
+    }
+    case 't':
+        cp = '\t';
+        break;
+    case 'n':
+        cp = '\n';
+        break;
+    case 'r':
+        cp = '\r';
+        break;
+    case 'f':
+        cp = '\f';
+        break;
+    case 'v':
+        cp = '\v';
+        break;
+    case 'x':
+        if (!ParseHex(parser, 2, Accept(parser, '{'), &cp))
+        {
+            return false;
+        }
+        break;
+    default:
+        if (c >= '1' && c <= '9')
+        {
+            return Fail(parser, "Backreferences are not supported");
+        }
+        if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+        {
+            return Fail(parser, std::string("Unsupported escape \\") + static_cast<char>(c));
+        }
+        break;
+    }
+    ranges->push_back({ cp, cp });
+    return true;
+}
+
+/**
+ * @brief Parse a bracketed class after its opening bracket.
+ */
+static bool ParseClass(RegexParser& parser, RegexNode* node)
+{
+    const bool   negate = Accept(parser, '^');
+    CodeRangeVec ranges;
+    for (bool first = true;; first = false)
+    {
+        if (AtEnd(parser))
+        {
+            return Fail(parser, "Missing ]");
+        }
+
+        char32_t c = parser.pattern[parser.pos++];
+        if (c == ']' && !first)
+        {
+            break;
+        }
+
+        uint32_t lo = c;
+        if (c == '\\')
+        {
+            CodeRangeVec escaped;
+            if (!ParseEscape(parser, &escaped))
+            {
+                return false;
+            }
+            if (escaped.size() != 1 || escaped[0].lo != escaped[0].hi)
+            {
+                ranges.insert(ranges.end(), escaped.begin(), escaped.end());
+                continue;
+            }
+            lo = escaped[0].lo;
+        }
+
+        uint32_t hi = lo;
+        if (parser.pos + 1 < parser.pattern.size() && parser.pattern[parser.pos] == '-' &&
+            parser.pattern[parser.pos + 1] != ']')
+        {
+            parser.pos++;
+            c = parser.pattern[parser.pos++];
+            hi = c;
+            if (c == '\\')
+            {
+                CodeRangeVec escaped;
+                if (!ParseEscape(parser, &escaped))
+                {
+                    return false;
+                }
+                if (escaped.size() != 1 || escaped[0].lo != escaped[0].hi)
+                {
+                    return Fail(parser, "Invalid class range");
+                }
+                hi = escaped[0].lo;
+            }
+            if (hi < lo)
+            {
+                return Fail(parser, "Invalid class range");
+            }
+        }
+        ranges.push_back({ lo, hi });
+    }
+
+    MakeClass(parser, std::move(ranges), negate, node);
+    return true;
+}
+
+static bool ParseAtom(RegexParser& parser, RegexNode* node, int depth)
+{
+    const char32_t c = parser.pattern[parser.pos++];
+    switch (c)
+    {
+    case '(':
+        if (depth >= MaxNesting)
+        {
+            return Fail(parser, "Groups are nested too deep");
+        }
+        if (Accept(parser, '?') && !Accept(parser, ':'))
+        {
+            return Fail(parser, "Lookaround and group flags are not supported");
+        }
+        if (!ParseAlternate(parser, node, depth + 1))
+        {
+            return false;
+        }
+        if (!Accept(parser, ')'))
+        {
+            return Fail(parser, "Missing )");
+        }
+        return true;
+    case '[':
+        return ParseClass(parser, node);
+    case '.':
+        node->kind = NodeKind::Class;
+        node->ranges = ComplementRanges({ { '\n', '\n' } });
+        return true;
+    case '^':
+    case '$':
+        node->kind = NodeKind::Assert;
+        node->assertion = c == '^' ? AssertKind::LineStart : AssertKind::LineEnd;
+        return true;
+    case '*':
+    case '+':
+    case '?':
+        return Fail(parser, "Nothing to repeat");
+    case '\\':
+        if (Accept(parser, 'b') || Accept(parser, 'B'))
+        {
+            node->kind = NodeKind::Assert;
+            node->assertion =
+                parser.pattern[parser.pos - 1] == 'b' ? AssertKind::WordBoundary : AssertKind::NotWordBoundary;
+            return true;
+        }
+        else
+        {
+            CodeRangeVec ranges;
+            if (!ParseEscape(parser, &ranges))
+            {
+                return false;
+            }
+            MakeClass(parser, std::move(ranges), false, node);
+            return true;
+        }
+    default:
+        MakeClass(parser, { { c, c } }, false, node);
+        return true;
+    }
+}
+
+static bool ParseCount(RegexParser& parser, int* count)
+{
+    *count = 0;
+    size_t digits = 0;
+    while (!AtEnd(parser) && parser.pattern[parser.pos] >= '0' && parser.pattern[parser.pos] <= '9')
+    {
+        *count = std::min(*count * 10 + static_cast<int>(parser.pattern[parser.pos] - '0'), MaxRepeat + 1);
+        parser.pos++;
+        digits++;
+    }
+    return digits != 0;
+}
+
+/**
+ * @brief Parse the quantifier after an atom, if any.
+ */
+static bool ParseQuantifier(RegexParser& parser, RegexNode* node)
+{
+    int min = 0;
+    int max = -1;
+    if (Accept(parser, '*'))
+    {
+    }
+    else if (Accept(parser, '+'))
+    {
+        min = 1;
+    }
+    else if (Accept(parser, '?'))
+    {
+        max = 1;
+    }
+    else if (Accept(parser, '{'))
+    {
+        /* Braces that do not form a count are literal. */
+        const size_t start = parser.pos;
+        bool         valid = ParseCount(parser, &min);
+        if (Accept(parser, ','))
+        {
+            if (ParseCount(parser, &max))
+            {
+                valid = true;
+            }
+            else
+            {
+                max = -1;
+            }
+        }
+        else
+        {
+            max = min;
+        }
+        if (!valid || !Accept(parser, '}'))
+        {
+            parser.pos = start - 1;
+            return true;
+        }
+        if (min > MaxRepeat || max > MaxRepeat)
+        {
+            return Fail(parser, "Repeat count is too large");
+        }
+        if (max >= 0 && max < min)
+        {
+            return Fail(parser, "Invalid repeat count");
+        }
+    }
+    else
+    {
+        return true;
+    }
+
+    /* Laziness only changes which match a backtracking engine reports first. */
+    Accept(parser, '?');
+
+    RegexNode repeat;
+    repeat.kind = NodeKind::Repeat;
+    repeat.min = min;
+    repeat.max = max;
+    repeat.children.push_back(std::move(*node));
+    *node = std::move(repeat);
+    return true;
+}
+
+static bool ParseConcat(RegexParser& parser, RegexNode* node, int depth)
+{
+    node->kind = NodeKind::Concat;
+    while (!AtEnd(parser) && parser.pattern[parser.pos] != '|' && parser.pattern[parser.pos] != ')')
+    {
+        RegexNode atom;
+        if (!ParseAtom(parser, &atom, depth) || !ParseQuantifier(parser, &atom))
+        {
+            return false;
+        }
+        node->children.push_back(std::move(atom));
+    }
+    if (node->children.size() == 1)
+    {
+        RegexNode child = std::move(node->children[0]);
+        *node = std::move(child);
+    }
+    return true;
+}
+
+static bool ParseAlternate(RegexParser& parser, RegexNode* node, int depth)
+{
+    node->kind = NodeKind::Alternate;
+    do
+    {
+        RegexNode branch;
+        if (!ParseConcat(parser, &branch, depth))
+        {
+            return false;
+        }
+        node->children.push_back(std::move(branch));
+    } while (Accept(parser, '|'));
+
+    if (node->children.size() == 1)
+    {
+        RegexNode child = std::move(node->children[0]);
+        *node = std::move(child);
+    }
+    return true;
+}
+
+/**
+ * @brief Get the bytes of a class matching one fixed string, ASCII letters lowercase if case is ignored.
+ */
+static bool GetClassLiteral(const RegexNode& node, bool ignore_case, std::string* bytes)
+{
+    const CodeRangeVec& ranges = node.ranges;
+    if (ranges.size() == 1 && ranges[0].lo == ranges[0].hi)
+    {
+        EncodeUtf8(ranges[0].lo, bytes);
+        return true;
+    }
+    if (ignore_case && ranges.size() == 2 && ranges[0].lo == ranges[0].hi && ranges[1].lo == ranges[1].hi &&
+        ranges[0].lo >= 'A' && ranges[0].lo <= 'Z' && ranges[1].lo == (ranges[0].lo | 0x20))
+    {
+        bytes->push_back(static_cast<char>(ranges[1].lo));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Collect runs of fixed strings every match of the node contains.
+ */
+static void CollectLiterals(const RegexNode& node, bool ignore_case, std::vector<std::string>* literals)
+{
+    std::string run;
+    switch (node.kind)
+    {
+    case NodeKind::Class:
+        if (GetClassLiteral(node, ignore_case, &run))
+        {
+            literals->push_back(run);
+        }
+        break;
+    case NodeKind::Concat:
+        for (const RegexNode& child : node.children)
+        {
+            /* Assertions consume nothing, the strings around them are adjacent. */
+            if (child.kind == NodeKind::Assert ||
+                (child.kind == NodeKind::Class && GetClassLiteral(child, ignore_case, &run)))
+            {
+                continue;
+            }
+            if (!run.empty())
+            {
+                literals->push_back(run);
+                run.clear();
+            }
+            CollectLiterals(child, ignore_case, literals);
+        }
+        if (!run.empty())
+        {
+            literals->push_back(run);
+        }
+        break;
+    case NodeKind::Repeat:
+        if (node.min > 0)
+        {
+            CollectLiterals(node.children[0], ignore_case, literals);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void GetLengths(const RegexNode& node, size_t* min, size_t* max)
+{
+    *min = 0;
+    *max = 0;
+    switch (node.kind)
+    {
+    case NodeKind::Class:
+        if (!node.ranges.empty())
+        {
+            *min = Utf8Length(node.ranges.front().lo);
+            *max = Utf8Length(node.ranges.back().hi);
+        }
+        break;
+    case NodeKind::Concat:
+        for (const RegexNode& child : node.children)
+        {
+            size_t child_min = 0;
+            size_t child_max = 0;
+            GetLengths(child, &child_min, &child_max);
+            *min = AddLength(*min, child_min);
+            *max = AddLength(*max, child_max);
+        }
+        break;
+    case NodeKind::Alternate:
+        *min = SIZE_MAX;
+        for (const RegexNode& child : node.children)
+        {
+            size_t child_min = 0;
+            size_t child_max = 0;
+            GetLengths(child, &child_min, &child_max);
+            *min = std::min(*min, child_min);
+            *max = std::max(*max, child_max);
+        }
+        break;
+    case NodeKind::Repeat: {
+        size_t child_min = 0;
+        size_t child_max = 0;
+        GetLengths(node.children[0], &child_min, &child_max);
+        *min = MulLength(child_min, node.min);
+        *max = node.max < 0 ? (child_max == 0 ? 0 : SIZE_MAX) : MulLength(child_max, node.max);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static bool MatchesNewline(const RegexNode& node)
+{
+    if (node.kind == NodeKind::Class)
+    {
+        for (const CodeRange& range : node.ranges)
+        {
+            if (range.lo <= '\n' && range.hi >= '\n')
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    for (const RegexNode& child : node.children)
+    {
+        if (MatchesNewline(child))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t AddState(Automaton* automaton, NfaKind kind, uint32_t out, uint32_t out1 = 0)
+{
+    NfaState state;
+    state.kind = kind;
+    state.out = out;
+    state.out1 = out1;
+    automaton->states.push_back(state);
+    return static_cast<uint32_t>(automaton->states.size() - 1);
+}
+
+static uint32_t AddByteState(Automaton* automaton, const ByteSet& set, uint32_t out)
+{
+    size_t index = 0;
+    while (index < automaton->sets.size() && automaton->sets[index].bits != set.bits)
+    {
+        index++;
+    }
+    if (index == automaton->sets.size())
+    {
+        automaton->sets.push_back(set);
+    }
+
+    const uint32_t state = AddState(automaton, NfaKind::Byte, out);
+    automaton->states[state].set = static_cast<uint32_t>(index);
+    return state;
+}
+
+static uint32_t AddAlternatives(Automaton* automaton, const std::vector<uint32_t>& starts)
+{
+    uint32_t state = starts.back();
+    for (size_t i = starts.size() - 1; i > 0; i--)
+    {
+        state = AddState(automaton, NfaKind::Split, starts[i - 1], state);
+    }
+    return state;
+}
+
+/**
+ * @brief Split a code point range into ranges whose UTF-8 forms are byte range sequences.
+ * @param[out] sequences Byte ranges of each sequence, as (lo, hi) pairs.
+ */
+static void SplitUtf8Range(uint32_t lo, uint32_t hi, std::vector<std::vector<std::pair<uint8_t, uint8_t>>>* sequences)
+{
+    std::vector<CodeRange> pending = { { lo, hi } };
+    while (!pending.empty())
+    {
+        CodeRange range = pending.back();
+        pending.pop_back();
+
+        /* Surrogates have no UTF-8 form. */
+        if (range.lo <= 0xDFFF && range.hi >= 0xD800)
+        {
+            if (range.lo < 0xD800)
+            {
+                pending.push_back({ range.lo, 0xD7FF });
+            }
+            if (range.hi > 0xDFFF)
+            {
+                pending.push_back({ 0xE000, range.hi });
+            }
+            continue;
+        }
+
+        /* Split where the encoded length changes. */
+        bool split = false;
+        for (const uint32_t last : { 0x7Fu, 0x7FFu, 0xFFFFu })
+        {
+            if (range.lo <= last && range.hi > last)
+            {
+                pending.push_back({ range.lo, last });
+                pending.push_back({ last + 1, range.hi });
+                split = true;
+                break;
+            }
+        }
+
+        /* Split until every continuation byte spans its full range or a single prefix. */
+        for (uint32_t bytes = 1; bytes < 4 && !split; bytes++)
+        {
+            const uint32_t mask = (static_cast<uint32_t>(1) << (6 * bytes)) - 1;
+            if ((range.lo & ~mask) == (range.hi & ~mask))
+            {
+                continue;
+            }
+            if ((range.lo & mask) != 0)
+            {
+                pending.push_back({ (range.lo | mask) + 1, range.hi });
+                pending.push_back({ range.lo, range.lo | mask });
+                split = true;
+            }
+            else if ((range.hi & mask) != mask)
+            {
+                pending.push_back({ range.hi & ~mask, range.hi });
+                pending.push_back({ range.lo, (range.hi & ~mask) - 1 });
+                split = true;
+            }
+        }
+        if (split)
+        {
+            continue;
+        }
+
+        std::string first;
+        std::string last;
+        EncodeUtf8(range.lo, &first);
+        EncodeUtf8(range.hi, &last);
+        std::vector<std::pair<uint8_t, uint8_t>> sequence;
+        for (size_t i = 0; i < first.size(); i++)
+        {
+            sequence.emplace_back(static_cast<uint8_t>(first[i]), static_cast<uint8_t>(last[i]));
+        }
+        sequences->push_back(std::move(sequence));
+    }
+}
+
+static uint32_t CompileClass(Automaton* automaton, const CodeRangeVec& ranges, uint32_t next)
+{
+    std::vector<std::vector<std::pair<uint8_t, uint8_t>>> sequences;
+    for (const CodeRange& range : ranges)
+    {
+        SplitUtf8Range(range.lo, range.hi, &sequences);
+    }
+
+    /* Single bytes share one state, longer sequences get a chain each. */
+    ByteSet               single;
+    bool                  has_single = false;
+    std::vector<uint32_t> starts;
+    for (const std::vector<std::pair<uint8_t, uint8_t>>& sequence : sequences)
+    {
+        if (sequence.size() == 1)
+        {
+            single.Add(sequence[0].first, sequence[0].second);
+            has_single = true;
+            continue;
+        }
+
+        uint32_t state = next;
+        for (size_t i = 0; i < sequence.size(); i++)
+        {
+            const std::pair<uint8_t, uint8_t>& bytes =
+                automaton->reverse ? sequence[i] : sequence[sequence.size() - 1 - i];
+            ByteSet set;
+            set.Add(bytes.first, bytes.second);
+            state = AddByteState(automaton, set, state);
+        }
+        starts.push_back(state);
+    }
+    if (has_single || starts.empty())
+    {
+        /* An empty class gets a state with no bytes, it never matches. */
+        starts.push_back(AddByteState(automaton, single, next));
+    }
+    return AddAlternatives(automaton, starts);
+}
+
+/**
+ * @brief Compile a node into states leading to next.
+ * @return Entry state of the node.
+ */
+static uint32_t CompileNode(Automaton* automaton, const RegexNode& node, uint32_t next)
+{
+    if (automaton->states.size() > MaxNfaStates)
+    {
+        return next;
+    }
+
+    switch (node.kind)
+    {
+    case NodeKind::Class:
+        return CompileClass(automaton, node.ranges, next);
+    case NodeKind::Concat: {
+        /* States are built from the end, which is the start for the reverse automaton. */
+        uint32_t state = next;
+        if (automaton->reverse)
+        {
+            for (const RegexNode& child : node.children)
+            {
+                state = CompileNode(automaton, child, state);
+            }
+        }
+        else
+        {
+            for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+            {
+                state = CompileNode(automaton, *it, state);
+            }
+        }
+        return state;
+    }
+    case NodeKind::Alternate: {
+        std::vector<uint32_t> starts;
+        for (const RegexNode& child : node.children)
+        {
+            starts.push_back(CompileNode(automaton, child, next));
+        }
+        return AddAlternatives(automaton, starts);
+    }
+    case NodeKind::Repeat: {
+        const RegexNode& child = node.children[0];
+        uint32_t         state = next;
+        if (node.max < 0)
+        {
+            const uint32_t loop = AddState(automaton, NfaKind::Split, 0, next);
+            automaton->states[loop].out = CompileNode(automaton, child, loop);
+            state = loop;
+        }
+        for (int i = node.min; i < node.max && automaton->states.size() <= MaxNfaStates; i++)
+        {
+            state = AddState(automaton, NfaKind::Split, CompileNode(automaton, child, state), next);
+        }
+        for (int i = 0; i < node.min && automaton->states.size() <= MaxNfaStates; i++)
+        {
+            state = CompileNode(automaton, child, state);
+        }
+        return state;
+    }
+    case NodeKind::Assert: {
+        const uint32_t state = AddState(automaton, NfaKind::Assert, next);
+        automaton->states[state].assertion = node.assertion;
+        return state;
+    }
+    default:
+        return next;
+    }
+}
+
+/**
+ * @brief Follow the empty transitions from the kernel states.
+ * @param[in] left Context before the position.
+ * @param[in] right Context after the position.
+ * @param[out] bytes Byte states reached.
+ * @return true if the match state is reached.
+ */
+static bool Closure(const Automaton& automaton, const std::vector<uint32_t>& kernel, uint8_t left, uint8_t right,
+                    NfaScratch& scratch, std::vector<uint32_t>* bytes)
+{
+    if (++scratch.stamp == 0)
+    {
+        std::fill(scratch.mark.begin(), scratch.mark.end(), 0);
+        scratch.stamp = 1;
+    }
+
+    bool matched = false;
+    bytes->clear();
+    scratch.stack.assign(kernel.begin(), kernel.end());
+    while (!scratch.stack.empty())
+    {
+        const uint32_t id = scratch.stack.back();
+        scratch.stack.pop_back();
+        if (scratch.mark[id] == scratch.stamp)
+        {
+            continue;
+        }
+        scratch.mark[id] = scratch.stamp;
+
+        const NfaState& state = automaton.states[id];
+        switch (state.kind)
+        {
+        case NfaKind::Byte:
+            bytes->push_back(id);
+            break;
+        case NfaKind::Split:
+            scratch.stack.push_back(state.out1);
+            scratch.stack.push_back(state.out);
+            break;
+        case NfaKind::Assert:
+            if (CheckAssert(state.assertion, left, right))
+            {
+                scratch.stack.push_back(state.out);
+            }
+            break;
+        case NfaKind::Match:
+            matched = true;
+            break;
+        }
+    }
+    return matched;
+}
+
+static void Step(const Automaton& automaton, const std::vector<uint32_t>& bytes, uint8_t c,
+                 std::vector<uint32_t>* kernel)
+{
+    kernel->clear();
+    for (const uint32_t id : bytes)
+    {
+        const NfaState& state = automaton.states[id];
+        if (automaton.sets[state.set].Has(c))
+        {
+            kernel->push_back(state.out);
+        }
+    }
+    if (automaton.unanchored)
+    {
+        kernel->push_back(automaton.start);
+    }
+}
+
+/**
+ * @brief Group bytes no byte set or context tells apart.
+ * @param[out] representatives First byte of every class.
+ */
+static void ComputeByteClasses(Automaton* automaton, std::vector<uint8_t>* representatives)
+{
+    bool boundary[256] = { true };
+    for (unsigned c = 1; c < 256; c++)
+    {
+        boundary[c] = GetContext(static_cast<uint8_t>(c)) != GetContext(static_cast<uint8_t>(c - 1));
+        for (const ByteSet& set : automaton->sets)
+        {
+            boundary[c] = boundary[c] || set.Has(static_cast<uint8_t>(c)) != set.Has(static_cast<uint8_t>(c - 1));
+        }
+    }
+
+    size_t count = 0;
+    for (unsigned c = 0; c < 256; c++)
+    {
+        if (boundary[c])
+        {
+            representatives->push_back(static_cast<uint8_t>(c));
+            count++;
+        }
+        automaton->byte_class[c] = static_cast<uint8_t>(count - 1);
+    }
+    automaton->class_count = count;
+}
+
+/**
+ * @brief Build the DFA by subset construction, it is left out if it grows too large.
+ *
+ * A DFA state is a set of NFA states with the context of the byte scanned
+ * last, since assertions look at both sides of a position.
+ */
+static void BuildDfa(Automaton* automaton)
+{
+    typedef std::pair<uint8_t, std::vector<uint32_t>> StateKey;
+
+    std::vector<uint8_t> representatives;
+    ComputeByteClasses(automaton, &representatives);
+
+    std::map<StateKey, uint32_t> ids;
+    std::vector<StateKey>        keys;
+    auto                         intern = [&](uint8_t context, std::vector<uint32_t> kernel) {
+        std::sort(kernel.begin(), kernel.end());
+        kernel.erase(std::unique(kernel.begin(), kernel.end()), kernel.end());
+        StateKey key(context, std::move(kernel));
+        auto     it = ids.find(key);
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+        const uint32_t id = static_cast<uint32_t>(keys.size());
+        ids.emplace(key, id);
+        keys.push_back(std::move(key));
+        return id;
+    };
+
+    for (uint8_t context = 0; context < ContextCount; context++)
+    {
+        automaton->dfa_start[context] = intern(context, { automaton->start });
+    }
+
+    NfaScratch            scratch(automaton->states.size());
+    std::vector<uint32_t> bytes[ContextCount];
+    std::vector<uint32_t> kernel;
+    bool                  matched[ContextCount];
+    for (size_t id = 0; id < keys.size(); id++)
+    {
+        if (keys.size() > MaxDfaStates)
+        {
+            automaton->next.clear();
+            automaton->match.clear();
+            return;
+        }
+
+        const StateKey key = keys[id];
+        for (uint8_t context = 0; context < ContextCount; context++)
+        {
+            const uint8_t left = automaton->reverse ? context : key.first;
+            const uint8_t right = automaton->reverse ? key.first : context;
+            matched[context] = Closure(*automaton, key.second, left, right, scratch, &bytes[context]);
+            automaton->match.push_back(matched[context]);
+        }
+        if (key.second.empty())
+        {
+            automaton->dead = static_cast<uint32_t>(id);
+        }
+
+        for (size_t cls = 0; cls < automaton->class_count; cls++)
+        {
+            const uint8_t c = representatives[cls];
+            const uint8_t context = GetContext(c);
+            Step(*automaton, bytes[context], c, &kernel);
+            const uint32_t target = intern(context, kernel);
+            automaton->next.push_back(target | (matched[context] ? DfaMatchBit : 0));
+        }
+    }
+
+    /* States become row offsets, which saves a multiplication per byte. */
+    const uint32_t count = static_cast<uint32_t>(automaton->class_count);
+    for (uint32_t& target : automaton->next)
+    {
+        target = ((target & ~DfaMatchBit) * count) | (target & DfaMatchBit);
+    }
+    for (uint32_t& start : automaton->dfa_start)
+    {
+        start *= count;
+    }
+    if (automaton->dead != UINT32_MAX)
+    {
+        automaton->dead *= count;
+    }
+    automaton->has_dfa = true;
+}
+
+static bool CompileNfa(Automaton* automaton, const RegexNode& root)
+{
+    const uint32_t match = AddState(automaton, NfaKind::Match, 0);
+    automaton->start = CompileNode(automaton, root, match);
+    return automaton->states.size() <= MaxNfaStates;
+}
+
+static bool CompileAutomaton(Automaton* automaton, const RegexNode& root)
+{
+    if (!CompileNfa(automaton, root))
+    {
+        return false;
+    }
+    BuildDfa(automaton);
+    return true;
+}
+
+/**
+ * @brief Run the forward automaton over [begin, end), the bytes around it are only context.
+ * @return Position where the first match ends.
+ */
+static std::optional<size_t> RunForward(const Automaton& automaton, const uint8_t* text, size_t size, size_t begin,
+                                        size_t end, unsigned cut)
+{
+    const uint8_t before = GetContextBefore(text, begin, cut);
+    const uint8_t after = GetContextAfter(text, size, end, cut);
+    if (automaton.has_dfa)
+    {
+        const uint32_t* next = automaton.next.data();
+        const size_t    count = automaton.class_count;
+        uint32_t        state = automaton.dfa_start[before];
+        for (size_t i = begin; i < end; i++)
+        {
+            const uint32_t target = next[state + automaton.byte_class[text[i]]];
+            if ((target & DfaMatchBit) != 0)
+            {
+                return i;
+            }
+            state = target;
+        }
+        if (automaton.match[state / count * ContextCount + after])
+        {
+            return end;
+        }
+        return std::nullopt;
+    }
+
+    NfaScratch            scratch(automaton.states.size());
+    std::vector<uint32_t> kernel = { automaton.start };
+    std::vector<uint32_t> bytes;
+    uint8_t               scanned = before;
+    for (size_t i = begin; i < end; i++)
+    {
+        const uint8_t context = GetContext(text[i]);
+        if (Closure(automaton, kernel, scanned, context, scratch, &bytes))
+        {
+            return i;
+        }
+        Step(automaton, bytes, text[i], &kernel);
+        scanned = context;
+    }
+    if (Closure(automaton, kernel, scanned, after, scratch, &bytes))
+    {
+        return end;
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Run the reverse automaton from end back to begin.
+ * @return Leftmost start of a match ending at end.
+ */
+static std::optional<size_t> RunReverse(const Automaton& automaton, const uint8_t* text, size_t size, size_t begin,
+                                        size_t end, unsigned cut)
+{
+    const uint8_t         before = GetContextBefore(text, begin, cut);
+    const uint8_t         after = GetContextAfter(text, size, end, cut);
+    std::optional<size_t> start;
+    if (automaton.has_dfa)
+    {
+        const uint32_t* next = automaton.next.data();
+        const size_t    count = automaton.class_count;
+        uint32_t        state = automaton.dfa_start[after];
+        for (size_t i = end; i > begin; i--)
+        {
+            const uint32_t target = next[state + automaton.byte_class[text[i - 1]]];
+            if ((target & DfaMatchBit) != 0)
+            {
+                start = i;
+            }
+            state = target & ~DfaMatchBit;
+            if (state == automaton.dead)
+            {
+                return start;
+            }
+        }
+        if (automaton.match[state / count * ContextCount + before])
+        {
+            start = begin;
+        }
+        return start;
+    }
+
+    NfaScratch            scratch(automaton.states.size());
+    std::vector<uint32_t> kernel = { automaton.start };
+    std::vector<uint32_t> bytes;
+    uint8_t               scanned = after;
+    for (size_t i = end; i > begin; i--)
+    {
+        const uint8_t context = GetContext(text[i - 1]);
+        if (Closure(automaton, kernel, context, scanned, scratch, &bytes))
+        {
+            start = i;
+        }
+        Step(automaton, bytes, text[i - 1], &kernel);
+        if (kernel.empty())
+        {
+            return start;
+        }
+        scanned = context;
+    }
+    if (Closure(automaton, kernel, before, scanned, scratch, &bytes))
+    {
+        start = begin;
+    }
+    return start;
+}
+
+/**
+ * @brief Find where the first match starting from the given position ends.
+ * @param[out] begin No match ending there starts before this position.
+ */
+static std::optional<size_t> SearchEnd(const Regex::Data* data, const uint8_t* text, size_t size, size_t from,
+                                       unsigned cut, size_t* begin)
+{
+    *begin = from;
+    if (data->prefilter != nullptr && !data->line_mode)
+    {
+        if (!data->prefilter->Search(text + from, size - from).has_value())
+        {
+            return std::nullopt;
+        }
+    }
+    if (data->prefilter == nullptr || !data->line_mode)
+    {
+        return RunForward(data->forward, text, size, from, size, cut);
+    }
+
+    /* Only lines holding the literal can match, the automaton runs on them alone. */
+    size_t pos = from;
+    while (pos < size)
+    {
+        const std::optional<size_t> hit = data->prefilter->Search(text + pos, size - pos);
+        if (!hit.has_value())
+        {
+            return std::nullopt;
+        }
+
+        size_t line_begin = pos + hit.value();
+        while (line_begin > pos && text[line_begin - 1] != '\n')
+        {
+            line_begin--;
+        }
+        const void*  feed = memchr(text + pos + hit.value(), '\n', size - pos - hit.value());
+        const size_t line_end = feed != nullptr ? static_cast<size_t>(static_cast<const uint8_t*>(feed) - text) : size;
+
+        const std::optional<size_t> end = RunForward(data->forward, text, size, line_begin, line_end, cut);
+        if (end.has_value())
+        {
+            *begin = line_begin;
+            return end;
+        }
+        pos = line_end + 1;
+    }
+    return std::nullopt;
+}
+
+static bool ParsePattern(const std::string& pattern, bool ignore_case, RegexNode* root, std::string* error)
+{
+    RegexParser parser;
+    parser.ignore_case = ignore_case;
+    if (!DecodeUtf8(pattern, &parser.pattern))
+    {
+        *error = "Pattern is not valid UTF-8";
+        return false;
+    }
+    if (!ParseAlternate(parser, root, 0))
+    {
+        *error = parser.error;
+        return false;
+    }
+    if (!AtEnd(parser))
+    {
+        *error = "Unmatched )";
+        return false;
+    }
+    return true;
+}
+
+Regex::Regex(const std::string& pattern, bool ignore_case)
+{
+    m_data = new Data;
+
+    RegexNode root;
+    if (!ParsePattern(pattern, ignore_case, &root, &m_data->error))
+    {
+        return;
+    }
+
+    m_data->forward.unanchored = true;
+    m_data->reverse.reverse = true;
+    if (!CompileAutomaton(&m_data->forward, root) || !CompileAutomaton(&m_data->reverse, root))
+    {
+        m_data->error = "Pattern is too large";
+        return;
+    }
+
+    CollectLiterals(root, ignore_case, &m_data->literals);
+    GetLengths(root, &m_data->min_length, &m_data->max_length);
+    m_data->line_mode = !MatchesNewline(root);
+
+    const std::string* longest = nullptr;
+    for (const std::string& literal : m_data->literals)
+    {
+        if (longest == nullptr || literal.size() > longest->size())
+        {
+            longest = &literal;
+        }
+    }
+    if (longest != nullptr)
+    {
+        m_data->prefilter = new SubstringSearch(longest->data(), longest->size(), ignore_case);
+    }
+}
+
+Regex::~Regex()
+{
+    delete m_data->prefilter;
+    delete m_data;
+}
+
+bool Regex::Validate(const std::string& pattern, std::string* error)
+{
+    /* The NFA is bounded and cheap, only the DFA is costly to build. */
+    RegexNode root;
+    Automaton automaton;
+    if (!ParsePattern(pattern, false, &root, error))
+    {
+        return false;
+    }
+    if (!CompileNfa(&automaton, root))
+    {
+        *error = "Pattern is too large";
+        return false;
+    }
+    return true;
+}
+
+bool Regex::ParseLiterals(const std::string& pattern, bool ignore_case, std::vector<std::string>* literals)
+{
+    RegexNode   root;
+    std::string error;
+    if (!ParsePattern(pattern, ignore_case, &root, &error))
+    {
+        return false;
+    }
+    CollectLiterals(root, ignore_case, literals);
+    return true;
+}
+
+bool Regex::IsValid() const
+{
+    return m_data->error.empty();
+}
+
+const std::string& Regex::GetError() const
+{
+    return m_data->error;
+}
+
+bool Regex::Search(const void* data, size_t size, unsigned cut) const
+{
+    size_t begin = 0;
+    return IsValid() && SearchEnd(m_data, static_cast<const uint8_t*>(data), size, 0, cut, &begin).has_value();
+}
+
+std::optional<size_t> Regex::Find(const void* data, size_t size, size_t from, size_t* length, unsigned cut) const
+{
+    if (!IsValid() || from > size)
+    {
+        return std::nullopt;
+    }
+
+    const uint8_t*              text = static_cast<const uint8_t*>(data);
+    size_t                      begin = 0;
+    const std::optional<size_t> end = SearchEnd(m_data, text, size, from, cut, &begin);
+    if (!end.has_value())
+    {
+        return std::nullopt;
+    }
+
+    if (end.value() - begin > m_data->max_length)
+    {
+        begin = end.value() - m_data->max_length;
+    }
+    const size_t start = RunReverse(m_data->reverse, text, size, begin, end.value(), cut).value_or(end.value());
+    *length = end.value() - start;
+    return start;
+}
+
+const std::vector<std::string>& Regex::GetLiterals() const
+{
+    return m_data->literals;
+}
+
+size_t Regex::GetMinLength() const
+{
+    return m_data->min_length;
+}
+
+size_t Regex::GetMaxLength() const
+{
+    return m_data->max_length;
+}
+
+bool Regex::IsLineMode() const
+{
+    return m_data->line_mode;
+}
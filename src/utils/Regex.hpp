@@ -0,0 +1,121 @@
+#ifndef LAUNCHR_UTILS_REGEX_HPP
+#define LAUNCHR_UTILS_REGEX_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace LR
+{
+
+/**
+ * @brief Regular expression search over UTF-8 content in linear time.
+ *
+ * The pattern compiles into a Thompson NFA, which is turned into a DFA over
+ * byte classes when it stays small and simulated directly otherwise. Either
+ * way every byte is scanned a bounded number of times, there is no
+ * backtracking. Literal fragments every match must contain are searched
+ * first by the substring kernel, and the automaton only runs on the lines
+ * around their hits.
+ *
+ * Supported syntax: literals, `.`, classes with ranges and negation, the
+ * `\d \w \s` escapes and their negations, groups, `|`, the `* + ? {n,m}`
+ * quantifiers and the `^ $ \b \B` assertions, where `^` and `$` match at
+ * line boundaries, and `$` also before a carriage return so that CRLF lines
+ * end the same way. Backreferences and lookaround are not regular and are
+ * rejected.
+ */
+struct Regex
+{
+    /*
+     * Flags of data cut out of larger content. No assertion holds at a cut
+     * edge, so blocks must overlap by the longest match and one byte on
+     * each side for the block holding a match to see its context.
+     */
+    static constexpr unsigned CutStart = 1; /* Content goes on before the data. */
+    static constexpr unsigned CutEnd = 2;   /* Content goes on after the data. */
+
+    /**
+     * @brief Compile the pattern.
+     * @param[in] pattern Pattern in UTF-8.
+     * @param[in] ignore_case Match letters in any case.
+     */
+    Regex(const std::string& pattern, bool ignore_case);
+    Regex(const Regex&) = delete;
+    ~Regex();
+
+    /**
+     * @brief Check if a pattern compiles, without building the automata for searching.
+     * @param[in] pattern Pattern in UTF-8.
+     * @param[out] error Why the pattern does not compile.
+     * @return true if valid.
+     */
+    static bool Validate(const std::string& pattern, std::string* error);
+
+    /**
+     * @brief Get the literal fragments every match contains, without building the automata for searching.
+     * @param[in] pattern Pattern in UTF-8.
+     * @param[in] ignore_case Match letters in any case, ASCII letters of the fragments are lowercase.
+     * @param[out] literals Fragments, like GetLiterals() of the compiled pattern.
+     * @return true if the pattern parsed.
+     */
+    static bool ParseLiterals(const std::string& pattern, bool ignore_case, std::vector<std::string>* literals);
+
+    /**
+     * @brief Check if the pattern compiled.
+     */
+    bool IsValid() const;
+
+    /**
+     * @brief Get the reason why the pattern did not compile.
+     */
+    const std::string& GetError() const;
+
+    /**
+     * @brief Check if the data has a match. Safe to call from several threads.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @param[in] cut CutStart and CutEnd flags of the data edges.
+     * @return true if found.
+     */
+    bool Search(const void* data, size_t size, unsigned cut = 0) const;
+
+    /**
+     * @brief Find the match that ends first. Safe to call from several threads.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @param[in] from Matches start at or after this position, the data before it is context.
+     * @param[out] length Byte length of the match, from its leftmost start.
+     * @param[in] cut CutStart and CutEnd flags of the data edges.
+     * @return If found, return the matching start position in data. If not found, return null.
+     */
+    std::optional<size_t> Find(const void* data, size_t size, size_t from, size_t* length, unsigned cut = 0) const;
+
+    /**
+     * @brief Get the literal fragments every match contains, ASCII letters are lowercase if case is ignored.
+     */
+    const std::vector<std::string>& GetLiterals() const;
+
+    /**
+     * @brief Get the byte length of the shortest match.
+     */
+    size_t GetMinLength() const;
+
+    /**
+     * @brief Get the byte length of the longest match, SIZE_MAX if unbounded.
+     */
+    size_t GetMaxLength() const;
+
+    /**
+     * @brief Check if no match spans a line feed, whatever its length.
+     */
+    bool IsLineMode() const;
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "AppendOnlyVector.hpp"
+#include "ResultStore.hpp"
+
+using namespace LR;
+
+/* Characters of one arena chunk, longer strings get a chunk of their own. */
+static const size_t ArenaChunkChars = 64 * 1024;
+
+enum RecordFlag : uint16_t
+{
+    RecordFlagPath = 0x01,   /* Result has a path. */
+    RecordFlagJoined = 0x02, /* Path is the directory, the separator and the title. */
+    RecordFlagMatch = 0x04,  /* Result has a matched line. */
+};
+
+struct StringRef
+{
+    uint32_t chunk;  /* Arena chunk index. */
+    uint32_t offset; /* Offset in chunk, in characters. */
+    uint32_t length; /* Length in characters. */
+};
+
+struct ResultRecord
+{
+    StringRef title; /* Title. */
+    StringRef path;  /* Full path, or the directory if RecordFlagJoined. */
+    int32_t   score; /* Relevance. */
+    uint16_t  flags; /* Bitwise of RecordFlag. */
+    uint16_t  sep;   /* Path separator if RecordFlagJoined. */
+    uint32_t  match; /* Index of the matched line if RecordFlagMatch. */
+};
+
+struct MatchRecord
+{
+    uint64_t  line;    /* Line number. */
+    uint64_t  offset;  /* Byte offset in the file. */
+    StringRef snippet; /* Text of the line. */
+};
+
+typedef std::unordered_map<std::wstring_view, StringRef> InternMap;
+
+struct ResultStore::Data
+{
+    AppendOnlyVector<wchar_t*, 10> chunks;     /* Arena chunks, characters never move. */
+    size_t                         chunk_used; /* Characters used in the last chunk. */
+    size_t                         chunk_size; /* Capacity of the last chunk. */
+    AppendOnlyVector<ResultRecord> records;    /* Result records, index is the id. */
+    AppendOnlyVector<MatchRecord>  matches;    /* Matched lines, only content matches have one. */
+    InternMap                      dirs;       /* Interned directories, keys point into the arena. */
+};
+
+/**
+ * @brief Copy a string into the arena.
+ * @return false if the arena is full.
+ */
+static bool StoreString(ResultStore::Data* data, std::wstring_view str, StringRef* ref)
+{
+    if (str.size() > UINT32_MAX)
+    {
+        return false;
+    }
+    if (data->chunks.Size() == 0 || data->chunk_size - data->chunk_used < str.size())
+    {
+        const size_t size = std::max(ArenaChunkChars, str.size());
+        wchar_t*     chunk = new wchar_t[size];
+        if (!data->chunks.PushBack(chunk))
+        {
+            delete[] chunk;
+            return false;
+        }
+        data->chunk_used = 0;
+        data->chunk_size = size;
+    }
+
+    wchar_t* dst = data->chunks[data->chunks.Size() - 1] + data->chunk_used;
+    std::copy(str.begin(), str.end(), dst);
+
+    ref->chunk = static_cast<uint32_t>(data->chunks.Size() - 1);
+    ref->offset = static_cast<uint32_t>(data->chunk_used);
+    ref->length = static_cast<uint32_t>(str.size());
+    data->chunk_used += str.size();
+    return true;
+}
+
+static bool InternString(ResultStore::Data* data, std::wstring_view str, StringRef* ref)
+{
+    InternMap::const_iterator it = data->dirs.find(str);
+    if (it != data->dirs.end())
+    {
+        *ref = it->second;
+        return true;
+    }
+    if (!StoreString(data, str, ref))
+    {
+        return false;
+    }
+
+    /* Key the map by the arena copy, it lives as long as the entry. */
+    data->dirs.emplace(std::wstring_view(data->chunks[ref->chunk] + ref->offset, ref->length), *ref);
+    return true;
+}
+
+static wxString LoadString(const ResultStore::Data* data, const StringRef& ref)
+{
+    return wxString(data->chunks[ref.chunk] + ref.offset, ref.length);
+}
+
+ResultStore::ResultStore()
+{
+    m_data = new Data;
+    m_data->chunk_used = 0;
+    m_data->chunk_size = 0;
+}
+
+ResultStore::~ResultStore()
+{
+    Clear();
+    delete m_data;
+}
+
+ResultStore::Id ResultStore::Add(const Searcher::Result& result)
+{
+    if (m_data->records.Size() >= InvalidId)
+    {
+        return InvalidId;
+    }
+
+    const std::wstring title = result.title.ToStdWstring();
+    ResultRecord       record;
+    record.score = result.score;
+    record.flags = 0;
+    record.sep = 0;
+    record.match = 0;
+    if (!StoreString(m_data, title, &record.title))
+    {
+        return InvalidId;
+    }
+
+    record.path = StringRef{ 0, 0, 0 };
+    if (result.path.has_value())
+    {
+        const std::wstring path = result.path.value().ToStdWstring();
+        const size_t       dir_length = path.size() - std::min(path.size(), title.size() + 1);
+        record.flags |= RecordFlagPath;
+
+        /* Most paths are the directory plus the title, only the directory is stored, once. */
+        if (path.size() > title.size() && (path[dir_length] == '/' || path[dir_length] == '\\') &&
+            path.compare(dir_length + 1, title.size(), title) == 0)
+        {
+            record.flags |= RecordFlagJoined;
+            record.sep = static_cast<uint16_t>(path[dir_length]);
+            if (!InternString(m_data, std::wstring_view(path.data(), dir_length), &record.path))
+            {
+                return InvalidId;
+            }
+        }
+        else if (!StoreString(m_data, path, &record.path))
+        {
+            return InvalidId;
+        }
+    }
+
+    if (result.match.has_value())
+    {
+        MatchRecord match;
+        match.line = result.match->line;
+        match.offset = result.match->offset;
+        if (!StoreString(m_data, result.match->snippet.ToStdWstring(), &match.snippet) ||
+            m_data->matches.Size() >= UINT32_MAX || !m_data->matches.PushBack(match))
+        {
+            return InvalidId;
+        }
+        record.flags |= RecordFlagMatch;
+        record.match = static_cast<uint32_t>(m_data->matches.Size() - 1);
+    }
+
+    if (!m_data->records.PushBack(record))
+    {
+        return InvalidId;
+    }
+    return static_cast<Id>(m_data->records.Size() - 1);
+}
+
+void ResultStore::Clear()
+{
+    m_data->dirs.clear();
+    m_data->records.Clear();
+    m_data->matches.Clear();
+    for (size_t i = 0; i < m_data->chunks.Size(); i++)
+    {
+        delete[] m_data->chunks[i];
+    }
+    m_data->chunks.Clear();
+    m_data->chunk_used = 0;
+    m_data->chunk_size = 0;
+}
+
+size_t ResultStore::GetCount() const
+{
+    return m_data->records.Size();
+}
+
+wxString ResultStore::GetTitle(Id id) const
+{
+    return LoadString(m_data, m_data->records[id].title);
+}
+
+std::optional<wxString> ResultStore::GetPath(Id id) const
+{
+    const ResultRecord& record = m_data->records[id];
+    if (!(record.flags & RecordFlagPath))
+    {
+        return std::nullopt;
+    }
+
+    wxString path = LoadString(m_data, record.path);
+    if (record.flags & RecordFlagJoined)
+    {
+        path += static_cast<wchar_t>(record.sep);
+        path += LoadString(m_data, record.title);
+    }
+    return path;
+}
+
+int ResultStore::GetScore(Id id) const
+{
+    return m_data->records[id].score;
+}
+
+std::optional<Searcher::Match> ResultStore::GetMatch(Id id) const
+{
+    const ResultRecord& record = m_data->records[id];
+    if (!(record.flags & RecordFlagMatch))
+    {
+        return std::nullopt;
+    }
+
+    const MatchRecord& match = m_data->matches[record.match];
+    Searcher::Match    ret;
+    ret.line = match.line;
+    ret.offset = match.offset;
+    ret.snippet = LoadString(m_data, match.snippet);
+    return ret;
+}
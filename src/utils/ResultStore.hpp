@@ -0,0 +1,78 @@
+#ifndef LAUNCHR_UTILS_RESULT_STORE_HPP
+#define LAUNCHR_UTILS_RESULT_STORE_HPP
+
+#include <wx/wx.h>
+#include <cstdint>
+#include <optional>
+#include "searchers/Searcher.hpp"
+
+namespace LR
+{
+
+/**
+ * @brief Append-only result storage, addressed by compact ids.
+ *
+ * Strings are packed into an append-only chunked character arena, every
+ * result is a small fixed size record of string references. Directories are
+ * interned, so files of the same directory share one copy of its path.
+ * Published results are read without locks while a writer appends.
+ *
+ * Add() calls must be serialized by the caller, Clear() must not run
+ * concurrently with anything else.
+ */
+struct ResultStore
+{
+    typedef uint32_t Id;
+    static constexpr Id InvalidId = UINT32_MAX;
+
+    ResultStore();
+    ~ResultStore();
+
+    /**
+     * @brief Add a result.
+     * @param[in] result Result.
+     * @return Id of the result, InvalidId if the store is full.
+     */
+    Id Add(const Searcher::Result& result);
+
+    /**
+     * @brief Remove all results.
+     */
+    void Clear();
+
+    /**
+     * @brief Get the number of published results, their ids are [0, count).
+     */
+    size_t GetCount() const;
+
+    /**
+     * @brief Get result title.
+     * @param[in] id Result id.
+     */
+    wxString GetTitle(Id id) const;
+
+    /**
+     * @brief Get result path.
+     * @param[in] id Result id.
+     */
+    std::optional<wxString> GetPath(Id id) const;
+
+    /**
+     * @brief Get result score.
+     * @param[in] id Result id.
+     */
+    int GetScore(Id id) const;
+
+    /**
+     * @brief Get the matched line of a content match.
+     * @param[in] id Result id.
+     */
+    std::optional<Searcher::Match> GetMatch(Id id) const;
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
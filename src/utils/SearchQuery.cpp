@@ -0,0 +1,626 @@
+#include <wx/wx.h>
+#include <wx/log.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <cwctype>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+#include "SearchQuery.hpp"
+
+using namespace LR;
+
+/* Sizes and durations are clamped, so that interval bounds never overflow. */
+static const double MaxQuantity = 4e18;
+
+/**
+ * @brief Parse one value of a range into the interval it covers, bounds included.
+ * @return false if the value is invalid.
+ */
+typedef bool (*SearchQueryAtom)(const std::string& value, int64_t* lo, int64_t* hi);
+
+struct SearchQueryUnit
+{
+    const char* name;   /* Unit suffix. */
+    double      factor; /* Value of one unit. */
+};
+
+static const SearchQueryUnit SizeUnits[] = {
+    { "", 1 },
+    { "b", 1 },
+    { "k", 1024.0 },
+    { "kb", 1024.0 },
+    { "m", 1024.0 * 1024 },
+    { "mb", 1024.0 * 1024 },
+    { "g", 1024.0 * 1024 * 1024 },
+    { "gb", 1024.0 * 1024 * 1024 },
+    { "t", 1024.0 * 1024 * 1024 * 1024 },
+    { "tb", 1024.0 * 1024 * 1024 * 1024 },
+};
+
+static const SearchQueryUnit DurationUnits[] = {
+    { "s", 1 },     { "m", 60 },        { "min", 60 },       { "h", 3600 },
+    { "d", 86400 }, { "w", 7 * 86400 }, { "y", 365 * 86400 },
+};
+
+/**
+ * @brief Parse a number followed by a unit.
+ */
+template <size_t N>
+static bool SearchQueryParseQuantity(const std::string& value, const SearchQueryUnit (&units)[N], int64_t* quantity)
+{
+    if (value.empty() || !(isdigit(static_cast<unsigned char>(value[0])) || value[0] == '.'))
+    {
+        return false;
+    }
+
+    char*        end = nullptr;
+    const double number = std::strtod(value.c_str(), &end);
+    if (end == value.c_str() || !std::isfinite(number))
+    {
+        return false;
+    }
+
+    for (const SearchQueryUnit& unit : units)
+    {
+        if (value.compare(end - value.c_str(), std::string::npos, unit.name) == 0)
+        {
+            *quantity = static_cast<int64_t>(std::min(number * unit.factor, MaxQuantity));
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool SearchQuerySizeAtom(const std::string& value, int64_t* lo, int64_t* hi)
+{
+    if (!SearchQueryParseQuantity(value, SizeUnits, lo))
+    {
+        return false;
+    }
+    *hi = *lo;
+    return true;
+}
+
+static bool SearchQueryDurationAtom(const std::string& value, int64_t* lo, int64_t* hi)
+{
+    if (!SearchQueryParseQuantity(value, DurationUnits, lo))
+    {
+        return false;
+    }
+    *hi = *lo;
+    return true;
+}
+
+/**
+ * @brief Parse a `YYYY-MM-DD` date into the seconds of that day, in local time.
+ */
+static bool SearchQueryDateAtom(const std::string& value, int64_t* lo, int64_t* hi)
+{
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    int used = 0;
+    if (sscanf(value.c_str(), "%4d-%2d-%2d%n", &year, &month, &day, &used) != 3 ||
+        used != static_cast<int>(value.size()) || year < 1970 || month < 1 || month > 12 || day < 1 || day > 31)
+    {
+        return false;
+    }
+
+    struct tm tm = {};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_isdst = -1;
+    const time_t start = mktime(&tm);
+
+    tm = {};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day + 1;
+    tm.tm_isdst = -1;
+    const time_t end = mktime(&tm);
+    if (start == static_cast<time_t>(-1) || end == static_cast<time_t>(-1))
+    {
+        return false;
+    }
+
+    *lo = static_cast<int64_t>(start);
+    *hi = static_cast<int64_t>(end) - 1;
+    return true;
+}
+
+/**
+ * @brief Parse `>x`, `>=x`, `<x`, `<=x`, `x..y` with either side optional, or a bare value.
+ * @param[in] value Lowercase value.
+ * @param[in] atom Parser of a single value.
+ * @param[out] lo Smallest value in range.
+ * @param[out] hi Largest value in range.
+ * @param[out] bare The value has neither operator nor range.
+ * @return false if the value is invalid.
+ */
+static bool SearchQueryParseRange(const std::string& value, SearchQueryAtom atom, int64_t* lo, int64_t* hi,
+                                  bool* bare)
+{
+    int64_t atom_lo = 0;
+    int64_t atom_hi = 0;
+    *lo = INT64_MIN;
+    *hi = INT64_MAX;
+    *bare = false;
+
+    const size_t dots = value.find("..");
+    if (dots != std::string::npos)
+    {
+        const std::string first = value.substr(0, dots);
+        const std::string last = value.substr(dots + 2);
+        if (first.empty() && last.empty())
+        {
+            return false;
+        }
+        if (!first.empty())
+        {
+            if (!atom(first, &atom_lo, &atom_hi))
+            {
+                return false;
+            }
+            *lo = atom_lo;
+        }
+        if (!last.empty())
+        {
+            if (!atom(last, &atom_lo, &atom_hi))
+            {
+                return false;
+            }
+            *hi = atom_hi;
+        }
+        return *lo <= *hi;
+    }
+
+    const size_t op = value.find_first_not_of("<>=");
+    if (op == std::string::npos || !atom(value.substr(op), &atom_lo, &atom_hi))
+    {
+        return false;
+    }
+
+    const std::string comparison = value.substr(0, op);
+    if (comparison == ">")
+    {
+        *lo = atom_hi + 1;
+    }
+    else if (comparison == ">=")
+    {
+        *lo = atom_lo;
+    }
+    else if (comparison == "<")
+    {
+        *hi = atom_lo - 1;
+    }
+    else if (comparison == "<=")
+    {
+        *hi = atom_hi;
+    }
+    else if (comparison.empty() || comparison == "=")
+    {
+        *lo = atom_lo;
+        *hi = atom_hi;
+        *bare = comparison.empty();
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a modification time range, of dates or of ages relative to now.
+ */
+static bool SearchQueryParseMtime(const std::string& value, int64_t now, int64_t* lo, int64_t* hi)
+{
+    bool bare = false;
+    if (std::none_of(value.begin(), value.end(), [](char c) { return isalpha(static_cast<unsigned char>(c)); }))
+    {
+        return SearchQueryParseRange(value, SearchQueryDateAtom, lo, hi, &bare);
+    }
+
+    /* Ages compare the other way round: `<2d` is newer than two days ago, and so is a bare `2d`. */
+    int64_t age_lo = 0;
+    int64_t age_hi = 0;
+    if (!SearchQueryParseRange(value, SearchQueryDurationAtom, &age_lo, &age_hi, &bare))
+    {
+        return false;
+    }
+    if (bare)
+    {
+        age_lo = INT64_MIN;
+    }
+    *lo = age_hi == INT64_MAX ? INT64_MIN : now - age_hi;
+    *hi = age_lo == INT64_MIN ? INT64_MAX : now - age_lo;
+    return *lo <= *hi;
+}
+
+static std::wstring SearchQueryLower(const wxString& str)
+{
+    std::wstring lower;
+    lower.reserve(str.length());
+    for (wxString::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+        lower.push_back(static_cast<wchar_t>(towlower(static_cast<wint_t>((*it).GetValue()))));
+    }
+    return lower;
+}
+
+/**
+ * @brief Parse a filter token.
+ * @return false if the token is not a filter and belongs to the text.
+ */
+static bool SearchQueryParseFilter(SearchQuery* query, const wxString& token, int64_t now)
+{
+    const size_t colon = token.find(':');
+    if (colon == wxString::npos || colon == 0)
+    {
+        return false;
+    }
+
+    const wxString key = token.Left(colon).Lower();
+    if (key != "ext" && key != "path" && key != "size" && key != "mtime")
+    {
+        return false;
+    }
+
+    wxString value;
+    for (wxString::const_iterator it = token.begin(); it != token.end(); ++it)
+    {
+        if (*it != '"')
+        {
+            value += *it;
+        }
+    }
+    value = value.Mid(colon + 1);
+
+    /* A filter still being typed is taken out of the text, but filters nothing yet. */
+    if (value.find_first_not_of("<>=") == wxString::npos)
+    {
+        if (query->incomplete.empty())
+        {
+            query->incomplete = token;
+        }
+        return true;
+    }
+
+    bool               parsed = true;
+    const std::wstring lower = SearchQueryLower(value);
+    if (key == "ext")
+    {
+        std::vector<std::wstring> extensions;
+        size_t                    start = 0;
+        while (start <= lower.size())
+        {
+            size_t end = lower.find_first_of(L",;", start);
+            if (end == std::wstring::npos)
+            {
+                end = lower.size();
+            }
+            std::wstring extension = lower.substr(start, end - start);
+            if (!extension.empty() && extension[0] == '.')
+            {
+                extension.erase(0, 1);
+            }
+            if (!extension.empty())
+            {
+                extensions.push_back(extension);
+            }
+            start = end + 1;
+        }
+        if (extensions.empty())
+        {
+            if (query->incomplete.empty())
+            {
+                query->incomplete = token;
+            }
+            return true;
+        }
+        query->extensions.push_back(extensions);
+    }
+    else if (key == "path")
+    {
+        std::wstring fragment = lower;
+        std::replace(fragment.begin(), fragment.end(), L'\\', L'/');
+        query->paths.push_back(fragment);
+    }
+    else
+    {
+        const std::string utf8 = wxString(lower).ToUTF8().data();
+        int64_t           lo = 0;
+        int64_t           hi = 0;
+        bool              bare = false;
+        if (key == "size")
+        {
+            parsed = SearchQueryParseRange(utf8, SearchQuerySizeAtom, &lo, &hi, &bare);
+            query->min_size = std::max(query->min_size, lo);
+            query->max_size = std::min(query->max_size, hi);
+        }
+        else
+        {
+            parsed = SearchQueryParseMtime(utf8, now, &lo, &hi);
+            query->min_mtime = std::max(query->min_mtime, lo);
+            query->max_mtime = std::min(query->max_mtime, hi);
+        }
+    }
+
+    if (!parsed)
+    {
+        wxLogWarning("Invalid filter `%s`", token);
+        if (query->valid)
+        {
+            query->error = token;
+        }
+        query->valid = false;
+    }
+    query->filters.push_back(token.Lower());
+    return true;
+}
+
+SearchQuery::SearchQuery(const wxString& query) : content(wxEmptyString)
+{
+    min_size = 0;
+    max_size = INT64_MAX;
+    min_mtime = INT64_MIN;
+    max_mtime = INT64_MAX;
+    valid = true;
+
+    /* Quoted tokens are never filters, so `"ext:txt"` searches the text itself. */
+    const int64_t now = static_cast<int64_t>(std::time(nullptr));
+    bool          filtered = false;
+    bool          quoted = false;
+    wxString      token;
+    wxString      gap;
+    for (wxString::const_iterator it = query.begin();; ++it)
+    {
+        const bool last = it == query.end();
+        if (last || (!quoted && wxIsspace(*it)))
+        {
+            if (!token.empty())
+            {
+                if (SearchQueryParseFilter(this, token, now))
+                {
+                    filtered = true;
+                }
+                else
+                {
+                    text += text.empty() ? wxString() : gap;
+                    text += token;
+                }
+                token.clear();
+                gap.clear();
+            }
+            if (last)
+            {
+                break;
+            }
+            gap += *it;
+            continue;
+        }
+
+        if (*it == '"')
+        {
+            quoted = !quoted;
+        }
+        token += *it;
+    }
+
+    /* Without filters the text is the query as typed, whitespace included. */
+    if (!filtered)
+    {
+        text = query;
+    }
+    name = FuzzyMatch(text);
+    content = TextQuery(text);
+}
+
+bool SearchQuery::IsValid() const
+{
+    return valid;
+}
+
+bool SearchQuery::HasFilters() const
+{
+    return !extensions.empty() || !paths.empty() || min_size != 0 || max_size != INT64_MAX ||
+           min_mtime != INT64_MIN || max_mtime != INT64_MAX;
+}
+
+bool SearchQuery::NeedsMetadata() const
+{
+    return min_size != 0 || max_size != INT64_MAX || min_mtime != INT64_MIN || max_mtime != INT64_MAX;
+}
+
+bool SearchQuery::MatchName(const wxString& name) const
+{
+    if (!valid)
+    {
+        return false;
+    }
+    if (extensions.empty())
+    {
+        return true;
+    }
+
+    const size_t dot = name.rfind('.');
+    if (dot == wxString::npos)
+    {
+        return false;
+    }
+
+    /* The extension is compared in place, the name is never copied. */
+    const size_t length = name.length() - dot - 1;
+    for (const std::vector<std::wstring>& alternatives : extensions)
+    {
+        bool matched = false;
+        for (size_t i = 0; i < alternatives.size() && !matched; i++)
+        {
+            const std::wstring& extension = alternatives[i];
+            matched = extension.size() == length;
+            for (size_t j = 0; j < length && matched; j++)
+            {
+                matched = towlower(static_cast<wint_t>(name[dot + 1 + j].GetValue())) ==
+                          static_cast<wint_t>(extension[j]);
+            }
+        }
+        if (!matched)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Compare the lowercase fragment with the path at the position, in any case and with any separator.
+ */
+static bool SearchQueryPathAt(const wxString& path, size_t pos, const std::wstring& fragment)
+{
+    for (size_t i = 0; i < fragment.size(); i++)
+    {
+        wint_t c = towlower(static_cast<wint_t>(path[pos + i].GetValue()));
+        if (c == '\\')
+        {
+            c = '/';
+        }
+        if (c != static_cast<wint_t>(fragment[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SearchQuery::MatchPath(const wxString& path) const
+{
+    if (!valid)
+    {
+        return false;
+    }
+
+    const size_t length = path.length();
+    for (const std::wstring& fragment : paths)
+    {
+        bool found = false;
+        for (size_t pos = 0; pos + fragment.size() <= length && !found; pos++)
+        {
+            found = SearchQueryPathAt(path, pos, fragment);
+        }
+        if (!found)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SearchQuery::MatchMetadata(int64_t size, int64_t mtime) const
+{
+    return valid && size >= min_size && size <= max_size && mtime >= min_mtime && mtime <= max_mtime;
+}
+
+bool SearchQuery::MatchFile(const wxString& name, const wxString& path) const
+{
+    return MatchName(name) && MatchPathAndMetadata(path);
+}
+
+bool SearchQuery::MatchPathAndMetadata(const wxString& path) const
+{
+    if (!MatchPath(path))
+    {
+        return false;
+    }
+    if (!NeedsMetadata())
+    {
+        return true;
+    }
+
+#if defined(WIN32)
+    struct _stat64 st;
+    if (_wstat64(path.wc_str(), &st) != 0)
+    {
+        return false;
+    }
+    return MatchMetadata(static_cast<int64_t>(st.st_size), static_cast<int64_t>(st.st_mtime));
+#elif defined(__linux__)
+    /* Only size and time are asked for, the filesystem may skip the rest. */
+    struct statx st;
+    if (statx(AT_FDCWD, path.fn_str(), AT_STATX_SYNC_AS_STAT, STATX_SIZE | STATX_MTIME, &st) != 0 ||
+        (st.stx_mask & (STATX_SIZE | STATX_MTIME)) != (STATX_SIZE | STATX_MTIME))
+    {
+        return false;
+    }
+    return MatchMetadata(static_cast<int64_t>(st.stx_size), static_cast<int64_t>(st.stx_mtime.tv_sec));
+#else
+    struct stat st;
+    if (stat(path.fn_str(), &st) != 0)
+    {
+        return false;
+    }
+    return MatchMetadata(static_cast<int64_t>(st.st_size), static_cast<int64_t>(st.st_mtime));
+#endif
+}
+
+/**
+ * @brief Check if a file with one of the extensions always has one of the other extensions.
+ */
+static bool SearchQueryExtensionsImply(const std::vector<std::wstring>& extensions,
+                                       const std::vector<std::wstring>& other)
+{
+    return std::all_of(extensions.begin(), extensions.end(), [&other](const std::wstring& extension) {
+        return std::find(other.begin(), other.end(), extension) != other.end();
+    });
+}
+
+bool SearchQuery::FiltersNarrow(const SearchQuery& other) const
+{
+    if (!valid || !other.valid)
+    {
+        return false;
+    }
+    if (min_size < other.min_size || max_size > other.max_size || min_mtime < other.min_mtime ||
+        max_mtime > other.max_mtime)
+    {
+        return false;
+    }
+
+    for (const std::vector<std::wstring>& other_extensions : other.extensions)
+    {
+        const bool implied = std::any_of(extensions.begin(), extensions.end(),
+                                         [&other_extensions](const std::vector<std::wstring>& list) {
+                                             return SearchQueryExtensionsImply(list, other_extensions);
+                                         });
+        if (!implied)
+        {
+            return false;
+        }
+    }
+
+    /* A path containing a longer fragment also contains the shorter one. */
+    for (const std::wstring& other_path : other.paths)
+    {
+        const bool implied = std::any_of(paths.begin(), paths.end(), [&other_path](const std::wstring& path) {
+            return path.find(other_path) != std::wstring::npos;
+        });
+        if (!implied)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SearchQuery::SameFilters(const SearchQuery& other) const
+{
+    return valid && other.valid && filters == other.filters;
+}
@@ -0,0 +1,121 @@
+#ifndef LAUNCHR_UTILS_SEARCH_QUERY_HPP
+#define LAUNCHR_UTILS_SEARCH_QUERY_HPP
+
+#include <wx/wx.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FuzzyMatch.hpp"
+#include "TextQuery.hpp"
+
+namespace LR
+{
+
+/**
+ * @brief Query compiled once and shared by all searchers.
+ *
+ * Tokens of the form `keyword:value` are filters on files, the rest of the
+ * query is the text matched against names and content:
+ *
+ * - `ext:txt` or `ext:c,h` keeps files with one of the extensions.
+ * - `path:src/ui` keeps files whose full path contains the fragment, in any case.
+ * - `size:>1M`, `size:<=4k`, `size:10k..2M` keep files by size, units are b, k, m, g and t.
+ * - `mtime:<2d` keeps files modified in the last two days, `mtime:>1w` files older than one week.
+ *   Units are s, m, h, d, w and y. Dates work the same, `mtime:>=2024-05-01` or `mtime:2024-01-01..2024-06-30`.
+ *
+ * All filters must hold. Predicates are ordered by cost: the name first, then
+ * the path, and file metadata last, so a file is only stat'ed if everything
+ * else already matched.
+ */
+struct SearchQuery
+{
+    /**
+     * @brief Parse query string.
+     * @param[in] query Query string.
+     */
+    explicit SearchQuery(const wxString& query);
+
+    /**
+     * @brief Check if all filters parsed. A query with an invalid filter matches nothing.
+     */
+    bool IsValid() const;
+
+    /**
+     * @brief Check if any filter is set.
+     */
+    bool HasFilters() const;
+
+    /**
+     * @brief Check if the filters need file metadata, see MatchMetadata().
+     */
+    bool NeedsMetadata() const;
+
+    /**
+     * @brief Check the name filters, without touching the disk.
+     * @param[in] name File name.
+     * @return true if matched.
+     */
+    bool MatchName(const wxString& name) const;
+
+    /**
+     * @brief Check the path filters, without touching the disk.
+     * @param[in] path Full file path.
+     * @return true if matched.
+     */
+    bool MatchPath(const wxString& path) const;
+
+    /**
+     * @brief Check the metadata filters.
+     * @param[in] size File size.
+     * @param[in] mtime Modification time in seconds since the epoch.
+     * @return true if matched.
+     */
+    bool MatchMetadata(int64_t size, int64_t mtime) const;
+
+    /**
+     * @brief Run the path and metadata filters, for callers that already checked MatchName().
+     * @param[in] path Full file path, stat'ed only if metadata is needed.
+     * @return true if matched.
+     */
+    bool MatchPathAndMetadata(const wxString& path) const;
+
+    /**
+     * @brief Run all filters in order of cost, the file is stat'ed only if metadata is needed.
+     * @param[in] name File name.
+     * @param[in] path Full file path.
+     * @return true if matched.
+     */
+    bool MatchFile(const wxString& name, const wxString& path) const;
+
+    /**
+     * @brief Check if all files passing the filters of this query also pass the filters of the other one.
+     * @param[in] other The other query.
+     * @return true if the filters of this query are narrower or the same.
+     */
+    bool FiltersNarrow(const SearchQuery& other) const;
+
+    /**
+     * @brief Check if the filters are written the same, relative times included.
+     * @param[in] other The other query.
+     */
+    bool SameFilters(const SearchQuery& other) const;
+
+    wxString   text;    /* Query without the filters. */
+    FuzzyMatch name;    /* Name matcher compiled from text. */
+    TextQuery  content; /* Content query compiled from text. */
+
+    std::vector<wxString>                  filters;    /* Filter tokens as written, in lowercase. */
+    std::vector<std::vector<std::wstring>> extensions; /* Lowercase extensions, one of each list must match. */
+    std::vector<std::wstring>              paths;      /* Lowercase path fragments with `/` separators. */
+    int64_t                                min_size;   /* Smallest size. */
+    int64_t                                max_size;   /* Largest size. */
+    int64_t                                min_mtime;  /* Oldest modification time, in seconds since the epoch. */
+    int64_t                                max_mtime;  /* Newest modification time, in seconds since the epoch. */
+    bool                                   valid;      /* All filters parsed. */
+    wxString                               error;      /* First filter that failed to parse, as written. */
+    wxString                               incomplete; /* First filter without a value, it filters nothing. */
+};
+
+} // namespace LR
+
+#endif
@@ -10,7 +10,10 @@ namespace LR
 {
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(SettingLog, enable, path)
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Settings, log, PortableAppSupport, FileNameSupport, TextSupport,
-                                                TextMaxSize)
+                                                TextMaxSize, TextWindowSize, TextIgnoreCase, TextUtf16Support,
+                                                TraversalThreads, ShowQueryMetrics, TraceQueries, TextSkipSize,
+                                                TextSkipBinary, TextSkipExtensions, TextReadQueueDepth,
+                                                TextContentIndex, TextMatchesPerFile)
 } // namespace LR
 
 struct SettingsManager::Data
@@ -1,6 +1,9 @@
 #ifndef LAUNCHR_UTILS_SETTINGS_HPP
 #define LAUNCHR_UTILS_SETTINGS_HPP
 
+#include <string>
+#include <vector>
+
 namespace LR
 {
 
@@ -12,11 +15,27 @@ struct SettingLog
 
 struct Settings
 {
-    SettingLog log;                           /* Log configuration. */
-    bool       PortableAppSupport = true;     /* Enable PortableApps.com format support. */
-    bool       FileNameSupport = true;        /* Enable filename search. */
-    bool       TextSupport = true;            /* Enable text search. */
-    size_t     TextMaxSize = 8 * 1024 * 1024; /* Text max search size. */
+    SettingLog               log;                              /* Log configuration. */
+    bool                     PortableAppSupport = true;        /* Enable PortableApps.com format support. */
+    bool                     FileNameSupport = true;           /* Enable filename search. */
+    bool                     TextSupport = true;               /* Enable text search. */
+    size_t                   TextMaxSize = 0;                  /* Text max search size per file, 0 for no limit. */
+    size_t                   TextWindowSize = 8 * 1024 * 1024; /* Text search maps files in windows of this size. */
+    bool                     TextIgnoreCase = true;            /* Text search ignores letter case. */
+    bool                     TextUtf16Support = true;          /* Text search also matches UTF-16LE files. */
+    unsigned                 TraversalThreads = 0;             /* Directory traversal threads, 0 to use all cores. */
+    bool                     ShowQueryMetrics = false;         /* Show query timing in the status bar. */
+    bool                     TraceQueries = false;             /* Save Chrome traces of the last finished queries. */
+    size_t                   TextSkipSize = 0;                 /* Text search skips larger files, 0 for no limit. */
+    bool                     TextSkipBinary = true;            /* Text search skips files that look binary. */
+    unsigned                 TextReadQueueDepth = 0;           /* Files read at once by text search, 0 to map them. */
+    bool                     TextContentIndex = false;         /* Text search keeps a trigram index of file content. */
+    unsigned                 TextMatchesPerFile = 0;           /* Lines reported per file by text search, 0 for none. */
+    std::vector<std::string> TextSkipExtensions = { /* Text search skips files of these extensions. */
+        "exe", "dll", "so", "o", "obj", "a", "lib", "pdb", "class", "jar", "pyc", "zip", "7z", "rar", "gz", "xz",
+        "bz2", "zst", "tar", "iso", "img", "vhd", "vhdx", "vmdk", "qcow2", "png", "jpg", "jpeg", "gif", "bmp", "ico",
+        "webp", "mp3", "mp4", "mkv", "avi", "mov", "wav", "flac", "ogg", "ttf", "otf", "woff", "woff2"
+    };
 };
 
 class SettingsManager
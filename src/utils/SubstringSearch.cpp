@@ -0,0 +1,388 @@
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+#include "BoyerMoore.hpp"
+#include "SubstringSearch.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LR_SUBSTRING_SEARCH_X64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/* MSVC does not need target attributes to use AVX2 intrinsics. */
+#if defined(_MSC_VER) && !defined(__clang__)
+#define LR_TARGET_AVX2
+#else
+#define LR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+using namespace LR;
+
+/* Patterns longer than this are searched by Boyer-Moore, whose shift tables skip more than SIMD filtering. */
+static const size_t LongPatternLength = 64;
+
+/**
+ * @brief Search kernel.
+ * @param[in] text Text data.
+ * @param[in] size Text length.
+ * @param[in] pat Pattern data.
+ * @param[in] m Pattern length, at least 1.
+ * @param[in] fold Bits to set on each text byte before comparing with the pattern, or nullptr if case-sensitive.
+ * @return Address of the first match, or nullptr.
+ */
+typedef const uint8_t* (*SearchKernel)(const uint8_t* text, size_t size, const uint8_t* pat, size_t m,
+                                       const uint8_t* fold);
+
+struct KernelTable
+{
+    const char*  name;    /* Instruction set name. */
+    SearchKernel generic; /* Kernel for patterns of 4 bytes or more. */
+    SearchKernel short1;  /* Kernel for 1 byte pattern. */
+    SearchKernel short2;  /* Kernel for 2 bytes pattern. */
+    SearchKernel short3;  /* Kernel for 3 bytes pattern. */
+};
+
+struct SubstringSearch::Data
+{
+    std::vector<uint8_t>      pattern;  /* Query pattern, ASCII letters in lowercase if case-insensitive. */
+    std::vector<uint8_t>      fold;     /* Fold mask of every pattern byte, empty if case-sensitive. */
+    SearchKernel              kernel;   /* Kernel for short pattern. */
+    std::optional<BoyerMoore> fallback; /* Matcher for long case-sensitive pattern. */
+};
+
+/**
+ * @brief Get the bits to set on the text byte before comparing with a pattern byte.
+ *
+ * Upper and lower case ASCII letters only differ by 0x20, so setting the bit
+ * on a text byte matched against a lowercase letter compares it in any case.
+ * Other bytes must not be touched, neither the high byte of a UTF-16 unit nor
+ * the low byte of a unit above 0xFF, which only look like letters.
+ */
+static inline uint8_t GetFoldMask(const uint8_t* fold, size_t i)
+{
+    return fold != nullptr ? fold[i] : 0;
+}
+
+static bool EqualBytes(const uint8_t* text, const uint8_t* pat, const uint8_t* fold, size_t n)
+{
+    if (fold == nullptr)
+    {
+        return memcmp(text, pat, n) == 0;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        if ((text[i] | fold[i]) != pat[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline unsigned CountTrailingZeros(uint32_t v)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(v));
+#endif
+}
+
+static const uint8_t* SearchScalar(const uint8_t* text, size_t size, const uint8_t* pat, size_t m,
+                                   const uint8_t* fold)
+{
+    if (size < m)
+    {
+        return nullptr;
+    }
+
+    const uint8_t* end = text + size - m + 1; /* End of match candidates. */
+    if (fold != nullptr)
+    {
+        for (const uint8_t* p = text; p < end; ++p)
+        {
+            if (EqualBytes(p, pat, fold, m))
+            {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    for (const uint8_t* p = text; p < end; ++p)
+    {
+        p = static_cast<const uint8_t*>(memchr(p, pat[0], end - p));
+        if (p == nullptr)
+        {
+            return nullptr;
+        }
+        if (memcmp(p + 1, pat + 1, m - 1) == 0)
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#if defined(LR_SUBSTRING_SEARCH_X64)
+
+/**
+ * @brief Compare the first and last byte of every candidate in one go, only
+ *   candidates passing both are verified. Patterns of 1-3 bytes are fully
+ *   covered by the compared bytes, so they need no verification at all.
+ *   Case folding costs one OR for each compared block, see #GetFoldMask().
+ * @tparam N Pattern length, or 0 for generic pattern of 4 bytes or more.
+ */
+template <size_t N>
+static const uint8_t* SearchSse2(const uint8_t* text, size_t size, const uint8_t* pat, size_t m,
+                                 const uint8_t* fold)
+{
+    const size_t  len = N != 0 ? N : m;
+    const __m128i first = _mm_set1_epi8(static_cast<char>(pat[0]));
+    const __m128i last = _mm_set1_epi8(static_cast<char>(pat[len - 1]));
+    const __m128i middle = _mm_set1_epi8(static_cast<char>(pat[len / 2]));
+    const __m128i first_fold = _mm_set1_epi8(static_cast<char>(GetFoldMask(fold, 0)));
+    const __m128i last_fold = _mm_set1_epi8(static_cast<char>(GetFoldMask(fold, len - 1)));
+    const __m128i middle_fold = _mm_set1_epi8(static_cast<char>(GetFoldMask(fold, len / 2)));
+
+    size_t i = 0;
+    for (; i + len - 1 + sizeof(__m128i) <= size; i += sizeof(__m128i))
+    {
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i       eq = _mm_cmpeq_epi8(first, _mm_or_si128(head, first_fold));
+        if constexpr (N != 1)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + len - 1));
+            eq = _mm_and_si128(eq, _mm_cmpeq_epi8(last, _mm_or_si128(block, last_fold)));
+        }
+        if constexpr (N == 3)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 1));
+            eq = _mm_and_si128(eq, _mm_cmpeq_epi8(middle, _mm_or_si128(block, middle_fold)));
+        }
+
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(eq));
+        if constexpr (N != 0)
+        {
+            if (mask != 0)
+            {
+                return text + i + CountTrailingZeros(mask);
+            }
+        }
+        else
+        {
+            for (; mask != 0; mask &= mask - 1)
+            {
+                const size_t pos = i + CountTrailingZeros(mask);
+                if (EqualBytes(text + pos + 1, pat + 1, fold != nullptr ? fold + 1 : nullptr, len - 2))
+                {
+                    return text + pos;
+                }
+            }
+        }
+    }
+
+    return SearchScalar(text + i, size - i, pat, len, fold);
+}
+
+/**
+ * @brief Same as #SearchSse2() with 32 bytes blocks.
+ */
+template <size_t N>
+LR_TARGET_AVX2 static const uint8_t* SearchAvx2(const uint8_t* text, size_t size, const uint8_t* pat, size_t m,
+                                                const uint8_t* fold)
+{
+    const size_t  len = N != 0 ? N : m;
+    const __m256i first = _mm256_set1_epi8(static_cast<char>(pat[0]));
+    const __m256i last = _mm256_set1_epi8(static_cast<char>(pat[len - 1]));
+    const __m256i middle = _mm256_set1_epi8(static_cast<char>(pat[len / 2]));
+    const __m256i first_fold = _mm256_set1_epi8(static_cast<char>(GetFoldMask(fold, 0)));
+    const __m256i last_fold = _mm256_set1_epi8(static_cast<char>(GetFoldMask(fold, len - 1)));
+    const __m256i middle_fold = _mm256_set1_epi8(static_cast<char>(GetFoldMask(fold, len / 2)));
+
+    size_t i = 0;
+    for (; i + len - 1 + sizeof(__m256i) <= size; i += sizeof(__m256i))
+    {
+        const __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i       eq = _mm256_cmpeq_epi8(first, _mm256_or_si256(head, first_fold));
+        if constexpr (N != 1)
+        {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + len - 1));
+            eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(last, _mm256_or_si256(block, last_fold)));
+        }
+        if constexpr (N == 3)
+        {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + 1));
+            eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(middle, _mm256_or_si256(block, middle_fold)));
+        }
+
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+        if constexpr (N != 0)
+        {
+            if (mask != 0)
+            {
+                return text + i + CountTrailingZeros(mask);
+            }
+        }
+        else
+        {
+            for (; mask != 0; mask &= mask - 1)
+            {
+                const size_t pos = i + CountTrailingZeros(mask);
+                if (EqualBytes(text + pos + 1, pat + 1, fold != nullptr ? fold + 1 : nullptr, len - 2))
+                {
+                    return text + pos;
+                }
+            }
+        }
+    }
+
+    /* The tail is shorter than one AVX2 block, but may still fill some SSE2 blocks. */
+    return SearchSse2<N>(text + i, size - i, pat, len, fold);
+}
+
+static bool CpuSupportsAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    /* AVX2 registers are only usable if the OS saves them on context switch. */
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+static const KernelTable& GetKernelTable()
+{
+#if defined(LR_SUBSTRING_SEARCH_X64)
+    static const KernelTable avx2 = {
+        "AVX2", SearchAvx2<0>, SearchAvx2<1>, SearchAvx2<2>, SearchAvx2<3>,
+    };
+    static const KernelTable sse2 = {
+        "SSE2", SearchSse2<0>, SearchSse2<1>, SearchSse2<2>, SearchSse2<3>,
+    };
+    static const KernelTable& table = CpuSupportsAvx2() ? avx2 : sse2;
+#else
+    static const KernelTable table = {
+        "Scalar", SearchScalar, SearchScalar, SearchScalar, SearchScalar,
+    };
+#endif
+    return table;
+}
+
+static SearchKernel SelectKernel(size_t m)
+{
+    const KernelTable& table = GetKernelTable();
+    switch (m)
+    {
+    case 1:
+        return table.short1;
+    case 2:
+        return table.short2;
+    case 3:
+        return table.short3;
+    default:
+        return table.generic;
+    }
+}
+
+SubstringSearch::SubstringSearch(const void* pattern, size_t length, bool ignore_case, size_t unit_size)
+{
+    m_data = new Data;
+    const uint8_t* pat = static_cast<const uint8_t*>(pattern);
+    m_data->pattern.assign(pat, pat + length);
+    m_data->kernel = SelectKernel(length);
+
+    if (ignore_case)
+    {
+        m_data->fold.assign(length, 0);
+        for (size_t i = 0; i < length; i++)
+        {
+            uint8_t&   c = m_data->pattern[i];
+            const bool ascii = unit_size == 1 || (i % 2 == 0 && i + 1 < length && pat[i + 1] == 0);
+            if (ascii && c >= 'A' && c <= 'Z')
+            {
+                c |= 0x20;
+            }
+            if (ascii && c >= 'a' && c <= 'z')
+            {
+                m_data->fold[i] = 0x20;
+            }
+        }
+    }
+    else if (length > LongPatternLength)
+    {
+        m_data->fallback.emplace(pattern, length);
+    }
+}
+
+SubstringSearch::SubstringSearch(const SubstringSearch& orig)
+{
+    m_data = new Data;
+    *m_data = *orig.m_data;
+}
+
+SubstringSearch& SubstringSearch::operator=(const SubstringSearch& orig)
+{
+    if (this != &orig)
+    {
+        *m_data = *orig.m_data;
+    }
+    return *this;
+}
+
+SubstringSearch::~SubstringSearch()
+{
+    delete m_data;
+}
+
+std::optional<size_t> SubstringSearch::Search(const void* data, size_t size) const
+{
+    const size_t m = m_data->pattern.size();
+    if (m == 0 || size < m)
+    {
+        return std::nullopt;
+    }
+
+    if (m_data->fallback.has_value())
+    {
+        return m_data->fallback->Search(data, size);
+    }
+
+    const uint8_t* text = static_cast<const uint8_t*>(data);
+    const uint8_t* fold = m_data->fold.empty() ? nullptr : m_data->fold.data();
+    const uint8_t* pos = m_data->kernel(text, size, m_data->pattern.data(), m, fold);
+    if (pos == nullptr)
+    {
+        return std::nullopt;
+    }
+    return static_cast<size_t>(pos - text);
+}
+
+const char* SubstringSearch::GetKernelName()
+{
+    return GetKernelTable().name;
+}
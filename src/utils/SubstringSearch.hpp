@@ -0,0 +1,50 @@
+#ifndef LAUNCHR_UTILS_SUBSTRING_SEARCH_HPP
+#define LAUNCHR_UTILS_SUBSTRING_SEARCH_HPP
+
+#include <cstddef>
+#include <optional>
+
+namespace LR
+{
+
+/**
+ * @brief Binary substring search.
+ *
+ * Short patterns are matched by SIMD kernels that filter candidates by the
+ * first and last byte, the kernel is selected at runtime by CPU features.
+ * Long case-sensitive patterns fall back to Boyer-Moore.
+ */
+struct SubstringSearch
+{
+    /**
+     * @brief Constructor for substring search.
+     * @param[in] pattern Pattern data.
+     * @param[in] length Pattern length.
+     * @param[in] ignore_case Match ASCII letters in any case.
+     * @param[in] unit_size Code unit size, 2 for UTF-16LE where only the low byte of a unit below 0x80 is a letter.
+     */
+    SubstringSearch(const void* pattern, size_t length, bool ignore_case = false, size_t unit_size = 1);
+    SubstringSearch(const SubstringSearch& orig);
+    SubstringSearch& operator=(const SubstringSearch&);
+    ~SubstringSearch();
+
+    /**
+     * @brief Search for the pattern in given binary data. Safe to call from several threads.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @return If found, return the matching start position. If not found, return null.
+     */
+    std::optional<size_t> Search(const void* data, size_t size) const;
+
+    /**
+     * @brief Get the name of the kernel selected for current CPU.
+     */
+    static const char* GetKernelName();
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
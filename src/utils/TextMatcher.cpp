@@ -0,0 +1,408 @@
+#include <wx/wx.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AhoCorasick.hpp"
+#include "Regex.hpp"
+#include "SubstringSearch.hpp"
+#include "TextMatcher.hpp"
+
+/* SSE2 is part of x86-64, no runtime check is needed. */
+#if defined(__x86_64__) || defined(_M_X64)
+#define LR_TEXT_MATCHER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace LR;
+using namespace std::string_view_literals;
+
+/* Only the beginning of the content is checked to guess the encoding. */
+static const size_t EncodingProbeSize = 512;
+
+/* Only the first page is checked to guess if the content is binary. */
+static const size_t BinaryProbeSize = 4096;
+
+/*
+ * Matches of regular expressions are assumed to be at most this long, so that blocks overlap by a bounded size.
+ * Longer matches are still found within a line, see TextMatcher::GetNextBlock().
+ */
+static const size_t RegexMaxSpan = 4096;
+
+struct BinarySignature
+{
+    size_t           offset; /* Offset of the signature. */
+    std::string_view bytes;  /* Signature bytes. */
+};
+
+/* Formats never searched as text, their strings are mostly compressed or encoded. */
+static const BinarySignature BinarySignatures[] = {
+    { 0, "\x7F" "ELF"sv },                       /* ELF executable and library. */
+    { 0, "MZ"sv },                               /* PE executable and library. */
+    { 0, "\xCF\xFA\xED\xFE"sv },                 /* Mach-O 64-bit. */
+    { 0, "\xCA\xFE\xBA\xBE"sv },                 /* Mach-O universal and Java class. */
+    { 0, "\0asm"sv },                            /* WebAssembly. */
+    { 0, "PK\x03\x04"sv },                       /* Zip, also jar, docx and apk. */
+    { 0, "\x1F\x8B"sv },                         /* Gzip. */
+    { 0, "\xFD" "7zXZ"sv },                      /* Xz. */
+    { 0, "\x28\xB5\x2F\xFD"sv },                 /* Zstandard. */
+    { 0, "7z\xBC\xAF\x27\x1C"sv },               /* 7-Zip. */
+    { 0, "Rar!\x1A\x07"sv },                     /* RAR. */
+    { 0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1"sv }, /* OLE compound file, e.g. msi and doc. */
+    { 0, "SQLite format 3"sv },                  /* SQLite database. */
+    { 0, "\x89PNG"sv },                          /* PNG. */
+    { 0, "\xFF\xD8\xFF"sv },                     /* JPEG. */
+    { 0, "GIF8"sv },                             /* GIF. */
+    { 0, "RIFF"sv },                             /* WAV, AVI and WebP. */
+    { 0, "OggS"sv },                             /* Ogg. */
+    { 0, "fLaC"sv },                             /* FLAC. */
+    { 0, "ID3"sv },                              /* MP3. */
+    { 4, "ftyp"sv },                             /* MP4 and QuickTime. */
+    { 0, "\x1A\x45\xDF\xA3"sv },                 /* Matroska and WebM. */
+    { 0, "QFI\xFB"sv },                          /* QEMU disk image. */
+    { 0, "KDMV"sv },                             /* VMware disk image. */
+    { 0, "vhdxfile"sv },                         /* Hyper-V disk image. */
+    { 0, "conectix"sv },                         /* Virtual PC disk image. */
+};
+
+struct TextPattern
+{
+    std::string bytes; /* Encoded pattern. */
+    size_t      id;    /* Index of the query term. */
+};
+typedef std::vector<TextPattern> TextPatternVec;
+
+struct TextMatcher::Data
+{
+    const TextQuery* query = nullptr;     /* Parsed query. */
+    Encoding         encoding;            /* Content encoding. */
+    SubstringSearch* matcher = nullptr;   /* Matcher if the query compiles into one pattern. */
+    size_t           matcher_id = 0;      /* Term index of the single pattern. */
+    AhoCorasick*     automaton = nullptr; /* Matcher for several patterns. */
+    Regex*           regex = nullptr;     /* Matcher of a regular expression query. */
+    size_t           min_length = 0;      /* Length of the shortest pattern. */
+    size_t           max_length = 0;      /* Length of the longest pattern. */
+};
+
+static std::string EncodeUtf16Le(const wxString& str)
+{
+    std::string ret;
+    auto        push = [&ret](uint32_t unit) {
+        ret.push_back(static_cast<char>(unit & 0xFF));
+        ret.push_back(static_cast<char>(unit >> 8));
+    };
+
+    for (wxString::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+        const uint32_t cp = static_cast<uint32_t>((*it).GetValue());
+        if (cp >= 0x10000)
+        {
+            push(0xD800 + ((cp - 0x10000) >> 10));
+            push(0xDC00 + ((cp - 0x10000) & 0x3FF));
+        }
+        else
+        {
+            push(cp);
+        }
+    }
+    return ret;
+}
+
+static std::string Encode(const wxString& str, TextMatcher::Encoding encoding)
+{
+    if (encoding == TextMatcher::Encoding::Utf16Le)
+    {
+        return EncodeUtf16Le(str);
+    }
+    return str.ToUTF8().data();
+}
+
+static size_t GetUnitSize(TextMatcher::Encoding encoding)
+{
+    return encoding == TextMatcher::Encoding::Utf16Le ? 2 : 1;
+}
+
+/**
+ * @brief Add the pattern unless it is the same as an added one after ASCII folding.
+ */
+static void AddTextPattern(TextPatternVec& patterns, const std::string& bytes, size_t id, bool ignore_case,
+                           size_t unit_size)
+{
+    auto fold = [ignore_case, unit_size](std::string s) {
+        for (size_t i = 0; ignore_case && i < s.size(); i += unit_size)
+        {
+            const bool ascii = unit_size == 1 || (i + 1 < s.size() && s[i + 1] == 0);
+            if (ascii && s[i] >= 'A' && s[i] <= 'Z')
+            {
+                s[i] = static_cast<char>(s[i] | 0x20);
+            }
+        }
+        return s;
+    };
+
+    const std::string key = fold(bytes);
+    for (const TextPattern& pattern : patterns)
+    {
+        if (pattern.id == id && fold(pattern.bytes) == key)
+        {
+            return;
+        }
+    }
+    patterns.push_back(TextPattern{ bytes, id });
+}
+
+/**
+ * @brief Expand every term into the byte patterns to search.
+ *
+ * ASCII letters are folded by the matchers themselves. Other letters are
+ * covered by adding the lower and upper case spelling of the whole term, so
+ * non-ASCII letters in mixed case, e.g. `Ärger` for `ärger`, are not found.
+ * Spelling every letter both ways would grow exponentially with the term.
+ */
+static TextPatternVec BuildTextPatterns(const TextQuery& query, TextMatcher::Encoding encoding, bool ignore_case)
+{
+    const size_t   unit_size = GetUnitSize(encoding);
+    TextPatternVec patterns;
+    for (size_t id = 0; id < query.terms.size(); id++)
+    {
+        const wxString term = wxString::FromUTF8(query.terms[id].c_str());
+        if (ignore_case)
+        {
+            AddTextPattern(patterns, Encode(term.Lower(), encoding), id, true, unit_size);
+            AddTextPattern(patterns, Encode(term.Upper(), encoding), id, true, unit_size);
+        }
+        else
+        {
+            AddTextPattern(patterns, Encode(term, encoding), id, false, unit_size);
+        }
+    }
+    return patterns;
+}
+
+TextMatcher::TextMatcher(const TextQuery& query, Encoding encoding, bool ignore_case)
+{
+    m_data = new Data;
+    m_data->query = &query;
+    m_data->encoding = encoding;
+
+    if (query.regex)
+    {
+        if (encoding == Encoding::Utf8)
+        {
+            m_data->regex = new Regex(query.terms[0], ignore_case);
+            m_data->min_length = m_data->regex->GetMinLength();
+            m_data->max_length = std::clamp<size_t>(m_data->regex->GetMaxLength(), 1, RegexMaxSpan) + 2;
+        }
+        return;
+    }
+
+    const TextPatternVec patterns = BuildTextPatterns(query, encoding, ignore_case);
+    for (size_t i = 0; i < patterns.size(); i++)
+    {
+        const size_t length = patterns[i].bytes.size();
+        m_data->min_length = i == 0 ? length : std::min(m_data->min_length, length);
+        m_data->max_length = std::max(m_data->max_length, length);
+    }
+
+    if (patterns.size() == 1)
+    {
+        const std::string& bytes = patterns[0].bytes;
+        m_data->matcher = new SubstringSearch(bytes.data(), bytes.size(), ignore_case, GetUnitSize(encoding));
+        m_data->matcher_id = patterns[0].id;
+    }
+    else if (patterns.size() > 1)
+    {
+        m_data->automaton = new AhoCorasick(ignore_case, GetUnitSize(encoding));
+        for (const TextPattern& pattern : patterns)
+        {
+            m_data->automaton->AddPattern(pattern.bytes.data(), pattern.bytes.size(), pattern.id);
+        }
+        m_data->automaton->Compile();
+    }
+}
+
+TextMatcher::~TextMatcher()
+{
+    delete m_data->matcher;
+    delete m_data->automaton;
+    delete m_data->regex;
+    delete m_data;
+}
+
+uint64_t TextMatcher::Search(const void* data, size_t size, uint64_t found, unsigned cut) const
+{
+    if (m_data->regex != nullptr)
+    {
+        return m_data->regex->Search(data, size, cut) ? found | 1 : found;
+    }
+    if (m_data->automaton != nullptr)
+    {
+        /* All patterns are searched in one pass, stop as soon as the query is satisfied. */
+        const TextQuery* query = m_data->query;
+        return m_data->automaton->Search(data, size, found,
+                                         [query](uint64_t mask) { return !query->IsSatisfied(mask); });
+    }
+    if (m_data->matcher != nullptr && m_data->matcher->Search(data, size).has_value())
+    {
+        return found | (static_cast<uint64_t>(1) << m_data->matcher_id);
+    }
+    return found;
+}
+
+std::optional<size_t> TextMatcher::Find(const void* data, size_t size, size_t from, size_t* length,
+                                        unsigned cut) const
+{
+    if (m_data->regex != nullptr)
+    {
+        return m_data->regex->Find(data, size, from, length, cut);
+    }
+
+    /* Literal patterns need no context. */
+    std::optional<size_t> found;
+    const uint8_t*        text = static_cast<const uint8_t*>(data) + from;
+    if (m_data->automaton != nullptr)
+    {
+        found = m_data->automaton->Find(text, size - from, length);
+    }
+    else if (m_data->matcher != nullptr)
+    {
+        *length = m_data->max_length;
+        found = m_data->matcher->Search(text, size - from);
+    }
+    if (found.has_value())
+    {
+        return from + found.value();
+    }
+    return std::nullopt;
+}
+
+TextMatcher::Encoding TextMatcher::GetEncoding() const
+{
+    return m_data->encoding;
+}
+
+size_t TextMatcher::GetMinLength() const
+{
+    return m_data->min_length;
+}
+
+size_t TextMatcher::GetMaxLength() const
+{
+    return m_data->max_length;
+}
+
+size_t TextMatcher::GetNextBlock(const void* data, size_t size) const
+{
+    const size_t overlap = m_data->max_length - 1;
+    const Regex* regex = m_data->regex;
+    if (regex == nullptr || regex->GetMaxLength() <= RegexMaxSpan || !regex->IsLineMode())
+    {
+        return size - overlap;
+    }
+
+    /* The next block starts at the line feed, which stays as context for `^` and `\b`. */
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = size - 1; i >= size / 2 && i > 0; i--)
+    {
+        if (p[i] == '\n')
+        {
+            return i;
+        }
+    }
+    return size - overlap;
+}
+
+TextMatcher::Encoding TextMatcher::DetectEncoding(const void* data, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    if (size >= 2 && p[0] == 0xFF && p[1] == 0xFE)
+    {
+        return Encoding::Utf16Le;
+    }
+
+    /* Without BOM, UTF-16LE text mostly in Latin script has zero in every odd byte and never in even bytes. */
+    size = std::min(size, EncodingProbeSize) & ~static_cast<size_t>(1);
+    size_t odd_zeros = 0;
+    for (size_t i = 0; i < size; i += 2)
+    {
+        if (p[i] == 0)
+        {
+            return Encoding::Utf8;
+        }
+        odd_zeros += p[i + 1] == 0;
+    }
+    return (size != 0 && odd_zeros * 4 >= size / 2 * 3) ? Encoding::Utf16Le : Encoding::Utf8;
+}
+
+bool TextMatcher::IsBinary(const void* data, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (const BinarySignature& signature : BinarySignatures)
+    {
+        const std::string_view& bytes = signature.bytes;
+        if (size >= signature.offset + bytes.size() && memcmp(p + signature.offset, bytes.data(), bytes.size()) == 0)
+        {
+            return true;
+        }
+    }
+
+    /* UTF-16 text has NUL bytes, it is left to the matcher of its encoding. */
+    if (DetectEncoding(data, size) == Encoding::Utf16Le)
+    {
+        return false;
+    }
+
+    /* Text never has NUL, and has few control bytes other than whitespace and escape. */
+    size = std::min(size, BinaryProbeSize);
+    size_t controls = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        const uint8_t c = p[i];
+        if (c == 0)
+        {
+            return true;
+        }
+        if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != '\b' && c != 0x1B)
+        {
+            controls++;
+        }
+    }
+    return controls * 10 > size;
+}
+
+size_t TextMatcher::CountNewlines(const void* data, size_t size, Encoding encoding)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const bool     utf16 = encoding == Encoding::Utf16Le;
+    size_t         count = 0;
+    size_t         i = 0;
+
+#if defined(LR_TEXT_MATCHER_SSE2)
+    /* A matching 16-bit lane sets two mask bits, a matching byte sets one. */
+    const __m128i lf = utf16 ? _mm_set1_epi16('\n') : _mm_set1_epi8('\n');
+    size_t        bits = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        const __m128i eq = utf16 ? _mm_cmpeq_epi16(v, lf) : _mm_cmpeq_epi8(v, lf);
+        bits += static_cast<size_t>(std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(eq))));
+    }
+    count = utf16 ? bits / 2 : bits;
+#endif
+
+    if (utf16)
+    {
+        for (; i + 2 <= size; i += 2)
+        {
+            count += p[i] == '\n' && p[i + 1] == 0;
+        }
+        return count;
+    }
+    for (; i < size; i++)
+    {
+        count += p[i] == '\n';
+    }
+    return count;
+}
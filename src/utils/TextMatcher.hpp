@@ -0,0 +1,124 @@
+#ifndef LAUNCHR_UTILS_TEXT_MATCHER_HPP
+#define LAUNCHR_UTILS_TEXT_MATCHER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include "Regex.hpp"
+#include "TextQuery.hpp"
+
+namespace LR
+{
+
+/**
+ * @brief Match a query against raw file content of one encoding.
+ *
+ * Query terms are compiled into byte patterns of the target encoding, case
+ * variants included, so the content is searched in place without decoding
+ * or lowering a copy of it. A regular expression query only matches UTF-8
+ * content.
+ */
+struct TextMatcher
+{
+    enum class Encoding : int
+    {
+        Utf8,    /* UTF-8, also covers ASCII. */
+        Utf16Le, /* UTF-16 little endian. */
+    };
+
+    /**
+     * @brief Compile query for the encoding.
+     * @param[in] query Parsed query, must outlive the matcher.
+     * @param[in] encoding Content encoding.
+     * @param[in] ignore_case Match letters in any case. Terms with non-ASCII letters only match all in
+     *   lowercase or all in uppercase, not in mixed case.
+     */
+    TextMatcher(const TextQuery& query, Encoding encoding, bool ignore_case);
+    TextMatcher(const TextMatcher&) = delete;
+    ~TextMatcher();
+
+    /**
+     * @brief Search query terms in the content. Safe to call from several threads.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @param[in] found Mask of terms found in previous blocks of the same file.
+     * @param[in] cut Regex::CutStart and Regex::CutEnd flags of the block edges.
+     * @return Mask of terms found, bit N for query.terms[N].
+     */
+    uint64_t Search(const void* data, size_t size, uint64_t found, unsigned cut = 0) const;
+
+    /**
+     * @brief Find the first occurrence of any query term. Safe to call from several threads.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @param[in] from Search starts at this position, the data before it is context.
+     * @param[out] length Byte length of the pattern found.
+     * @param[in] cut Regex::CutStart and Regex::CutEnd flags of the block edges.
+     * @return If found, return the matching start position in data. If not found, return null.
+     */
+    std::optional<size_t> Find(const void* data, size_t size, size_t from, size_t* length, unsigned cut = 0) const;
+
+    /**
+     * @brief Get the content encoding the query is compiled for.
+     */
+    Encoding GetEncoding() const;
+
+    /**
+     * @brief Get the byte length of the shortest pattern. Content shorter than this never matches.
+     */
+    size_t GetMinLength() const;
+
+    /**
+     * @brief Get the byte length of the longest pattern. Blocks must overlap by this minus one.
+     *
+     * For a regular expression it includes a byte of context on each side,
+     * and matches are assumed to be bounded, see GetNextBlock().
+     */
+    size_t GetMaxLength() const;
+
+    /**
+     * @brief Get where the next block of the content starts, so that no match is cut by both blocks.
+     *
+     * Blocks overlap by GetMaxLength() - 1. A regular expression that may match
+     * longer than that but never spans a line feed starts the next block at the
+     * last line feed of the second half instead, so its matches are only lost
+     * on lines longer than half a block.
+     *
+     * @param[in] data Block address.
+     * @param[in] size Block length, larger than GetMaxLength().
+     * @return Offset of the next block from the start of this one, greater than 0.
+     */
+    size_t GetNextBlock(const void* data, size_t size) const;
+
+    /**
+     * @brief Guess the encoding from the beginning of the content.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @return Content encoding.
+     */
+    static Encoding DetectEncoding(const void* data, size_t size);
+
+    /**
+     * @brief Guess from the beginning of the content if it is not text, e.g. an executable, archive or image.
+     * @param[in] data Data address.
+     * @param[in] size Data length.
+     * @return true if the content has a known binary signature, or NUL and control bytes of non-text.
+     */
+    static bool IsBinary(const void* data, size_t size);
+
+    /**
+     * @brief Count line feeds in the content.
+     * @param[in] data Data address, UTF-16LE content must start at a code unit boundary.
+     * @param[in] size Data length.
+     * @param[in] encoding Content encoding.
+     * @return Number of line feeds.
+     */
+    static size_t CountNewlines(const void* data, size_t size, Encoding encoding);
+
+    struct Data;
+    struct Data* m_data;
+};
+
+} // namespace LR
+
+#endif
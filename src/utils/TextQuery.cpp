@@ -0,0 +1,185 @@
+#include <wx/wx.h>
+#include <wx/log.h>
+#include <algorithm>
+#include "Regex.hpp"
+#include "TextQuery.hpp"
+
+using namespace LR;
+
+/* One bit is used for each term. */
+static const size_t MaxTerms = 64;
+
+/**
+ * @brief Add a term to the group.
+ * @return false if the term needs a bit beyond MaxTerms.
+ */
+static bool AddTerm(TextQuery* query, uint64_t& group, const wxString& term)
+{
+    if (term.empty())
+    {
+        return true;
+    }
+
+    const std::string utf8 = term.ToUTF8().data();
+    const auto        it = std::find(query->terms.begin(), query->terms.end(), utf8);
+    size_t            index = it - query->terms.begin();
+    if (it == query->terms.end())
+    {
+        if (query->terms.size() >= MaxTerms)
+        {
+            return false;
+        }
+        query->terms.push_back(utf8);
+    }
+
+    group |= static_cast<uint64_t>(1) << index;
+    return true;
+}
+
+static void AddGroup(TextQuery* query, uint64_t& group)
+{
+    if (group != 0)
+    {
+        query->groups.push_back(group);
+    }
+    group = 0;
+}
+
+TextQuery::TextQuery(const wxString& query)
+{
+    if (query.length() > 2 && query.StartsWith("/") && query.EndsWith("/"))
+    {
+        const std::string pattern = query.Mid(1, query.length() - 2).ToUTF8().data();
+        if (!Regex::Validate(pattern, &error))
+        {
+            wxLogWarning("Invalid regular expression `%s`: %s", query, error.c_str());
+            return;
+        }
+        terms.push_back(pattern);
+        groups.push_back(1);
+        regex = true;
+        return;
+    }
+
+    wxString term;
+    uint64_t group = 0;
+    bool     quoted = false;
+    bool     fits = true; /* Every term got a bit. */
+
+    for (wxString::const_iterator it = query.begin(); it != query.end(); ++it)
+    {
+        const wxUniChar c = *it;
+        if (c == '"')
+        {
+            fits = AddTerm(this, group, term) && fits;
+            term.clear();
+            quoted = !quoted;
+        }
+        else if (quoted)
+        {
+            term += c;
+        }
+        else if (c == '|')
+        {
+            fits = AddTerm(this, group, term) && fits;
+            term.clear();
+            AddGroup(this, group);
+        }
+        else if (wxIsspace(c))
+        {
+            fits = AddTerm(this, group, term) && fits;
+            term.clear();
+        }
+        else
+        {
+            term += c;
+        }
+    }
+    fits = AddTerm(this, group, term) && fits;
+    AddGroup(this, group);
+
+    /* Dropping a term would widen its group and match content without it, reject the query instead. */
+    if (!fits)
+    {
+        wxLogWarning("Too many query terms, at most %zu are supported", MaxTerms);
+        error = wxString::Format("too many terms, at most %zu are supported", MaxTerms).ToStdString();
+        terms.clear();
+        groups.clear();
+    }
+}
+
+static std::string FoldTerm(const std::string& term, bool ignore_case)
+{
+    std::string ret = term;
+    if (ignore_case)
+    {
+        /* Only ASCII is folded, so other letters in different case are conservatively seen as different. */
+        std::transform(ret.begin(), ret.end(), ret.begin(),
+                       [](char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c; });
+    }
+    return ret;
+}
+
+/**
+ * @brief Check if content that has all terms of the group also has all terms of the other group.
+ */
+static bool GroupImplies(const TextQuery& query, uint64_t group, const TextQuery& other, uint64_t other_group,
+                         bool ignore_case)
+{
+    for (size_t i = 0; i < other.terms.size(); i++)
+    {
+        if (!(other_group & (static_cast<uint64_t>(1) << i)))
+        {
+            continue;
+        }
+
+        /* A term is present if a longer term containing it is present. */
+        const std::string other_term = FoldTerm(other.terms[i], ignore_case);
+        bool              covered = false;
+        for (size_t j = 0; j < query.terms.size() && !covered; j++)
+        {
+            covered = (group & (static_cast<uint64_t>(1) << j)) &&
+                      FoldTerm(query.terms[j], ignore_case).find(other_term) != std::string::npos;
+        }
+        if (!covered)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TextQuery::IsSatisfied(uint64_t found) const
+{
+    for (uint64_t group : groups)
+    {
+        if ((found & group) == group)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TextQuery::Narrows(const TextQuery& other, bool ignore_case) const
+{
+    /* Containment of regular expressions is not worth deciding, only the same one narrows. */
+    if (regex || other.regex)
+    {
+        return regex && other.regex && terms == other.terms;
+    }
+
+    for (uint64_t group : groups)
+    {
+        bool covered = false;
+        for (size_t i = 0; i < other.groups.size() && !covered; i++)
+        {
+            covered = GroupImplies(*this, group, other, other.groups[i], ignore_case);
+        }
+        if (!covered)
+        {
+            return false;
+        }
+    }
+    return true;
+}
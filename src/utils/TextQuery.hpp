@@ -0,0 +1,53 @@
+#ifndef LAUNCHR_UTILS_TEXT_QUERY_HPP
+#define LAUNCHR_UTILS_TEXT_QUERY_HPP
+
+#include <wx/wx.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace LR
+{
+
+/**
+ * @brief Multi-term query.
+ *
+ * Terms separated by whitespace must all match, `|` separates alternatives
+ * and double quotes keep a phrase with spaces as one term. For example
+ * `foo "bar baz" | qux` matches content with both `foo` and `bar baz`, or with `qux`.
+ * A query written as `/pattern/` is a single regular expression instead.
+ * Content is searched block by block, so a match longer than 4 KiB is only
+ * found if it does not span a line feed and its line fits in half a block.
+ */
+struct TextQuery
+{
+    /**
+     * @brief Parse query string.
+     * @param[in] query Query string.
+     */
+    explicit TextQuery(const wxString& query);
+
+    /**
+     * @brief Check if the query is satisfied by the found terms.
+     * @param[in] found Mask of found terms, bit N for terms[N].
+     * @return true if matched.
+     */
+    bool IsSatisfied(uint64_t found) const;
+
+    /**
+     * @brief Check if all content matching this query also matches the other one.
+     * @param[in] other The other query.
+     * @param[in] ignore_case Terms are matched in any case.
+     * @return true if this query is narrower or the same.
+     */
+    bool Narrows(const TextQuery& other, bool ignore_case) const;
+
+    std::vector<std::string> terms;  /* Unique terms in UTF-8, at most 64, a query with more has none. */
+    std::vector<uint64_t>    groups; /* Alternatives, each is a mask of terms that must all be found. */
+    bool                     regex = false; /* The only term is a regular expression, see Regex. */
+    std::string              error;         /* Why the query was rejected and has no terms, empty if it parsed. */
+};
+
+} // namespace LR
+
+#endif
@@ -0,0 +1,220 @@
+#include <wx/wx.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "Trace.hpp"
+
+using namespace LR;
+typedef std::chrono::steady_clock Clock;
+
+/* Events kept per thread, later events are dropped. */
+static const size_t MaxThreadEvents = 1 << 18;
+
+struct TraceEvent
+{
+    const char* name;     /* Event name. */
+    uint64_t    start;    /* Start time in microseconds. */
+    uint64_t    duration; /* Duration in microseconds. */
+    const char* arg_name; /* Attached value name, nullptr if none. */
+    int64_t     arg;      /* Attached value. */
+};
+
+struct TraceBuffer
+{
+    std::mutex              mutex;  /* Guard for events and name, only contended while saving. */
+    std::vector<TraceEvent> events; /* Recorded events. */
+    const char*             name;   /* Thread name, nullptr if not named. */
+    uint32_t                tid;    /* Thread id in the timeline. */
+};
+
+typedef std::shared_ptr<TraceBuffer> TraceBufferPtr;
+
+struct TraceContext
+{
+    std::atomic<bool>           enabled;  /* Recording flag. */
+    std::mutex                  mutex;    /* Guard for buffers and next_tid. */
+    std::vector<TraceBufferPtr> buffers;  /* Buffers of live threads, and of threads exited since Clear(). */
+    uint32_t                    next_tid; /* Next thread id. */
+    Clock::time_point           epoch;    /* Time origin. */
+};
+
+static TraceContext& GetTraceContext()
+{
+    /* Never destroyed, threads may still record while static objects are torn down. */
+    static TraceContext* ctx = []() {
+        TraceContext* ctx = new TraceContext;
+        ctx->enabled = false;
+        ctx->next_tid = 1;
+        ctx->epoch = Clock::now();
+        return ctx;
+    }();
+    return *ctx;
+}
+
+static uint64_t GetTraceTime()
+{
+    const auto elapsed = Clock::now() - GetTraceContext().epoch;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+/**
+ * @brief Get the buffer of the calling thread, registered on first use.
+ */
+static TraceBuffer* GetTraceBuffer()
+{
+    /* The registry keeps the buffer once the thread exits, until the next Clear(). */
+    thread_local TraceBufferPtr buffer;
+    if (buffer == nullptr)
+    {
+        buffer = std::make_shared<TraceBuffer>();
+        buffer->name = nullptr;
+
+        TraceContext&               ctx = GetTraceContext();
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        buffer->tid = ctx.next_tid++;
+        ctx.buffers.push_back(buffer);
+    }
+    return buffer.get();
+}
+
+bool Trace::IsEnabled()
+{
+    return GetTraceContext().enabled.load(std::memory_order_relaxed);
+}
+
+void Trace::SetEnabled(bool enabled)
+{
+    GetTraceContext().enabled = enabled;
+}
+
+void Trace::SetThreadName(const char* name)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    TraceBuffer*                buffer = GetTraceBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->name = name;
+}
+
+void Trace::Clear()
+{
+    TraceContext&               ctx = GetTraceContext();
+    std::lock_guard<std::mutex> lock(ctx.mutex);
+    for (auto it = ctx.buffers.begin(); it != ctx.buffers.end();)
+    {
+        /* Buffers of exited threads are released, live threads keep theirs. */
+        if (it->use_count() == 1)
+        {
+            it = ctx.buffers.erase(it);
+            continue;
+        }
+
+        std::lock_guard<std::mutex> buffer_lock((*it)->mutex);
+        (*it)->events.clear();
+        ++it;
+    }
+}
+
+bool Trace::Save(const wxString& path)
+{
+    nlohmann::json events = nlohmann::json::array();
+    {
+        TraceContext&               ctx = GetTraceContext();
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        for (const TraceBufferPtr& buffer : ctx.buffers)
+        {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            if (buffer->name != nullptr)
+            {
+                events.push_back({
+                    { "name", "thread_name" },
+                    { "ph", "M" },
+                    { "pid", 1 },
+                    { "tid", buffer->tid },
+                    { "args", { { "name", buffer->name } } },
+                });
+            }
+            for (const TraceEvent& event : buffer->events)
+            {
+                nlohmann::json item = {
+                    { "name", event.name },
+                    { "ph", "X" },
+                    { "ts", event.start },
+                    { "dur", event.duration },
+                    { "pid", 1 },
+                    { "tid", buffer->tid },
+                };
+                if (event.arg_name != nullptr)
+                {
+                    item["args"] = { { event.arg_name, event.arg } };
+                }
+                events.push_back(item);
+            }
+        }
+    }
+
+    wxFileName f(path);
+    if (!f.DirExists() && !f.Mkdir(wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+    {
+        wxLogWarning("Failed to create directory: %s", path);
+        return false;
+    }
+
+    const nlohmann::json json = {
+        { "traceEvents", events },
+        { "displayTimeUnit", "ms" },
+    };
+    const std::string content = json.dump();
+    wxFile            file;
+    if (!file.Open(path, wxFile::write) || file.Write(content.data(), content.size()) != content.size())
+    {
+        wxLogWarning("Failed to write trace: %s", path);
+        return false;
+    }
+    return true;
+}
+
+TraceScope::TraceScope(const char* name)
+{
+    this->name = Trace::IsEnabled() ? name : nullptr;
+    this->start = this->name != nullptr ? GetTraceTime() : 0;
+    this->arg_name = nullptr;
+    this->arg = 0;
+}
+
+TraceScope::~TraceScope()
+{
+    if (name == nullptr)
+    {
+        return;
+    }
+
+    TraceEvent event;
+    event.name = name;
+    event.start = start;
+    event.duration = GetTraceTime() - start;
+    event.arg_name = arg_name;
+    event.arg = arg;
+
+    TraceBuffer*                buffer = GetTraceBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    if (buffer->events.size() < MaxThreadEvents)
+    {
+        buffer->events.push_back(event);
+    }
+}
+
+void TraceScope::SetArg(const char* key, int64_t value)
+{
+    arg_name = key;
+    arg = value;
+}
@@ -0,0 +1,76 @@
+#ifndef LAUNCHR_UTILS_TRACE_HPP
+#define LAUNCHR_UTILS_TRACE_HPP
+
+#include <wx/string.h>
+#include <cstdint>
+
+namespace LR
+{
+
+/**
+ * @brief Timeline of scoped events, saved in Chrome trace format.
+ *
+ * Every thread records into its own buffer, so tracing does not serialize
+ * the pipeline. While disabled a scope costs one relaxed atomic load. The
+ * file can be opened with chrome://tracing or https://ui.perfetto.dev.
+ */
+struct Trace
+{
+    /**
+     * @brief Check if events are recorded.
+     */
+    static bool IsEnabled();
+
+    /**
+     * @brief Start or stop recording.
+     */
+    static void SetEnabled(bool enabled);
+
+    /**
+     * @brief Name the calling thread in the timeline.
+     * @param[in] name Thread name, must be a string literal.
+     */
+    static void SetThreadName(const char* name);
+
+    /**
+     * @brief Drop recorded events, a new timeline starts.
+     */
+    static void Clear();
+
+    /**
+     * @brief Save events recorded since Clear().
+     * @param[in] path File path, its directory is created if needed.
+     * @return true if saved.
+     */
+    static bool Save(const wxString& path);
+};
+
+/**
+ * @brief Record the lifetime of the scope as one event.
+ */
+struct TraceScope
+{
+    /**
+     * @brief Start the event.
+     * @param[in] name Event name, must be a string literal.
+     */
+    explicit TraceScope(const char* name);
+    TraceScope(const TraceScope&) = delete;
+    ~TraceScope();
+
+    /**
+     * @brief Attach a value to the event, e.g. a size or a count.
+     * @param[in] key Value name, must be a string literal.
+     * @param[in] value Value.
+     */
+    void SetArg(const char* key, int64_t value);
+
+    const char* name;     /* Event name, nullptr if tracing is disabled. */
+    uint64_t    start;    /* Start time in microseconds. */
+    const char* arg_name; /* Attached value name, nullptr if none. */
+    int64_t     arg;      /* Attached value. */
+};
+
+} // namespace LR
+
+#endif
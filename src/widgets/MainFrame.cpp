@@ -2,29 +2,42 @@
 #include <wx/listctrl.h>
 #include <wx/srchctrl.h>
 #include <wx/aboutdlg.h>
+#include <wx/datetime.h>
+#include <wx/dir.h>
+#include <wx/filename.h>
 #include <atomic>
 #include <chrono>
 #include <thread>
 #include "utils/OpenFile.hpp"
+#include "utils/QueryMetrics.hpp"
+#include "utils/Trace.hpp"
 #include "LaunchR.hpp"
 #include "ResultListCtrl.hpp"
 #include "MainFrame.hpp"
 
 using namespace LR;
-typedef std::list<Searcher::IteratorPtr> IteratorList;
+typedef std::list<size_t>                  IteratorList;
+typedef std::vector<Searcher::IteratorPtr> IteratorVec;
 
 wxDEFINE_EVENT(LR_MAINFRAME_UPDATE_STATUSBAR_OBJECT_COUNT, wxCommandEvent);
 wxDEFINE_EVENT(LR_MAINFRAME_UPDATE_STATUSBAR_SEARCHING_STATUS, wxCommandEvent);
 
 struct QueryTask
 {
-    QueryTask(MainFrame::Data* frame, const wxString& query);
+    QueryTask(MainFrame::Data* frame, const wxString& query, uint64_t generation,
+              std::shared_ptr<QueryTask> previous);
     ~QueryTask();
 
-    MainFrame::Data*  frame;
-    wxString          query;
-    std::atomic<bool> flag_running = true;
-    std::thread       thread;
+    MainFrame::Data*           frame;
+    Searcher::NotifierPtr      notifier;   /* Woken by the iterators, and by cancellation. */
+    wxString                   query;
+    Searcher::QueryPtr         compiled;   /* Query parsed once by the task thread, shared by all searchers. */
+    uint64_t                   generation; /* Result list generation. */
+    std::shared_ptr<QueryTask> previous;   /* Stopped query narrowed by this one, taken over by the task thread. */
+    IteratorVec                iterators;  /* One iterator for each searcher, in the same order. */
+    QueryMetrics               metrics;    /* Timing and work of every searcher, task thread only. */
+    std::atomic<bool>          flag_running = true;
+    std::thread                thread;
 };
 
 struct MainFrame::Data
@@ -42,6 +55,7 @@ struct MainFrame::Data
     MainFrame*                 owner;
     wxSearchCtrl*              search_ctrl;
     ResultListCtrl*            result_list;
+    Searcher::NotifierPtr      notifier; /* Shared by all queries, refined iterators keep notifying it. */
     std::shared_ptr<QueryTask> query_task;
 };
 
@@ -59,42 +73,149 @@ static void UpdateStatusBarObjectCount(struct MainFrame* frame, int count)
     wxQueueEvent(frame, e);
 }
 
+/**
+ * @brief Take over the iterators of the previous query, once its thread is gone.
+ */
+static void TakeOverPreviousTask(struct QueryTask* task)
+{
+    if (task->previous == nullptr)
+    {
+        return;
+    }
+
+    /* It is already asked to stop, so the wait is short and happens off the UI thread. */
+    task->previous->thread.join();
+    task->iterators = std::move(task->previous->iterators);
+    task->previous.reset();
+}
+
+/**
+ * @brief Write timing and work of a finished query to the log.
+ */
+static void LogQueryMetrics(struct QueryTask* task)
+{
+    const QueryMetrics& metrics = task->metrics;
+    wxLogMessage("Query `%s`: %zu results. %s", task->query, metrics.GetResults(), metrics.FormatSummary());
+    for (size_t i = 0; i < metrics.sources.size(); i++)
+    {
+        wxLogMessage("    %s", metrics.FormatSource(i));
+    }
+}
+
+/* Query traces kept in the data directory, older ones are removed. */
+static const size_t MaxQueryTraces = 32;
+
+/**
+ * @brief Remove the oldest query traces, so that at most MaxQueryTraces are left.
+ */
+static void RemoveOldQueryTraces(const wxString& dir)
+{
+    wxDir d(dir);
+    if (!d.IsOpened())
+    {
+        return;
+    }
+
+    wxArrayString names;
+    wxString      name;
+    bool          cont = d.GetFirst(&name, "query-*.json", wxDIR_FILES);
+    while (cont)
+    {
+        names.Add(name);
+        cont = d.GetNext(&name);
+    }
+
+    /* Names start with the time the trace was saved, so the oldest sort first. */
+    names.Sort();
+    for (size_t i = 0; i + MaxQueryTraces < names.size(); i++)
+    {
+        wxRemoveFile(dir + wxFileName::GetPathSeparator() + names[i]);
+    }
+}
+
+/**
+ * @brief Save the timeline of a finished query to the data directory.
+ */
+static void SaveQueryTrace()
+{
+    const wxString dir = LaunchRApp::GenDataPath("traces");
+    const wxString name = wxDateTime::UNow().Format("query-%Y%m%d-%H%M%S-%l.json");
+    const wxString path = dir + wxFileName::GetPathSeparator() + name;
+    if (Trace::Save(path))
+    {
+        wxLogVerbose("Query trace saved to %s", path);
+        RemoveOldQueryTraces(dir);
+    }
+}
+
 static void QueryTaskThread(struct QueryTask* task)
 {
+    /* Every query starts a new timeline. */
+    if (Trace::IsEnabled())
+    {
+        Trace::Clear();
+        Trace::SetThreadName("Query task");
+    }
+
+    {
+        TraceScope scope("Take over previous query");
+        TakeOverPreviousTask(task);
+    }
+
+    {
+        TraceScope scope("Compile query");
+        task->compiled = std::make_shared<const SearchQuery>(task->query);
+    }
+
+    /* Refine the iterators of the previous query if possible, it saves searching everything again. */
+    const std::vector<Searcher*>& searchers = wxGetApp().searchers;
+    for (size_t i = 0; i < searchers.size() && task->flag_running; i++)
+    {
+        TraceScope scope("Start searcher");
+        if (i >= task->iterators.size())
+        {
+            task->iterators.push_back(searchers[i]->Query(task->compiled, task->notifier));
+        }
+        else if (task->iterators[i] == nullptr || !task->iterators[i]->Refine(task->compiled))
+        {
+            task->iterators[i] = searchers[i]->Query(task->compiled, task->notifier);
+        }
+    }
+
+    /* Refined iterators carry the counters of the previous query, only the difference is reported. */
     IteratorList iterators;
-    for (auto& searcher : wxGetApp().searchers)
+    for (size_t i = 0; i < task->iterators.size(); i++)
     {
-        iterators.push_back(searcher->Query(task->query));
+        iterators.push_back(task->metrics.AddSource(searchers[i]->GetName(), task->iterators[i]->GetCounters()));
     }
     UpdateStatusBarSearchingStatus(task->frame->owner, "Searching...");
 
-    auto start_time = std::chrono::steady_clock::now();
+    const std::chrono::milliseconds refresh_interval(100);
+    auto                            start_time = std::chrono::steady_clock::now();
+    bool                            ui_dirty = false;
     while (task->flag_running && !iterators.empty())
     {
-        size_t                 append_count = 0;
+        /* Read the epoch before fetching, so anything published meanwhile ends the wait below. */
+        const uint64_t epoch = task->notifier->GetEpoch();
+
         IteratorList::iterator it = iterators.begin();
         while (it != iterators.end() && task->flag_running)
         {
-            Searcher::ResultVariant ret_v;
-            while (std::holds_alternative<Searcher::Result>(ret_v = (*it)->Next()))
+            const Searcher::IteratorPtr& iterator = task->iterators[*it];
+            Searcher::ResultBatch        batch;
+            Searcher::ResultCode         code = iterator->Fetch(batch);
+            task->metrics.OnResults(*it, batch.size(), iterator->GetCounters());
+            if (!batch.empty())
             {
-                Searcher::Result ret = std::get<Searcher::Result>(ret_v);
-                task->frame->result_list->Append(ret);
-                append_count++;
-
-                auto now_time = std::chrono::steady_clock::now();
-                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now_time - start_time);
-                if (duration.count() > 100)
-                {
-                    task->frame->result_list->UpdateUI();
-                    UpdateStatusBarObjectCount(task->frame->owner, task->frame->result_list->GetCount());
-                    start_time = now_time;
-                }
+                TraceScope scope("Append results");
+                scope.SetArg("results", static_cast<int64_t>(batch.size()));
+                task->frame->result_list->Append(std::move(batch), task->generation);
+                ui_dirty = true;
             }
 
-            Searcher::ResultCode code = std::get<Searcher::ResultCode>(ret_v);
             if (code == Searcher::ResultCode::End)
             {
+                task->metrics.OnFinished(*it, iterator->GetCounters());
                 IteratorList::iterator it_tmp = it;
                 ++it;
                 iterators.erase(it_tmp);
@@ -104,32 +225,88 @@ static void QueryTaskThread(struct QueryTask* task)
             ++it;
         }
 
-        if (append_count == 0)
+        auto now_time = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now_time - start_time);
+        if (ui_dirty && duration >= refresh_interval)
+        {
+            task->frame->result_list->UpdateUI();
+            UpdateStatusBarObjectCount(task->frame->owner, task->frame->result_list->GetCount());
+            start_time = now_time;
+            ui_dirty = false;
+        }
+
+        if (!task->flag_running || iterators.empty())
+        {
+            break;
+        }
+
+        /* Sleep until results or completion arrive, but wake up in time to show pending results. */
+        TraceScope scope("Wait for results");
+        if (ui_dirty)
+        {
+            task->notifier->WaitFor(epoch, refresh_interval - duration);
+        }
+        else
         {
-            wxThread::Sleep(10);
+            task->notifier->Wait(epoch);
         }
     }
 
+    if (!task->flag_running)
+    {
+        /* Cancelled, the new query owns the result list and status bar. */
+        return;
+    }
     if (iterators.empty())
     {
-        UpdateStatusBarSearchingStatus(task->frame->owner, "");
+        LogQueryMetrics(task);
+        /* An invalid filter matches nothing, say why instead of showing an empty list. */
+        const bool show_metrics = wxGetApp().settings->Get().ShowQueryMetrics;
+        wxString   status = show_metrics ? task->metrics.FormatSummary() : wxString("");
+        if (!task->compiled->IsValid())
+        {
+            status = wxString::Format(_("Invalid filter `%s`"), task->compiled->error);
+        }
+        UpdateStatusBarSearchingStatus(task->frame->owner, status);
     }
 
     task->frame->result_list->UpdateUI();
     UpdateStatusBarObjectCount(task->frame->owner, task->frame->result_list->GetCount());
+
+    if (iterators.empty() && Trace::IsEnabled())
+    {
+        SaveQueryTrace();
+    }
 }
 
-QueryTask::QueryTask(MainFrame::Data* frame, const wxString& query)
+QueryTask::QueryTask(MainFrame::Data* frame, const wxString& query, uint64_t generation,
+                     std::shared_ptr<QueryTask> previous)
 {
     this->query = query;
     this->frame = frame;
+    this->notifier = frame->notifier;
+    this->generation = generation;
+    this->previous = std::move(previous);
     thread = std::thread(QueryTaskThread, this);
 }
 
 QueryTask::~QueryTask()
 {
     flag_running = false;
-    thread.join();
+    notifier->Notify();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+
+    /* Let all iterators stop in parallel before waiting for each of them. */
+    for (auto& it : iterators)
+    {
+        if (it != nullptr)
+        {
+            it->Cancel();
+        }
+    }
 }
 
 /**
@@ -139,14 +316,28 @@ QueryTask::~QueryTask()
  */
 static void UpdateResults(MainFrame::Data* data, const wxString& query)
 {
-    /* Stop the previous query. */
-    data->query_task.reset();
+    /*
+     * Stop the previous query without waiting for it. If the new query narrows
+     * it the new task takes over its iterators, otherwise it is destroyed in
+     * background.
+     */
+    std::shared_ptr<QueryTask> previous = std::move(data->query_task);
+    if (previous != nullptr)
+    {
+        previous->flag_running = false;
+        data->notifier->Notify();
+        if (!query.Contains(previous->query))
+        {
+            wxGetApp().reaper->Dispose(std::move(previous));
+            previous = nullptr;
+        }
+    }
 
-    /* Clear results. */
-    data->result_list->Clear();
+    /* Clear results, refined iterators return the ones still matching again. */
+    const uint64_t generation = data->result_list->Clear();
 
     /* Start a new query. */
-    data->query_task = std::make_shared<QueryTask>(data, query);
+    data->query_task = std::make_shared<QueryTask>(data, query, generation, std::move(previous));
 }
 
 static void CreateMenuBar(MainFrame::Data* data)
@@ -169,6 +360,7 @@ static void CreateMenuBar(MainFrame::Data* data)
 MainFrame::Data::Data(MainFrame* owner)
 {
     this->owner = owner;
+    this->notifier = std::make_shared<Notifier>();
 
     /* Menubar. */
     CreateMenuBar(this);
@@ -207,6 +399,9 @@ MainFrame::Data::~Data()
 {
     /* manually stop to avoid multithreaded competition. */
     query_task.reset();
+
+    /* Cancelled queries may still be appending to the result list. */
+    wxGetApp().reaper->Flush();
 }
 
 void MainFrame::Data::OnExit(wxCommandEvent&)
@@ -1,71 +1,133 @@
 #include <wx/wx.h>
 #include <wx/filename.h>
-#include <wx/mimetype.h>
+#include <algorithm>
 #include <mutex>
 #include <vector>
 #include <variant>
 #include <map>
 #include <thread>
 #include <semaphore>
+#include "utils/AppendOnlyVector.hpp"
+#include "utils/IconCache.hpp"
+#include "utils/ResultStore.hpp"
+#include "utils/Trace.hpp"
+#include "LaunchR.hpp"
 #include "ResultListCtrl.hpp"
 
 using namespace LR;
 
-typedef std::map<std::wstring, int> IconMap;
+typedef std::map<std::wstring, int>       IconMap;
+typedef std::vector<ResultStore::Id>      IdVec;
+typedef AppendOnlyVector<ResultStore::Id> IdList;
+
+/**
+ * @brief Number of rows kept in score order at the top of the list.
+ */
+static const size_t RankedRows = 1000;
+
+/**
+ * @brief Number of icons resolved on the UI thread before other events are handled.
+ */
+static const size_t IconsPerResolve = 8;
 
 wxDEFINE_EVENT(LR_RESULT_LIST_UPDATE, wxCommandEvent);
+wxDEFINE_EVENT(LR_RESULT_LIST_ICONS_READY, wxCommandEvent);
+wxDEFINE_EVENT(LR_RESULT_LIST_RESOLVE_ICONS, wxCommandEvent);
 
 struct ResultListCtrl::Data
 {
     Data(ResultListCtrl* owner);
+    ~Data();
     void OnUpdateUI(wxCommandEvent&);
+    void OnIconsReady(wxCommandEvent&);
+    void OnResolveIcons(wxCommandEvent&);
 
     ResultListCtrl* owner;
     int             icon_width = 16;
     int             icon_height = 16;
 
-    std::mutex result_mutex; /* Mutex for content list. */
-    ResultVec  results;      /* Content list. */
-
-    wxImageList* icon_list; /* Image list for icons, working in UI thread. */
-    IconMap      icon_map;  /* File icon and index. Key=ext(or path), value=index. */
+    /*
+     * Writers append under result_mutex. The UI thread reads published
+     * results without locking, it only locks to take the ranked snapshot.
+     */
+    std::mutex  result_mutex;   /* Serializes writers, guard for generation and ranked. */
+    ResultStore results;        /* Content list, in arrival order. */
+    uint64_t    generation = 0; /* Increased on every clear. */
+    IdVec       ranked;         /* Heap of the best RankedRows results, the worst one on top. */
+    IdList      unranked;       /* Results pushed out of or never entering the heap, in arrival order. */
+    IdVec       rows;           /* Snapshot of ranked in score order, shown first. UI thread only. */
+    size_t      row_count = 0;  /* Rows shown, those beyond the snapshot come from unranked. UI thread only. */
+
+    wxImageList* icon_list;  /* Image list for icons, working in UI thread. */
+    IconMap      icon_map;   /* File icon and index. Key=ext(or path), value=index. */
+    IconCache*   icon_cache; /* Rescales and caches icons in background. */
+    bool         resolving;  /* LR_RESULT_LIST_RESOLVE_ICONS is queued. UI thread only. */
 };
 
 ResultListCtrl::Data::Data(ResultListCtrl* owner)
 {
     this->owner = owner;
+    this->resolving = false;
+
+    /* Called on the loader thread, the rows are repainted on the UI thread. */
+    icon_cache = new IconCache(icon_width, icon_height, [owner]() {
+        wxCommandEvent* e = new wxCommandEvent(LR_RESULT_LIST_ICONS_READY);
+        wxQueueEvent(owner, e);
+    });
+}
+
+ResultListCtrl::Data::~Data()
+{
+    delete icon_cache;
+}
+
+/**
+ * @brief Check if result a ranks before result b. Equal scores keep the arrival order.
+ */
+static bool RanksBefore(const ResultListCtrl::Data* data, ResultStore::Id a, ResultStore::Id b)
+{
+    const int score_a = data->results.GetScore(a);
+    const int score_b = data->results.GetScore(b);
+    return score_a > score_b || (score_a == score_b && a < b);
 }
 
-static wxIcon GetSystemIconForExtension(const wxString& ext)
+/**
+ * @brief Offer a new result to the top-K heap. Caller holds result_mutex.
+ */
+static void RankResult(ResultListCtrl::Data* data, ResultStore::Id id)
 {
-    std::unique_ptr<wxFileType> fileType(wxTheMimeTypesManager->GetFileTypeFromExtension(ext));
-    if (fileType == nullptr)
+    auto cmp = [data](ResultStore::Id a, ResultStore::Id b) { return RanksBefore(data, a, b); };
+    if (data->ranked.size() < RankedRows)
     {
-        return wxNullIcon;
+        data->ranked.push_back(id);
+        std::push_heap(data->ranked.begin(), data->ranked.end(), cmp);
+        return;
     }
-
-    wxIconLocation iconPath;
-    if (!fileType->GetIcon(&iconPath))
+    if (!RanksBefore(data, id, data->ranked.front()))
     {
-        return wxNullIcon;
+        data->unranked.PushBack(id);
+        return;
     }
-    return wxIcon(iconPath);
+
+    std::pop_heap(data->ranked.begin(), data->ranked.end(), cmp);
+    data->unranked.PushBack(data->ranked.back());
+    data->ranked.back() = id;
+    std::push_heap(data->ranked.begin(), data->ranked.end(), cmp);
 }
 
-static wxIcon ResizeIcon(const wxIcon& icon, int width, int height)
+/**
+ * @brief Get id of the result shown at the given row. UI thread only, no lock is taken.
+ */
+static ResultStore::Id GetRowId(const ResultListCtrl::Data* data, long item)
 {
-    wxBitmap bmp;
-    bmp.CopyFromIcon(icon);
-
-    wxImage img = bmp.ConvertToImage();
-    img.Rescale(width, height);
-
-    wxBitmap scaledBmp(img);
-
-    wxIcon newIcon;
-    newIcon.CopyFromBitmap(scaledBmp);
+    if (item < 0 || static_cast<size_t>(item) >= data->row_count)
+    {
+        return ResultStore::InvalidId;
+    }
 
-    return newIcon;
+    /* The snapshot never covers more unranked results than were published. */
+    const size_t row = static_cast<size_t>(item);
+    return row < data->rows.size() ? data->rows[row] : data->unranked[row - data->rows.size()];
 }
 
 ResultListCtrl::ResultListCtrl(wxWindow* parent)
@@ -80,7 +142,17 @@ ResultListCtrl::ResultListCtrl(wxWindow* parent)
     InsertColumn(0, _("Name"), wxLIST_FORMAT_LEFT, 200);
     InsertColumn(1, _("Path"), wxLIST_FORMAT_LEFT, 350);
 
+    /* Only text search with line reporting fills these. */
+    const Settings& settings = wxGetApp().settings->Get();
+    if (settings.TextSupport && settings.TextMatchesPerFile != 0)
+    {
+        InsertColumn(2, _("Line"), wxLIST_FORMAT_RIGHT, 60);
+        InsertColumn(3, _("Content"), wxLIST_FORMAT_LEFT, 400);
+    }
+
     Bind(LR_RESULT_LIST_UPDATE, &Data::OnUpdateUI, m_data);
+    Bind(LR_RESULT_LIST_ICONS_READY, &Data::OnIconsReady, m_data);
+    Bind(LR_RESULT_LIST_RESOLVE_ICONS, &Data::OnResolveIcons, m_data);
 }
 
 ResultListCtrl::~ResultListCtrl()
@@ -88,20 +160,41 @@ ResultListCtrl::~ResultListCtrl()
     delete m_data;
 }
 
-void ResultListCtrl::Clear()
+uint64_t ResultListCtrl::Clear()
 {
+    uint64_t generation;
     {
         std::lock_guard<std::mutex> lock(m_data->result_mutex);
-        m_data->results.clear();
+        m_data->results.Clear();
+        m_data->ranked.clear();
+        m_data->unranked.Clear();
+        m_data->rows.clear();
+        m_data->row_count = 0;
+        generation = ++m_data->generation;
     }
 
     UpdateUI();
+    return generation;
 }
 
-void ResultListCtrl::Append(const LR::Searcher::Result& result)
+void ResultListCtrl::Append(LR::Searcher::ResultBatch&& batch, uint64_t generation)
 {
+    /* A cancelled query may still be running, its results must not leak into the new list. */
     std::lock_guard<std::mutex> lock(m_data->result_mutex);
-    m_data->results.push_back(result);
+    if (generation != m_data->generation)
+    {
+        return;
+    }
+
+    for (const Searcher::Result& result : batch)
+    {
+        const ResultStore::Id id = m_data->results.Add(result);
+        if (id == ResultStore::InvalidId)
+        {
+            break;
+        }
+        RankResult(m_data, id);
+    }
 }
 
 void ResultListCtrl::UpdateUI()
@@ -112,75 +205,63 @@ void ResultListCtrl::UpdateUI()
 
 size_t ResultListCtrl::GetCount() const
 {
-    std::lock_guard<std::mutex> lock(m_data->result_mutex);
-    return m_data->results.size();
+    return m_data->results.GetCount();
 }
 
 wxString ResultListCtrl::OnGetItemText(long item, long column) const
 {
-    Searcher::Result ret;
+    const ResultStore::Id id = GetRowId(m_data, item);
+    if (id == ResultStore::InvalidId)
     {
-        std::lock_guard<std::mutex> lock(m_data->result_mutex);
-        if (item >= static_cast<long>(m_data->results.size()))
-        {
-            return "";
-        }
-        ret = m_data->results[item];
+        return "";
     }
 
     switch (column)
     {
     case 0:
-        return ret.title;
+        return m_data->results.GetTitle(id);
     case 1:
-        return ret.path.has_value() ? ret.path.value() : wxString("");
+        return m_data->results.GetPath(id).value_or(wxString(""));
+    case 2: {
+        const std::optional<Searcher::Match> match = m_data->results.GetMatch(id);
+        return match ? wxString::Format("%llu", static_cast<unsigned long long>(match->line)) : wxString("");
+    }
+    case 3: {
+        const std::optional<Searcher::Match> match = m_data->results.GetMatch(id);
+        return match ? match->snippet : wxString("");
+    }
     default:
         break;
     }
     return "";
 }
 
-static int GetImageForExe(ResultListCtrl::Data* data, const wxString& path)
+/**
+ * @brief Get image list index of the icon. Icons still loading are shown once the loader notifies.
+ */
+static int GetImage(ResultListCtrl::Data* data, const wxString& key, bool executable)
 {
-    std::wstring      wpath = path.ToStdWstring();
-    IconMap::iterator it = data->icon_map.find(wpath);
+    std::wstring      wkey = key.ToStdWstring();
+    IconMap::iterator it = data->icon_map.find(wkey);
     if (it != data->icon_map.end())
     {
         return it->second;
     }
 
-    wxIcon icon(path, wxBITMAP_TYPE_ICO);
-    if (!icon.IsOk())
+    wxImage image;
+    if (!data->icon_cache->Lookup(key, executable, &image))
     {
-        data->icon_map.insert(IconMap::value_type(wpath, -1));
+        /* Resolve after painting, not while the list asks for rows. */
+        if (!data->resolving)
+        {
+            data->resolving = true;
+            wxQueueEvent(data->owner, new wxCommandEvent(LR_RESULT_LIST_RESOLVE_ICONS));
+        }
         return -1;
     }
 
-    icon = ResizeIcon(icon, data->icon_width, data->icon_height);
-    int idx = data->icon_list->Add(icon);
-    data->icon_map.insert(IconMap::value_type(wpath, idx));
-
-    return idx;
-}
-
-static int GetImageForFile(ResultListCtrl::Data* data, const wxString& ext)
-{
-    /* Search for icon in image list. */
-    std::wstring      wext = ext.ToStdWstring();
-    IconMap::iterator it = data->icon_map.find(wext);
-    if (it != data->icon_map.end())
-    {
-        return it->second;
-    }
-
-    int    idx = -1;
-    wxIcon icon = GetSystemIconForExtension(ext);
-    if (icon.IsOk())
-    {
-        icon = ResizeIcon(icon, data->icon_width, data->icon_height);
-        idx = data->icon_list->Add(icon);
-    }
-    data->icon_map.insert(IconMap::value_type(wext, idx));
+    int idx = image.IsOk() ? data->icon_list->Add(wxBitmap(image)) : -1;
+    data->icon_map.insert(IconMap::value_type(wkey, idx));
     return idx;
 }
 
@@ -191,21 +272,18 @@ int ResultListCtrl::OnGetItemColumnImage(long item, long column) const
         return -1;
     }
 
-    Searcher::Result ret;
+    const ResultStore::Id id = GetRowId(m_data, item);
+    if (id == ResultStore::InvalidId)
     {
-        std::lock_guard<std::mutex> lock(m_data->result_mutex);
-        if (item >= static_cast<long>(m_data->results.size()))
-        {
-            return -1;
-        }
-        ret = m_data->results[item];
+        return -1;
     }
 
-    if (!ret.path)
+    const std::optional<wxString> ret = m_data->results.GetPath(id);
+    if (!ret)
     {
         return -1;
     }
-    wxString path = ret.path.value();
+    wxString path = ret.value();
     wxString ext;
     wxFileName::SplitPath(path, nullptr, nullptr, &ext, wxPATH_NATIVE);
     if (ext.empty())
@@ -215,18 +293,44 @@ int ResultListCtrl::OnGetItemColumnImage(long item, long column) const
 
     if (ext.Matches("exe"))
     {
-        return GetImageForExe(m_data, path);
+        return GetImage(m_data, path, true);
     }
-    return GetImageForFile(m_data, ext);
+    return GetImage(m_data, ext, false);
 }
 
 void ResultListCtrl::Data::OnUpdateUI(wxCommandEvent&)
 {
-    long count = 0;
+    Trace::SetThreadName("UI");
+    TraceScope scope("Update result list");
+
+    /* Only the top rows are sorted, the rest of the list is never reordered. */
     {
         std::lock_guard<std::mutex> lock(result_mutex);
-        count = results.size();
+        rows = ranked;
+        row_count = rows.size() + unranked.Size();
     }
+    std::sort(rows.begin(), rows.end(),
+              [this](ResultStore::Id a, ResultStore::Id b) { return RanksBefore(this, a, b); });
+
+    scope.SetArg("rows", static_cast<int64_t>(row_count));
+    owner->wxListCtrl::SetItemCount(static_cast<long>(row_count));
+    owner->Refresh();
+}
 
-    owner->wxListCtrl::SetItemCount(count);
+void ResultListCtrl::Data::OnIconsReady(wxCommandEvent&)
+{
+    owner->Refresh();
+}
+
+void ResultListCtrl::Data::OnResolveIcons(wxCommandEvent&)
+{
+    TraceScope scope("Resolve icons");
+
+    /* Queue the rest behind the events already pending, so input is not held up. */
+    if (icon_cache->ResolvePending(IconsPerResolve))
+    {
+        wxQueueEvent(owner, new wxCommandEvent(LR_RESULT_LIST_RESOLVE_ICONS));
+        return;
+    }
+    resolving = false;
 }
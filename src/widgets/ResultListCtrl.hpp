@@ -3,6 +3,7 @@
 
 #include <wx/wx.h>
 #include <wx/listctrl.h>
+#include <cstdint>
 #include "searchers/Searcher.hpp"
 
 namespace LR
@@ -10,21 +11,22 @@ namespace LR
 
 struct ResultListCtrl : wxListCtrl
 {
-    typedef std::vector<LR::Searcher::Result> ResultVec;
-
     ResultListCtrl(wxWindow* parent);
     ~ResultListCtrl() override;
 
     /**
      * @brief Clear all contents and update UI.
+     * @return Generation of the new contents.
      */
-    void Clear();
+    uint64_t Clear();
 
     /**
-     * @brief Append result into table. The UI is not update until UpdateUI() called.
-     * @param[in] result Information.
+     * @brief Append results into table. The UI is not update until UpdateUI() called.
+     *   The best scored results are shown first, the others follow in arrival order.
+     * @param[in] batch Results, moved into the table.
+     * @param[in] generation Generation returned by Clear(). Results of older generations are dropped.
      */
-    void Append(const LR::Searcher::Result& result);
+    void Append(LR::Searcher::ResultBatch&& batch, uint64_t generation);
 
     /**
      * @brief Refresh UI.